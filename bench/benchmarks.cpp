@@ -0,0 +1,642 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include "project.h"
+#include "projectinput.h"
+#include "input.h"
+#include "transfer.h"
+#include "distributed.h"
+#include "toymodel.h"
+
+// --------------------------------------------------------------------
+// OpenHDM microbenchmarks: Measures the performance of the core grid,
+//   patch, phasing, transfer and input routines using the reference toy
+//   model.
+//   A summary is printed to the screen, and the results are written in
+//   JSON format, so that they can be tracked across releases.
+//
+//   Usage: openhdm_benchmarks [--output results.json] [--repetitions 5]
+//                             [--scale 1.0] [--max-children 4]
+// --------------------------------------------------------------------
+
+using namespace OpenHDM;
+using namespace ToyModel;
+
+unsigned ToyDomain::nts        = 1000;
+unsigned ToyDomain::nPhases    = 3;
+unsigned ToyDomain::nNodes     = 1000;
+unsigned ToyDomain::nCells     = 0;
+bool ToyDomain::boundaryExchange = false;
+bool ToyDomain::localPhases = false;
+std::map<std::string,double> ToyDomain::checksums;
+std::mutex ToyDomain::checksumsMtx;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct Result{
+    std::string name;
+    std::string params;     // JSON object members, e.g., "\"n\":1000"
+    unsigned long ops;      // no. of operations per repetition
+    std::vector<double> seconds;
+};
+
+struct Options{
+    std::string output      = "benchmarks.json";
+    unsigned repetitions    = 5;
+    double scale            = 1.0;
+    unsigned maxChildren    = 4;
+    std::string workDir     = "/tmp/openhdm_benchmarks";
+};
+
+// Runs a benchmark for a number of repetitions. The setup function is not timed.
+Result measure(Options const &opt, std::string name, std::string params, unsigned long ops,
+               std::function<void()> setup, std::function<void()> body){
+    Result result{name, params, ops, {}};
+    for (unsigned r=0; r<opt.repetitions; r++){
+        setup();
+        auto t0 = clock_type::now();
+        body();
+        result.seconds.push_back(std::chrono::duration<double>(clock_type::now()-t0).count());
+    }
+    return result;
+}
+
+double median(std::vector<double> v){
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return n%2 ? v[n/2] : 0.5*(v[n/2-1]+v[n/2]);
+}
+
+// Silences the logs and the progress display of OpenHDM runs:
+class Silence{
+public:
+    Silence():
+        coutBuf(std::cout.rdbuf(nullptr)), clogBuf(std::clog.rdbuf(nullptr)) {}
+    ~Silence(){
+        std::cout.rdbuf(coutBuf);
+        std::clog.rdbuf(clogBuf);
+        std::cout.clear();
+        std::clog.clear();
+    }
+private:
+    std::streambuf* coutBuf;
+    std::streambuf* clogBuf;
+};
+
+unsigned scaled(Options const &opt, unsigned n){
+    return std::max(1u, unsigned(n*opt.scale));
+}
+
+
+// Grid::insertUnit, Grid::insertUnits and Grid::copyFromParent:
+void benchGrid(Options const &opt, std::vector<Result> &results){
+
+    unsigned n = scaled(opt, 200000);
+    std::string params = "\"n\":"+std::to_string(n);
+
+    std::vector<ToyNode> nodes;
+    for (unsigned i=0; i<n; i++){
+        nodes.emplace_back(int(i+1), double(i), double(i));
+    }
+
+    std::shared_ptr<ToyGrid> grid;
+    auto freshGrid = [&]{grid = std::make_shared<ToyGrid>();};
+
+    results.push_back(measure(opt, "grid.insertUnit", params, n, freshGrid, [&]{
+        for (auto &node : nodes){
+            grid->insertUnit(node);
+        }
+    }));
+
+    results.push_back(measure(opt, "grid.insertUnits", params, n, freshGrid, [&]{
+        grid->insertUnits(nodes.begin(), nodes.end());
+    }));
+
+    auto parentGrid = std::make_shared<ToyGrid>();
+    parentGrid->insertUnits(nodes.begin(), nodes.end());
+    auto& parentNodes = parentGrid->getNodes();
+    auto freshChildGrid = [&]{grid = std::make_shared<ToyGrid>(parentGrid);};
+
+    results.push_back(measure(opt, "grid.copyFromParent", params, n, freshChildGrid, [&]{
+        for (auto &node : parentNodes){
+            grid->copyFromParent(node);
+        }
+    }));
+
+    results.push_back(measure(opt, "grid.copyFromParent.range", params, n, freshChildGrid, [&]{
+        grid->copyFromParent(parentNodes.begin(), parentNodes.end());
+    }));
+}
+
+
+// Patch::insertUnitPtr/removeUnitPtr under churn, i.e., a random unit is removed from and
+// reinserted into a patch at each operation.
+void benchPatch(Options const &opt, std::vector<Result> &results){
+
+    for (unsigned n : {scaled(opt,1000), scaled(opt,100000)}){
+
+        unsigned nOps = scaled(opt, 20000);
+        std::string params = "\"n\":"+std::to_string(n)+",\"ops\":"+std::to_string(nOps);
+
+        auto grid = std::make_shared<ToyGrid>();
+        std::vector<ToyNode> nodes;
+        for (unsigned i=0; i<n; i++){
+            nodes.emplace_back(int(i+1));
+        }
+        grid->insertUnits(nodes.begin(), nodes.end());
+        grid->initializePatches();
+        ToyPatch& patch = grid->getActivePatch();
+        auto& units = grid->getNodes();
+
+        std::mt19937 rng(42);
+        std::vector<unsigned> picks(nOps);
+        for (auto &pick : picks){
+            pick = rng()%n;
+        }
+
+        auto noSetup = []{};
+
+        results.push_back(measure(opt, "patch.churn.removeUnitPtr", params, nOps, noSetup, [&]{
+            for (auto pick : picks){
+                patch.removeUnitPtr(&units[pick]);
+                patch.insertUnitPtr(&units[pick], 0);
+            }
+        }));
+
+        results.push_back(measure(opt, "patch.churn.removeUnitPtrUnordered", params, nOps, noSetup, [&]{
+            for (auto pick : picks){
+                patch.removeUnitPtrUnordered(&units[pick]);
+                patch.insertUnitPtr(&units[pick], 0);
+            }
+        }));
+    }
+}
+
+
+// Patch::insertUnitPtr/removeUnitPtr under churn with a tracked boundary (see Grid::trackBoundary())
+// on a lattice of nodes, whose adjacency is built from directed pairs and then symmetrized. The
+// tracked boundary is checked against the boundary determined from scratch, before and after a unit
+// of the patch is removed from the grid, along with the neighbors of the remaining units.
+void benchTrackedBoundary(Options const &opt, std::vector<Result> &results){
+
+    const unsigned width = 100;
+    unsigned n = width*std::max(2u, scaled(opt, 10000)/width);
+    unsigned nOps = scaled(opt, 20000);
+    std::string params = "\"n\":"+std::to_string(n)+",\"ops\":"+std::to_string(nOps);
+
+    auto grid = std::make_shared<ToyGrid>();
+    std::vector<ToyNode> nodes;
+    std::vector<std::pair<int,int>> pairs;
+    for (unsigned i=0; i<n; i++){
+        nodes.emplace_back(int(i+1), double(i%width), double(i/width));
+        if ((i+1)%width) pairs.emplace_back(int(i+1), int(i+2));
+        if (i+width<n)   pairs.emplace_back(int(i+1), int(i+width+1));
+    }
+    grid->insertUnits(nodes.begin(), nodes.end());
+    grid->buildAdjacency<ToyNode,ToyNode>(pairs);
+    grid->getAdjacency<ToyNode,ToyNode>().symmetrize();
+
+    // A patch of the left half of the lattice:
+    auto& units = grid->getNodes();
+    ToyPatch& patch = grid->addPatch();
+    std::vector<ToyNode*> halfptrs;
+    for (auto &node : units){
+        if (node.x < width/2) halfptrs.push_back(&node);
+    }
+    patch.insertUnitPtrs(halfptrs, 0);
+    grid->trackBoundary<ToyNode>(patch);
+
+    std::mt19937 rng(42);
+    std::vector<ToyNode*> picks(nOps);
+    for (auto &pick : picks){
+        pick = halfptrs[rng()%halfptrs.size()];
+    }
+
+    results.push_back(measure(opt, "patch.churn.trackedBoundary", params, nOps, []{}, [&]{
+        for (auto pick : picks){
+            patch.removeUnitPtrUnordered(pick);
+            patch.insertUnitPtr(pick, 0);
+        }
+    }));
+
+    // Check the tracked boundary:
+    auto& adjacency = grid->getAdjacency<ToyNode,ToyNode>();
+    auto checkBoundary = [&]{
+        std::vector<unsigned> expected;
+        for (auto unitptr : patch.getNodes()){
+            for (auto neighbor : adjacency.neighbors(unitptr->getPos())){
+                if (units[neighbor].getPatchID()!=patch.getID() or not units[neighbor].isActive()){
+                    expected.push_back(unitptr->getPos());
+                    break;
+                }
+            }
+        }
+        std::vector<unsigned> tracked(patch.getBoundary<ToyNode>().begin(), patch.getBoundary<ToyNode>().end());
+        std::sort(expected.begin(), expected.end());
+        std::sort(tracked.begin(), tracked.end());
+        if (tracked!=expected){
+            Report::error("Benchmarks","The tracked boundary ("+std::to_string(tracked.size())+" units) does"
+                          " not match the boundary of the patch ("+std::to_string(expected.size())+" units).");
+        }
+    };
+    checkBoundary();
+
+    // Remove a unit of the patch from the grid, and check the adjacency and the tracked boundary:
+    int removedID = int(width/4 + (n/width/2)*width + 1);
+    {
+        Silence silence;
+        grid->removeUnit(units[grid->get_id2pos<ToyNode>(removedID)]);
+    }
+    for (auto &node : units){
+        unsigned i = unsigned(node.getID()-1);
+        std::vector<int> expected;
+        if (i>=width)           expected.push_back(int(i-width+1));
+        if (i%width)            expected.push_back(int(i));
+        if ((i+1)%width)        expected.push_back(int(i+2));
+        if (i+width<n)          expected.push_back(int(i+width+1));
+        expected.erase(std::remove(expected.begin(), expected.end(), removedID), expected.end());
+        std::vector<int> neighbors;
+        for (auto neighbor : adjacency.neighbors(node.getPos())){
+            neighbors.push_back(units[neighbor].getID());
+        }
+        if (neighbors!=expected or grid->get_id2pos<ToyNode>(node.getID())!=node.getPos()){
+            Report::error("Benchmarks","The neighbors of unit "+std::to_string(node.getID())+" are not"
+                          " consistent after the removal of unit "+std::to_string(removedID)+".");
+        }
+    }
+    checkBoundary();
+}
+
+
+// Writes a project file with a parent and nChildren child domains.
+std::string writeProjectFile(Options const &opt, unsigned nChildren){
+
+    std::string fileName = opt.workDir+"/project_"+std::to_string(nChildren)+".txt";
+    std::ofstream ofs(fileName);
+    ofs << "OpenHDM benchmark project\n";
+    ofs << "benchmark\n";
+    ofs << nChildren+1 << "\n";
+    ofs << "parent ./parent ./out_parent\n";
+    for (unsigned c=0; c<nChildren; c++){
+        std::string id = "child"+std::to_string(c);
+        ofs << id << " ./" << id << " ./out_" << id << " parent\n";
+    }
+    return fileName;
+}
+
+
+// Domain::phaseCheck round-trip latency, i.e., the time per phase of a hierarchy with 1..N
+// children whose phases perform (almost) no work.
+void benchPhasing(Options const &opt, std::vector<Result> &results){
+
+    ToyDomain::nNodes = 1;
+    ToyDomain::nPhases = 3;
+    ToyDomain::nts = scaled(opt, 2000);
+
+    for (unsigned nChildren=0; nChildren<=opt.maxChildren; nChildren++){
+
+        std::string fileName = writeProjectFile(opt, nChildren);
+        unsigned long nPhaseExecutions = (unsigned long)ToyDomain::nts*ToyDomain::nPhases;
+        std::string params = "\"children\":"+std::to_string(nChildren)
+                            +",\"nts\":"+std::to_string(ToyDomain::nts)
+                            +",\"phases\":"+std::to_string(ToyDomain::nPhases);
+
+        std::unique_ptr<ProjectInput> projectInput;
+        std::unique_ptr<Project<ToyDomain>> project;
+
+        results.push_back(measure(opt, "domain.phaseCheck", params, nPhaseExecutions, [&]{
+            Silence silence;
+            project.reset();
+            projectInput = std::make_unique<ProjectInput>(fileName);
+            project = std::make_unique<Project<ToyDomain>>(*projectInput);
+        }, [&]{
+            Silence silence;
+            project->run(nChildren+2, nChildren>0 ? nChildren : 0);
+        }));
+    }
+}
+
+
+// Project::run of the toy model with boundary exchange and cells, in shared memory and distributed
+// over the ranks of a LocalCommunicator, where the parent ships its boundary field to the children
+// on the other ranks. (See Distributed::Link) The results of the distributed runs must match those
+// of the shared-memory run. With local phases, the children must also read the same boundary
+// elevations of the parent in their local phases following the first control point of the parent
+// as in that control point.
+void benchDistributed(Options const &opt, std::vector<Result> &results, bool localPhases){
+
+    const unsigned nChildren = 2;
+    ToyDomain::nNodes = 1000;
+    ToyDomain::nPhases = 3;
+    ToyDomain::nCells = 1000;
+    ToyDomain::nts = scaled(opt, 500);
+    ToyDomain::boundaryExchange = true;
+
+    std::string fileName = writeProjectFile(opt, nChildren);
+    ProjectInput projectInput(fileName);
+    std::string params = "\"children\":"+std::to_string(nChildren)+",\"nts\":"+std::to_string(ToyDomain::nts)
+                        +",\"localPhases\":"+(localPhases ? "true" : "false");
+
+    std::unique_ptr<Project<ToyDomain>> project;
+    results.push_back(measure(opt, "project.run.shared", params+",\"ranks\":1", ToyDomain::nts, [&]{
+        Silence silence;
+        project.reset();
+        ToyDomain::checksums.clear();
+        project = std::make_unique<Project<ToyDomain>>(projectInput);
+    }, [&]{
+        Silence silence;
+        project->run(nChildren+2, 0);
+    }));
+    project.reset();
+    auto expected = ToyDomain::checksums;
+
+    unsigned nChecked = 0;
+    for (auto &checksum : expected){
+        std::string suffix = ".imposed";
+        std::string const &key = checksum.first;
+        if (key.size()<=suffix.size() or key.compare(key.size()-suffix.size(), suffix.size(), suffix)!=0){
+            continue;
+        }
+        std::string id = key.substr(0, key.size()-suffix.size());
+        auto parent = expected.find(id+".parent");
+        if (parent==expected.end() or parent->second!=checksum.second){
+            Report::error("Benchmarks","The boundary elevations of the parent read by the local phase of "
+                          +id+" do not match those imposed by its control point.");
+        }
+        nChecked++;
+    }
+    if (localPhases and nChecked!=nChildren){
+        Report::error("Benchmarks","The local phases of the children were not executed.");
+    }
+
+    for (int nRanks : {2, 3}){
+        std::vector<std::unique_ptr<Project<ToyDomain>>> projects;
+        results.push_back(measure(opt, "project.run.distributed", params+",\"ranks\":"+std::to_string(nRanks),
+                                  ToyDomain::nts, [&]{
+            Silence silence;
+            projects.clear();
+            ToyDomain::checksums.clear();
+            auto comms = Distributed::LocalCommunicator::create(nRanks);
+            for (int r=0; r<nRanks; r++){
+                projects.push_back(std::make_unique<Project<ToyDomain>>(projectInput));
+                projects.back()->setDistribution(comms[r]);
+            }
+        }, [&]{
+            Silence silence;
+            std::vector<std::thread> rankThreads;
+            for (auto &rankProject : projects){
+                rankThreads.emplace_back([&rankProject]{rankProject->run(2, 0);});
+            }
+            for (auto &thread : rankThreads){
+                thread.join();
+            }
+        }));
+        projects.clear();
+
+        if (ToyDomain::checksums!=expected){
+            Report::error("Benchmarks","The results of the distributed run on "+std::to_string(nRanks)+
+                          " ranks do not match those of the shared-memory run.");
+        }
+    }
+
+    ToyDomain::boundaryExchange = false;
+    ToyDomain::nCells = 0;
+}
+
+void benchDistributed(Options const &opt, std::vector<Result> &results){
+    for (bool localPhases : {false, true}){
+        ToyDomain::localPhases = localPhases;
+        benchDistributed(opt, results, localPhases);
+    }
+    ToyDomain::localPhases = false;
+}
+
+
+// Parent-to-child boundary transfer: a scan of the child patch that looks up the parent units of
+// its boundary units via cp2pp (as in imposePatchBCs of models), and the BoundaryTransfer kernels.
+void benchTransfer(Options const &opt, std::vector<Result> &results){
+
+    unsigned n = scaled(opt, 100000);
+    const unsigned nSweeps = 100;
+
+    std::vector<ToyNode> nodes;
+    for (unsigned i=0; i<n; i++){
+        nodes.emplace_back(int(i+1), double(i), double(i));
+    }
+    auto parentGrid = std::make_shared<ToyGrid>();
+    parentGrid->insertUnits(nodes.begin(), nodes.end());
+    auto& parentNodes = parentGrid->getNodes();
+    for (auto &node : parentNodes){
+        node.etaPrev = 1e-3*node.x;
+        node.eta = 2e-3*node.x;
+    }
+
+    // A child grid whose active patch has every other unit on its boundary:
+    auto childGrid = std::make_shared<ToyGrid>(parentGrid);
+    childGrid->copyFromParent(parentNodes.begin(), parentNodes.end());
+    auto& childNodes = childGrid->getNodes();
+    ToyPatch& patch = childGrid->addPatch();
+    std::vector<ToyNode*> nodeptrs;
+    for (auto &node : childNodes){
+        nodeptrs.push_back(&node);
+    }
+    patch.insertUnitPtrs(nodeptrs, 0);
+    for (unsigned i=0; i<n; i+=2){
+        patch.setBoundary(&childNodes[i]);
+    }
+    childGrid->updateBoundaryPairs<ToyNode>(patch);
+    BoundaryTransfer transfer = childGrid->getBoundaryTransfer<ToyNode>(sizeof(ToyNode), sizeof(ToyNode));
+
+    std::string params = "\"n\":"+std::to_string(n)+",\"boundary\":"+std::to_string(transfer.size());
+    unsigned long nOps = transfer.size()*nSweeps;
+    auto noSetup = []{};
+
+    results.push_back(measure(opt, "transfer.unitLoop", params, nOps, noSetup, [&]{
+        for (unsigned s=0; s<nSweeps; s++){
+            for (auto node : patch.getNodes()){
+                if (node->isBoundary()){
+                    node->eta = parentNodes[childGrid->get_cp2pp<ToyNode>(node->getPos())].eta;
+                }
+            }
+        }
+    }));
+
+    results.push_back(measure(opt, "transfer.apply", params, nOps, noSetup, [&]{
+        for (unsigned s=0; s<nSweeps; s++){
+            transfer.apply(&parentNodes[0].eta, &childNodes[0].eta);
+        }
+    }));
+
+    // Interpolation between the previous and the current time levels of the parent elevations:
+    results.push_back(measure(opt, "transfer.apply.interpolated", params, nOps, noSetup, [&]{
+        for (unsigned s=0; s<nSweeps; s++){
+            transfer.apply(&parentNodes[0].etaPrev, &parentNodes[0].eta, 0.5, &childNodes[0].eta);
+        }
+    }));
+}
+
+
+// Input::readParams throughput for the stream-based and the memory-mapped input modes.
+void benchInput(Options const &opt, std::vector<Result> &results){
+
+    unsigned nLines = scaled(opt, 500000);
+    std::string fileName = opt.workDir+"/grid.txt";
+    {
+        std::ofstream ofs(fileName);
+        ofs.precision(10);
+        for (unsigned i=1; i<=nLines; i++){
+            ofs << i << " " << i*0.5 << " " << i*1e-3 << " " << -0.25*i << "\n";
+        }
+    }
+
+    class GridFile: public Input{
+    public:
+        GridFile(std::string filePath_, bool memoryMapped_, unsigned nLines_):
+            Input("", filePath_, memoryMapped_), nLines(nLines_) {}
+
+        virtual void readInputFile(){
+            openInputFile();
+            int id; double x, y, z;
+            if (memoryMapped){
+                InputCursor cursor = getCursor();
+                for (unsigned i=0; i<nLines; i++){
+                    readParams(cursor, id, x, y, z);
+                    checksum += x;
+                }
+            }
+            else{
+                for (unsigned i=0; i<nLines; i++){
+                    readParams(ifs, id, x, y, z);
+                    checksum += x;
+                }
+            }
+            closeInputFile();
+        }
+        double checksum = 0.;
+    private:
+        unsigned nLines;
+    };
+
+    std::string params = "\"lines\":"+std::to_string(nLines)+",\"params_per_line\":4";
+    auto noSetup = []{};
+
+    results.push_back(measure(opt, "input.readParams.ifstream", params, nLines, noSetup, [&]{
+        GridFile gridFile(fileName, false, nLines);
+        gridFile.readInputFile();
+    }));
+
+    results.push_back(measure(opt, "input.readParams.mmap", params, nLines, noSetup, [&]{
+        GridFile gridFile(fileName, true, nLines);
+        gridFile.readInputFile();
+    }));
+}
+
+
+void writeJSON(Options const &opt, std::vector<Result> const &results){
+
+    std::ofstream ofs(opt.output);
+    if (not ofs.is_open()){
+        Report::error("Benchmarks","Couldn't open "+opt.output);
+    }
+
+    ofs.precision(6);
+    ofs << "{\n  \"suite\": \"openhdm-benchmarks\",\n  \"version\": 1,\n"
+        << "  \"repetitions\": " << opt.repetitions << ",\n"
+        << "  \"scale\": " << opt.scale << ",\n"
+        << "  \"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"results\": [";
+    for (size_t i=0; i<results.size(); i++){
+        auto &r = results[i];
+        double med = median(r.seconds);
+        double best = *std::min_element(r.seconds.begin(), r.seconds.end());
+        ofs << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"params\": {" << r.params << "}"
+            << ", \"ops\": " << r.ops
+            << ", \"seconds_median\": " << med
+            << ", \"seconds_min\": " << best
+            << ", \"ns_per_op_median\": " << med*1e9/r.ops
+            << ", \"ns_per_op_min\": " << best*1e9/r.ops << "}";
+    }
+    ofs << "\n  ]\n}\n";
+}
+
+
+void printSummary(std::vector<Result> const &results){
+
+    std::printf("%-40s %-40s %14s\n", "benchmark", "params", "ns/op (median)");
+    for (auto &r : results){
+        std::printf("%-40s %-40s %14.1f\n", r.name.c_str(), r.params.c_str(),
+                    median(r.seconds)*1e9/r.ops);
+    }
+}
+
+} // end of anonymous namespace
+
+
+int main(int argc, char* argv[]){
+
+    Options opt;
+    for (int i=1; i<argc; i++){
+        std::string arg = argv[i];
+        if (i+1>=argc){
+            Report::error("Benchmarks","Missing value for argument "+arg);
+        }
+        if      (arg=="--output")       opt.output = argv[++i];
+        else if (arg=="--repetitions")  opt.repetitions = std::max(1, std::atoi(argv[++i]));
+        else if (arg=="--scale")        opt.scale = std::atof(argv[++i]);
+        else if (arg=="--max-children") opt.maxChildren = std::atoi(argv[++i]);
+        else if (arg=="--work-dir")     opt.workDir = argv[++i];
+        else Report::error("Benchmarks","Unknown argument "+arg);
+    }
+
+    if ( mkdir(opt.workDir.c_str(), 0744) != 0 and errno != EEXIST){
+        Report::error("Benchmarks",opt.workDir+" directory could not be created");
+    }
+
+    std::vector<Result> results;
+    benchGrid(opt, results);
+    benchPatch(opt, results);
+    benchTrackedBoundary(opt, results);
+    benchPhasing(opt, results);
+    benchDistributed(opt, results);
+    benchTransfer(opt, results);
+    benchInput(opt, results);
+
+    printSummary(results);
+    writeJSON(opt, results);
+    std::printf("Results are written to %s\n", opt.output.c_str());
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TOYMODEL_H
+#define TOYMODEL_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "domain.h"
+#include "solver.h"
+#include "grid.h"
+#include "patch.h"
+#include "unit.h"
+#include "serialization.h"
+#include "transfer.h"
+
+// --------------------------------------------------------------------
+// A small synthetic reference model used by the benchmarks: a unit
+//   type (ToyNode), an optional columnar unit type (ToyCell), a patch,
+//   a grid, a solver and a domain whose phases perform a configurable
+//   amount of work per node (and cell) of the active patch. The
+//   children copy the cells of the parent, borrowing their coordinates
+//   and depths, and deepen every tenth cell, i.e., own a copy of the
+//   depths. (See UnitColumns) With boundary exchange enabled, the children set
+//   the elevations of every tenth node to those of the parent at the
+//   beginning of each timestep, via a boundary field of the parent
+//   (see Domain::addBoundaryField()) so that the parent may also be
+//   timestepped on another rank. With local phases enabled, each domain
+//   accumulates the sum of its elevations at the end of each timestep
+//   in a local phase, and each child (with boundary exchange) sums the
+//   boundary elevations of the parent again in a local phase following
+//   the first control point of the parent, which must match the sum of
+//   the elevations it imposed (see Threading::Dependencies).
+// --------------------------------------------------------------------
+
+namespace ToyModel {
+
+using namespace OpenHDM;
+
+class ToyNode: public Unit{
+public:
+    ToyNode(int id_, double x_=0., double y_=0.):
+        Unit(id_), x(x_), y(y_) {}
+
+    virtual void writeBinary(Serializer &s)const{s.write(x); s.write(y); s.write(eta); s.write(etaPrev);}
+    virtual void readBinary(Deserializer &d){d.read(x); d.read(y); d.read(eta); d.read(etaPrev);}
+
+    double x, y;
+    double eta = 0.;
+    double etaPrev = 0.;    // the elevation at the previous time level
+};
+
+class ToyCell: public ColumnarUnit<Shared<double>, Shared<double>, double>{
+public:
+    enum Fields {X, DEPTH, ETA};
+};
+
+class ToyPatch: public Patch<ToyNode,ToyCell>{
+public:
+    std::vector<ToyNode*>& getNodes(){return std::get<std::vector<ToyNode*>>(unitptrsTuple);}
+};
+
+class ToyGrid: public Grid<ToyPatch,ToyNode,ToyCell>{
+public:
+    ToyGrid(std::shared_ptr<ToyGrid> parent_=nullptr):
+        Grid(parent_) {}
+
+    // Activates all of the nodes within a single patch:
+    virtual void initializePatches(){
+        ToyPatch& patch = addPatch();
+        for (auto &node : getNodes()){
+            patch.insertUnitPtr(&node, 0);
+        }
+        for (unsigned pos=0; pos<getCells().size(); pos++){
+            patch.insertUnitPos(getCells(), pos, 0);
+        }
+    }
+
+    std::vector<ToyNode>& getNodes(){return std::get<std::vector<ToyNode>>(unitsTuple);}
+    UnitColumns<ToyCell>& getCells(){return getColumns<ToyCell>();}
+    ToyPatch& getActivePatch(){return patches.front();}
+};
+
+class ToySolver: public Solver<ToyGrid>{
+public:
+    ToySolver(std::shared_ptr<ToySolver> parent_):
+        Solver(parent_) {}
+
+    void setGrid(std::shared_ptr<ToyGrid> grid_){grid = grid_;}
+
+    virtual void initialize(){}
+    virtual void adjustPatches(unsigned int){}
+    virtual void imposePatchBCs(unsigned int){}
+
+    // Relaxes the elevations of the active nodes and cells:
+    void relax(unsigned int ts){
+        for (auto node : grid->getActivePatch().getNodes()){
+            node->etaPrev = node->eta;
+            node->eta = 0.99*node->eta + 1e-3*(node->x+node->y+ts);
+        }
+        auto& cells = grid->getCells();
+        for (auto pos : grid->getActivePatch().getPositionList<ToyCell>()){
+            double& eta = cells.get<ToyCell::ETA>(pos);
+            eta = 0.99*eta + 1e-3*(cells.get<ToyCell::X>(pos)+cells.get<ToyCell::DEPTH>(pos)+ts);
+        }
+    }
+};
+
+class ToyDomain: public Domain<ToySolver>{
+public:
+    ToyDomain(std::string id_, std::string path_, std::string outputDir_):
+        Domain(id_, path_, outputDir_) {}
+
+    // Model parameters (shared by all of the domains of a project):
+    static unsigned nts;
+    static unsigned nPhases;
+    static unsigned nNodes;
+    static unsigned nCells;
+    static bool boundaryExchange;
+    static bool localPhases;
+
+    // The sums of the elevations of the domains at the end of the run (by domain id):
+    static std::map<std::string,double> checksums;
+    static std::mutex checksumsMtx;
+
+    virtual unsigned get_nts()const{return nts;}
+
+    // (The overrides are public, since they are called by the Project through ToyDomain)
+    virtual void instantiateMembers(){
+        std::shared_ptr<ToySolver> parentSolver;
+        std::shared_ptr<ToyGrid> parentGrid;
+        if (isChild()){
+            parentSolver = getParent()->getSolver();
+            parentGrid = parentSolver->getGrid();
+        }
+        solver = std::make_shared<ToySolver>(parentSolver);
+        solver->setGrid(std::make_shared<ToyGrid>(parentGrid));
+
+        for (unsigned p=0; p<nPhases; p++){
+            if (boundaryExchange and isChild() and p==0){
+                insertPhase([this](unsigned ts){imposeBoundary(); solver->relax(ts);});
+                if (localPhases){
+                    // (The parent does not write its elevations until the next control point.)
+                    insertPhase([this](unsigned){parentBoundarySum += boundarySum(getParentNodes());},
+                                Threading::Dependencies().reads("PARENT_ETA").afterParent(0).local());
+                }
+            }
+            else if (boundaryExchange and isParent() and p==1){
+                // (The children read the elevations of the parent concurrently with this phase.)
+                insertPhase([](unsigned){});
+            }
+            else{
+                insertPhase([this](unsigned ts){solver->relax(ts);});
+            }
+        }
+
+        if (localPhases){
+            insertPhase([this](unsigned){etaTotal += etaSum();},
+                        Threading::Dependencies().reads("ETA").local());
+        }
+
+        if (boundaryExchange){
+            addBoundaryField([this]{return &solver->getGrid()->getNodes()[0].eta;}, sizeof(ToyNode));
+        }
+    }
+
+    virtual void readInputs(){
+        auto& grid = *solver->getGrid();
+        std::vector<ToyNode> nodes;
+        nodes.reserve(nNodes);
+        for (unsigned i=0; i<nNodes; i++){
+            nodes.emplace_back(int(i+1), double(i%100), double(i/100));
+        }
+        grid.insertUnits(nodes.begin(), nodes.end());
+
+        if (isChild()){
+            std::vector<unsigned> parentPositions(nCells);
+            for (unsigned pos=0; pos<nCells; pos++){
+                parentPositions[pos] = pos;
+            }
+            grid.copyFromParent<ToyCell>(parentPositions);
+        }
+        else{
+            for (unsigned i=0; i<nCells; i++){
+                grid.insertColumnarUnit<ToyCell>(int(i+1), double(i%100), 10.+i%7, 0.);
+            }
+        }
+    }
+
+    virtual void doInitialize(){
+        solver->getGrid()->initializePatches();
+
+        if (isChild()){
+            auto& cells = solver->getGrid()->getCells();
+            for (unsigned pos=0; pos<cells.size(); pos+=10){
+                cells.write<ToyCell::DEPTH>(pos) += 1.;
+            }
+        }
+
+        if (boundaryExchange and isChild()){
+            std::vector<std::pair<unsigned,unsigned>> bcpairs;
+            for (unsigned pos=0; pos<nNodes; pos+=10){
+                bcpairs.emplace_back(pos, pos);
+            }
+            bcTransfer = BoundaryTransfer(bcpairs, sizeof(ToyNode), sizeof(ToyNode));
+            for (auto &pair : bcpairs){
+                boundaryPositions.push_back(pair.first);
+            }
+            setBoundaryPositions(bcpairs);
+        }
+    }
+
+    virtual void postProcess(){
+        std::lock_guard<std::mutex> lock(checksumsMtx);
+        checksums[getID()] = etaSum();
+        if (nCells>0){
+            checksums[getID()+".cells"] = cellSum();
+        }
+        if (localPhases){
+            checksums[getID()+".total"] = etaTotal;
+            if (boundaryExchange and isChild()){
+                checksums[getID()+".imposed"] = imposedSum;
+                checksums[getID()+".parent"] = parentBoundarySum;
+            }
+        }
+    }
+
+private:
+
+    // Sets the elevations of the boundary nodes to those of the parent:
+    void imposeBoundary(){
+        auto& nodes = solver->getGrid()->getNodes();
+        bcTransfer.apply(&getParentNodes()[0].eta, &nodes[0].eta);
+        if (localPhases){
+            imposedSum += boundarySum(nodes);
+        }
+    }
+
+    std::vector<ToyNode>& getParentNodes(){return getParent()->getSolver()->getGrid()->getNodes();}
+
+    double etaSum(){
+        double sum = 0.;
+        for (auto &node : solver->getGrid()->getNodes()){
+            sum += node.eta;
+        }
+        return sum;
+    }
+
+    // (The coordinates of the cells of a child are read from the parent, see UnitColumns::view())
+    double cellSum()const{
+        auto const& cells = solver->getGrid()->getCells();
+        auto x = cells.view<ToyCell::X>();
+        auto depth = cells.view<ToyCell::DEPTH>();
+        auto eta = cells.view<ToyCell::ETA>();
+        double sum = 0.;
+        for (unsigned pos=0; pos<cells.size(); pos++){
+            sum += eta[pos] + 1e-6*(x[pos]+depth[pos]);
+        }
+        return sum;
+    }
+
+    double boundarySum(std::vector<ToyNode> const &nodes)const{
+        double sum = 0.;
+        for (auto pos : boundaryPositions){
+            sum += nodes[pos].eta;
+        }
+        return sum;
+    }
+
+    BoundaryTransfer bcTransfer;
+    std::vector<unsigned> boundaryPositions;
+
+    // Accumulated by the local phases (and imposeBoundary()):
+    double etaTotal = 0.;
+    double imposedSum = 0.;
+    double parentBoundarySum = 0.;
+};
+
+} // end of namespace ToyModel
+
+#endif // TOYMODEL_H
@@ -0,0 +1,210 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "affinity.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the thread pinning
+// and topology detection functions defined in affinity.h
+// --------------------------------------------------------------------
+
+namespace {
+
+// Returns the CPUs the current thread is allowed to run on
+std::vector<unsigned int> allowedCPUs(){
+
+    std::vector<unsigned int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(set), &set)==0){
+        for (unsigned int cpu=0; cpu<CPU_SETSIZE; cpu++){
+            if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+        }
+    }
+#endif
+    if (cpus.empty()){
+        for (unsigned int cpu=0; cpu<std::max(1u, std::thread::hardware_concurrency()); cpu++){
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// Reads the first line of a (sysfs) file. Returns an empty string if the file cannot be read.
+std::string readLine(std::string const &path){
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// Detects the NUMA nodes from sysfs, keeping the allowed CPUs of each node only
+Affinity::Topology detectTopology(){
+
+    Affinity::Topology topology;
+    std::vector<unsigned int> allowed = allowedCPUs();
+
+    for (auto node : Affinity::parseCPUList(readLine("/sys/devices/system/node/online"))){
+        std::vector<unsigned int> cpus;
+        for (auto cpu : Affinity::parseCPUList(readLine("/sys/devices/system/node/node"
+                                                        +std::to_string(node)+"/cpulist"))){
+            if (std::binary_search(allowed.begin(), allowed.end(), cpu)) cpus.push_back(cpu);
+        }
+        if (not cpus.empty()){
+            topology.nodes.push_back(std::move(cpus));
+        }
+    }
+
+    if (topology.nodes.empty()){
+        topology.nodes.push_back(allowed);
+    }
+    return topology;
+}
+
+#ifdef __linux__
+// Converts a list of CPUs to a cpu_set_t. Returns false if the list is empty or out of range.
+bool toCPUSet(std::vector<unsigned int> const &cpus, cpu_set_t &set){
+    CPU_ZERO(&set);
+    for (auto cpu : cpus){
+        if (cpu>=CPU_SETSIZE) return false;
+        CPU_SET(cpu, &set);
+    }
+    return not cpus.empty();
+}
+#endif
+
+} // end of anonymous namespace
+
+
+// Returns the topology of the machine, detected at the first call. (Hence, the first call must be
+// made from a thread that is not pinned yet, e.g., by Project::setAffinity())
+Affinity::Topology const& Affinity::Topology::get(){
+    static const Topology topology = detectTopology();
+    return topology;
+}
+
+// Returns the total number of (allowed) CPUs in the nodes
+size_t Affinity::Topology::nCPUs()const{
+    size_t n = 0;
+    for (auto &node : nodes){
+        n += node.size();
+    }
+    return n;
+}
+
+
+// Returns the CPUs to which the given thread of a domain is pinned
+std::vector<unsigned int> Affinity::Binding::cpusOf(unsigned int thread)const{
+    if (not perThread or cpus.empty()) return cpus;
+    return {cpus[thread%cpus.size()]};
+}
+
+
+bool Affinity::pinThread(std::thread &thread, std::vector<unsigned int> const &cpus){
+#ifdef __linux__
+    cpu_set_t set;
+    return toCPUSet(cpus, set) and pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set)==0;
+#else
+    (void)thread; (void)cpus;
+    return false;
+#endif
+}
+
+bool Affinity::pinCurrentThread(std::vector<unsigned int> const &cpus){
+#ifdef __linux__
+    cpu_set_t set;
+    return toCPUSet(cpus, set) and pthread_setaffinity_np(pthread_self(), sizeof(set), &set)==0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+
+// Parses a CPU list of comma separated CPUs and CPU ranges, e.g., "0-3,8,10-11", as in sysfs
+std::vector<unsigned int> Affinity::parseCPUList(std::string const &str){
+
+    std::vector<unsigned int> cpus;
+    std::istringstream ss(str);
+    std::string item;
+    while (std::getline(ss, item, ',')){
+        if (item.empty()) continue;
+        size_t dash = item.find('-');
+        try{
+            unsigned int first = std::stoul(item.substr(0, dash));
+            unsigned int last = (dash==std::string::npos) ? first : std::stoul(item.substr(dash+1));
+            for (unsigned int cpu=first; cpu<=last; cpu++){
+                cpus.push_back(cpu);
+            }
+        }
+        catch (std::exception&){
+            Report::error("Affinity","Invalid CPU list: "+str);
+        }
+    }
+
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+// Returns the compact string representation of a CPU list (see parseCPUList())
+std::string Affinity::toString(std::vector<unsigned int> const &cpus){
+
+    std::vector<unsigned int> sorted(cpus);
+    std::sort(sorted.begin(), sorted.end());
+
+    std::string str;
+    for (size_t i=0; i<sorted.size(); ){
+        size_t j = i;
+        while (j+1<sorted.size() and sorted[j+1]==sorted[j]+1) j++;
+        if (not str.empty()) str += ",";
+        str += std::to_string(sorted[i]);
+        if (j>i) str += "-"+std::to_string(sorted[j]);
+        i = j+1;
+    }
+    return str;
+}
+
+
+// ScopedPinning constructor. Has no effect if the set of CPUs is empty.
+Affinity::ScopedPinning::ScopedPinning(std::vector<unsigned int> const &cpus){
+    if (cpus.empty()) return;
+    previous = allowedCPUs();
+    if (not pinCurrentThread(cpus)){
+        previous.clear();
+    }
+}
+
+Affinity::ScopedPinning::~ScopedPinning(){
+    if (not previous.empty()){
+        pinCurrentThread(previous);
+    }
+}
@@ -0,0 +1,97 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "report.h"
+
+namespace OpenHDM {
+namespace Affinity {
+
+// --------------------------------------------------------------------
+// Affinity: Functions and types to pin the threads of the domains to
+//   core sets, e.g., to the cores of a NUMA node, so that the threads
+//   are not migrated across sockets, and the grid data of a domain is
+//   first-touched, i.e., allocated, on the node of its threads. (See
+//   Project::setAffinity()) Pinning is supported on Linux only, and is
+//   a no-op elsewhere.
+// --------------------------------------------------------------------
+
+// Placement policies of the domains:
+//   None: the threads are not pinned.
+//   Node: the threads of each domain are pinned to the cores of a NUMA node.
+//   Core: each thread of a domain is pinned to a single core of a NUMA node.
+enum class Policy {None, Node, Core};
+
+// The NUMA nodes of the machine, i.e., the lists of the CPUs of each node that the process is
+// allowed to run on. If the nodes cannot be detected, all of the CPUs belong to a single node.
+struct Topology{
+    std::vector<std::vector<unsigned int>> nodes;
+
+    static Topology const& get();   // detected once
+    size_t nCPUs()const;
+};
+
+// The core set to which the threads of a domain are pinned. If perThread is true, the thread i of
+// the domain (0: the timestepping thread, i>0: the workers of the executor) is pinned to the CPU
+// cpus[i%cpus.size()], and otherwise, all threads are pinned to the whole set.
+struct Binding{
+    std::vector<unsigned int> cpus;
+    bool perThread = false;
+    int node = -1;                  // NUMA node of the CPUs (-1: unknown or multiple)
+
+    bool empty()const{return cpus.empty();}
+    std::vector<unsigned int> cpusOf(unsigned int thread)const;
+};
+
+// Pins a thread to a set of CPUs. Returns false if pinning fails or is not supported.
+bool pinThread(std::thread &thread, std::vector<unsigned int> const &cpus);
+bool pinCurrentThread(std::vector<unsigned int> const &cpus);
+
+// Conversions between CPU lists and their string representations, e.g., "0-3,8,10-11":
+std::vector<unsigned int> parseCPUList(std::string const &str);
+std::string toString(std::vector<unsigned int> const &cpus);
+
+
+// --------------------------------------------------------------------
+// ScopedPinning: Pins the current thread to a set of CPUs during its
+//   lifetime, and restores the previous affinity of the thread upon
+//   destruction, e.g., to first-touch the data of a domain on its node
+//   from a thread that sets up multiple domains.
+// --------------------------------------------------------------------
+
+class ScopedPinning{
+public:
+    ScopedPinning(std::vector<unsigned int> const &cpus);
+    ScopedPinning(const ScopedPinning&) = delete;
+    ScopedPinning& operator=(const ScopedPinning&) = delete;
+    ~ScopedPinning();
+
+private:
+    std::vector<unsigned int> previous;     // empty if the thread is not pinned
+};
+
+} // end of namespace Affinity
+} // end of namespace OpenHDM
+
+#endif // AFFINITY_H
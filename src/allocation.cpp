@@ -0,0 +1,195 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "allocation.h"
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementation of the class "Arena"
+// defined in allocation.h
+// --------------------------------------------------------------------
+
+namespace {
+const size_t hugePageSize = size_t(2)<<20;
+const int mpolPreferred = 1;    // MPOL_PREFERRED (see linux/mempolicy.h)
+}
+
+Arena::Arena(){
+
+}
+
+Arena::Arena(Options options_):
+    options(options_)
+{
+
+}
+
+Arena::~Arena(){
+    for (auto &chunk : chunks){
+        unmapMemory(chunk.first, chunk.second);
+    }
+}
+
+// Sets the options of the arena. Only affects the chunks obtained afterwards.
+void Arena::configure(Options options_){
+    std::lock_guard<std::mutex> lock(mtx);
+    options = options_;
+}
+
+// Returns the index of the size class of a block of n bytes
+unsigned Arena::sizeClass(size_t n){
+    unsigned c = minClass;
+    while ((size_t(1)<<c) < n) c++;
+    return c;
+}
+
+// Allocates a block of (at least) n bytes.
+void* Arena::allocate(size_t n){
+
+    if (n==0) n = 1;
+    unsigned c = sizeClass(n);
+    size_t blockSize = size_t(1)<<c;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    inUse += blockSize;
+
+    // Large blocks are mapped individually:
+    if (c > maxClass){
+        reserved += blockSize;
+        return mapMemory(blockSize);
+    }
+
+    // Recycle a freed block:
+    if (freeLists[c]){
+        FreeBlock* block = freeLists[c];
+        freeLists[c] = block->next;
+        return block;
+    }
+
+    // Carve a new block from the current chunk:
+    if (cursor+blockSize > chunkEnd){
+        newChunk(blockSize);
+    }
+    void* block = cursor;
+    cursor += blockSize;
+    return block;
+}
+
+// Returns a block of n bytes (as passed to allocate()) to the arena.
+void Arena::deallocate(void* p, size_t n){
+
+    if (not p) return;
+    if (n==0) n = 1;
+    unsigned c = sizeClass(n);
+    size_t blockSize = size_t(1)<<c;
+
+    std::lock_guard<std::mutex> lock(mtx);
+    inUse -= blockSize;
+
+    if (c > maxClass){
+        reserved -= blockSize;
+        unmapMemory(p, blockSize);
+        return;
+    }
+
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    block->next = freeLists[c];
+    freeLists[c] = block;
+}
+
+size_t Arena::bytesReserved()const{
+    std::lock_guard<std::mutex> lock(mtx);
+    return reserved;
+}
+
+size_t Arena::bytesInUse()const{
+    std::lock_guard<std::mutex> lock(mtx);
+    return inUse;
+}
+
+// Obtains a new chunk. The unused tail of the current chunk is split into free blocks.
+void Arena::newChunk(size_t minSize){
+
+    for (unsigned c=maxClass; c>=minClass; c--){
+        size_t blockSize = size_t(1)<<c;
+        while (cursor+blockSize <= chunkEnd){
+            FreeBlock* block = reinterpret_cast<FreeBlock*>(cursor);
+            block->next = freeLists[c];
+            freeLists[c] = block;
+            cursor += blockSize;
+        }
+    }
+
+    size_t chunkSize = std::max(options.chunkSize, minSize);
+    chunkSize = (chunkSize+hugePageSize-1)/hugePageSize*hugePageSize;
+
+    cursor = static_cast<char*>(mapMemory(chunkSize));
+    chunkEnd = cursor+chunkSize;
+    chunks.emplace_back(cursor, chunkSize);
+    reserved += chunkSize;
+}
+
+// Maps n bytes of anonymous memory (with the options of the arena)
+void* Arena::mapMemory(size_t n){
+
+    void* p = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    // Try explicit huge pages first (if reserved by the system), and fall back to transparent ones:
+    if (options.hugePages and n%hugePageSize==0){
+        p = mmap(nullptr, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (p==MAP_FAILED){
+        p = mmap(nullptr, n, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (p==MAP_FAILED){
+            Report::error("Arena","Cannot map "+std::to_string(n)+" bytes of memory.");
+        }
+#ifdef MADV_HUGEPAGE
+        if (options.hugePages){
+            madvise(p, n, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_getcpu)
+    // Prefer the NUMA node of the calling thread regardless of which thread touches the pages first:
+    if (options.numaLocal){
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr)==0 and node<8*sizeof(unsigned long)){
+            unsigned long nodeMask = 1ul<<node;
+            if (syscall(SYS_mbind, p, n, mpolPreferred, &nodeMask, 8*sizeof(unsigned long), 0)!=0){
+                Report::warning("Arena","Cannot bind memory to NUMA node "+std::to_string(node));
+            }
+        }
+    }
+#endif
+
+    return p;
+}
+
+void Arena::unmapMemory(void* p, size_t n){
+    munmap(p, n);
+}
@@ -0,0 +1,157 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALLOCATION_H
+#define ALLOCATION_H
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include "report.h"
+
+namespace OpenHDM {
+
+// --------------------------------------------------------------------
+// Allocation policies: An allocation policy determines the allocator
+//   of the containers of a grid and its patches, i.e., the unit
+//   vectors, the position lists and maps of the units, the patch deque
+//   and the unit pointers of the patches. A policy provides the member
+//   alias template "allocator<T>". The policy of a grid is that of its
+//   patch type, e.g.,
+//
+//     struct MyPatch: BasicPatch<ArenaAllocation<MyModel>, Node, Element>{};
+//     struct MyGrid: Grid<MyPatch, Node, Element>{...};
+// --------------------------------------------------------------------
+
+// The default policy, i.e., the standard allocator:
+struct StandardAllocation{
+    template <class T>
+    using allocator = std::allocator<T>;
+};
+
+
+// --------------------------------------------------------------------
+// Arena: A pool of memory obtained from the operating system in large
+//   chunks, which are never returned until the arena is destroyed.
+//   Blocks are rounded up to powers of two (16 bytes to 1 MB) and the
+//   freed blocks are kept in per-size free lists, so the small nodes of
+//   lists and maps are recycled without calls to malloc and free, and
+//   the footprint of a long run does not grow by fragmentation. Larger
+//   blocks are mapped individually. Chunks may optionally be backed by
+//   huge pages and bound to the NUMA node of the allocating thread.
+// --------------------------------------------------------------------
+
+class Arena{
+public:
+
+    struct Options{
+        size_t chunkSize    = size_t(64)<<20;   // the size of the chunks (rounded up to 2 MB)
+        bool hugePages      = false;            // back the chunks with (transparent) huge pages
+        bool numaLocal      = false;            // bind the chunks to the NUMA node of the allocating thread
+    };
+
+    Arena();
+    Arena(Options options_);
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    void configure(Options options_);
+
+    void* allocate(size_t n);
+    void deallocate(void* p, size_t n);
+
+    // statistics:
+    size_t bytesReserved()const;
+    size_t bytesInUse()const;
+
+private:
+
+    static constexpr unsigned minClass = 4;     // 16 bytes
+    static constexpr unsigned maxClass = 20;    // 1 MB
+    static unsigned sizeClass(size_t n);
+
+    void* mapMemory(size_t n);
+    void  unmapMemory(void* p, size_t n);
+    void  newChunk(size_t minSize);
+
+    struct FreeBlock{FreeBlock* next;};
+
+    Options options;
+    mutable std::mutex mtx;
+    std::vector<std::pair<void*,size_t>> chunks;
+    char* cursor    = nullptr;
+    char* chunkEnd  = nullptr;
+    FreeBlock* freeLists[maxClass+1] = {nullptr};
+    size_t reserved = 0;
+    size_t inUse    = 0;
+};
+
+
+// --------------------------------------------------------------------
+// ArenaAllocation: The allocation policy of containers allocated from
+//   an arena. The arena is shared by all containers of the policy, and
+//   different tags can be used to separate the arenas of, e.g., parent
+//   and child grids. The arena should be configured (see
+//   Arena::configure()) before it is first used.
+// --------------------------------------------------------------------
+
+template <class T, class Tag>
+struct ArenaAllocator;
+
+template <class Tag=void>
+struct ArenaAllocation{
+    template <class T>
+    using allocator = ArenaAllocator<T,Tag>;
+
+    // The arena is intentionally never destroyed, since the containers allocated from it may
+    // outlive any static object.
+    static Arena& arena(){
+        static Arena* instance = new Arena();
+        return *instance;
+    }
+};
+
+template <class T, class Tag>
+struct ArenaAllocator{
+    using value_type = T;
+
+    ArenaAllocator() = default;
+    template <class U>
+    ArenaAllocator(ArenaAllocator<U,Tag> const &){}
+
+    T* allocate(size_t n){
+        static_assert(alignof(T)<=16, "ArenaAllocator supports alignments of up to 16 bytes");
+        return static_cast<T*>(ArenaAllocation<Tag>::arena().allocate(n*sizeof(T)));
+    }
+    void deallocate(T* p, size_t n){
+        ArenaAllocation<Tag>::arena().deallocate(p, n*sizeof(T));
+    }
+};
+
+template <class T, class U, class Tag>
+bool operator==(ArenaAllocator<T,Tag> const &, ArenaAllocator<U,Tag> const &){return true;}
+template <class T, class U, class Tag>
+bool operator!=(ArenaAllocator<T,Tag> const &, ArenaAllocator<U,Tag> const &){return false;}
+
+} // end of namespace OpenHDM
+
+#endif // ALLOCATION_H
@@ -0,0 +1,429 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <algorithm>
+#include "report.h"
+#include "binaryoutput.h"
+#ifdef OPENHDM_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the "BinaryOutput"
+// and "BinaryOutputReader" classes defined in binaryoutput.h
+// --------------------------------------------------------------------
+
+// Note: Values are written by copying their in-memory representation, so the
+// little-endian layout documented in binaryoutput.h holds only on little-endian
+// hosts. Building on a big-endian host is rejected below.
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "BinaryOutput writes little-endian files and requires a little-endian host."
+#endif
+
+namespace {
+
+const char headerMagic[8] = {'O','H','D','M','B','I','N','1'};
+const char footerMagic[8] = {'O','H','D','M','I','D','X','1'};
+const uint32_t formatVersion = 1;
+
+template <typename T>
+void writeRaw(std::ofstream &ofs, T const &val){
+    ofs.write(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+template <typename T>
+void readRaw(std::ifstream &ifs, T &val){
+    ifs.read(reinterpret_cast<char*>(&val), sizeof(T));
+}
+
+template <typename T>
+void appendRaw(std::vector<char> &buffer, const T* vals, size_t n){
+    const char* p = reinterpret_cast<const char*>(vals);
+    buffer.insert(buffer.end(), p, p+n*sizeof(T));
+}
+
+} // end of anonymous namespace
+
+
+BinaryOutput::BinaryOutput(bool isChild_, unsigned recordLength_, unsigned chunkSize_, bool compress_):
+    Output(isChild_),
+    recordLength(recordLength_),
+    chunkSize(std::max(1u,chunkSize_)),
+    compress(compress_)
+{
+    openMode = std::ofstream::out | std::ofstream::binary;
+
+#ifndef OPENHDM_WITH_ZLIB
+    if (compress){
+        Report::warning("Binary Output!","OpenHDM is built without zlib (OPENHDM_WITH_ZLIB)."
+                        " Binary output chunks will not be compressed.");
+        compress = false;
+    }
+#endif
+}
+
+
+// Writes the file header. Must be called once, after the output file is opened.
+void BinaryOutput::writeHeader(){
+
+    if (not ofs.is_open()){
+        Report::error("Binary Output!","The output file "+fileTitle+" is not open.");
+    }
+
+    ofs.write(headerMagic, sizeof(headerMagic));
+    writeRaw(ofs, formatVersion);
+    writeRaw(ofs, uint32_t(recordLength));
+    writeRaw(ofs, uint32_t(chunkSize));
+    writeRaw(ofs, uint32_t(compress));
+    writeRaw(ofs, uint32_t(fileTitle.size()));
+    ofs.write(fileTitle.data(), fileTitle.size());
+
+    chunkBuffer.reserve(size_t(chunkSize)*(sizeof(uint32_t)+recordLength*sizeof(double)));
+    index.clear();
+    nPending = 0;
+    hasRecords = false;
+    headerWritten = true;
+}
+
+
+// Appends the record of timestep ts, i.e., recordLength values, to the current chunk.
+void BinaryOutput::writeRecord(unsigned int ts, const double* values){
+
+    if (not headerWritten){
+        Report::error("Binary Output!","The header of "+fileTitle+" is not written yet.");
+    }
+
+    // The reader locates records by a binary search over the chunk index, so the
+    // timesteps must increase across chunks, too.
+    if (hasRecords and ts<=lastTs){
+        Report::error("Binary Output!","Records of "+fileTitle+" must be written in increasing"
+                      " order of timesteps. (ts="+std::to_string(ts)+")");
+    }
+    if (nPending==0){
+        firstTs = ts;
+    }
+
+    uint32_t ts32 = ts;
+    appendRaw(chunkBuffer, &ts32, 1);
+    appendRaw(chunkBuffer, values, recordLength);
+    lastTs = ts;
+    hasRecords = true;
+    nPending++;
+
+    if (nPending==chunkSize){
+        writeChunk();
+    }
+}
+
+void BinaryOutput::writeRecord(unsigned int ts, std::vector<double> const &values){
+
+    if (values.size()!=recordLength){
+        Report::error("Binary Output!","Record size "+std::to_string(values.size())+
+                      " does not match the record length of "+fileTitle+" ("
+                      +std::to_string(recordLength)+")");
+    }
+    writeRecord(ts, values.data());
+}
+
+
+// Writes a submitted snapshot as a record. (See Output::submit())
+void BinaryOutput::writeSnapshot(unsigned int ts, Buffer const &buffer){
+    writeRecord(ts, buffer);
+}
+
+
+// Joins the I/O thread before the members written by writeSnapshot() are destroyed. The file is
+// completed only by closeOutputFile().
+BinaryOutput::~BinaryOutput(){
+    stopAsync();
+}
+
+
+// Drains the pending snapshots, writes the last chunk and the index, and closes the file.
+void BinaryOutput::closeOutputFile(){
+
+    if (isAsync()){
+        flush();
+    }
+
+    if (headerWritten){
+        writeChunk();
+        writeIndex();
+        headerWritten = false;
+    }
+
+    Output::closeOutputFile();
+}
+
+
+// Writes the current chunk (if not empty) to the file and adds it to the index.
+void BinaryOutput::writeChunk(){
+
+    if (nPending==0) return;
+
+    index.push_back(BinaryChunkEntry{firstTs, lastTs, uint32_t(nPending), uint64_t(ofs.tellp())});
+
+    const char* payload = chunkBuffer.data();
+    uint64_t storedBytes = chunkBuffer.size();
+
+#ifdef OPENHDM_WITH_ZLIB
+    std::vector<char> compressed;
+    if (compress){
+        uLongf destLen = compressBound(chunkBuffer.size());
+        compressed.resize(destLen);
+        if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &destLen,
+                      reinterpret_cast<const Bytef*>(chunkBuffer.data()), chunkBuffer.size(),
+                      Z_DEFAULT_COMPRESSION) != Z_OK){
+            Report::error("Binary Output!","Couldn't compress a chunk of "+fileTitle);
+        }
+        payload = compressed.data();
+        storedBytes = destLen;
+    }
+#endif
+
+    writeRaw(ofs, uint32_t(nPending));
+    writeRaw(ofs, storedBytes);
+    ofs.write(payload, storedBytes);
+
+    if (not ofs.good()){
+        Report::error("Binary Output!","Couldn't write to "+filePath);
+    }
+
+    chunkBuffer.clear();
+    nPending = 0;
+}
+
+
+// Writes the chunk index and the footer.
+void BinaryOutput::writeIndex(){
+
+    uint64_t indexOffset = ofs.tellp();
+    for (auto &entry : index){
+        writeRaw(ofs, entry.firstTs);
+        writeRaw(ofs, entry.lastTs);
+        writeRaw(ofs, entry.nRecords);
+        writeRaw(ofs, entry.offset);
+    }
+    writeRaw(ofs, uint64_t(index.size()));
+    writeRaw(ofs, indexOffset);
+    ofs.write(footerMagic, sizeof(footerMagic));
+}
+
+
+BinaryOutputReader::BinaryOutputReader(std::string filePath_):
+    filePath(filePath_)
+{
+    ifs.open(filePath, std::ifstream::in | std::ifstream::binary);
+    if (not ifs.is_open()){
+        Report::error("Binary Output Reader!","Couldn't open "+filePath);
+    }
+    readHeader();
+    readIndex();
+}
+
+
+void BinaryOutputReader::readHeader(){
+
+    char magic[8];
+    ifs.read(magic, sizeof(magic));
+    uint32_t version=0, recordLength32=0, chunkSize32=0, compression32=0, titleLength=0;
+    readRaw(ifs, version);
+    readRaw(ifs, recordLength32);
+    readRaw(ifs, chunkSize32);
+    readRaw(ifs, compression32);
+    readRaw(ifs, titleLength);
+
+    if (not ifs.good() or std::memcmp(magic, headerMagic, sizeof(magic))!=0){
+        Report::error("Binary Output Reader!",filePath+" is not an OpenHDM binary output file.");
+    }
+    if (version!=formatVersion){
+        Report::error("Binary Output Reader!","Unsupported format version "
+                      +std::to_string(version)+" of "+filePath);
+    }
+
+    title.resize(titleLength);
+    ifs.read(&title[0], titleLength);
+    recordLength = recordLength32;
+    chunkSize = chunkSize32;
+    compression = compression32;
+
+#ifndef OPENHDM_WITH_ZLIB
+    if (compression){
+        Report::error("Binary Output Reader!",filePath+" is compressed, but OpenHDM is built"
+                      " without zlib.");
+    }
+#endif
+}
+
+
+void BinaryOutputReader::readIndex(){
+
+    ifs.seekg(-int64_t(2*sizeof(uint64_t)+sizeof(footerMagic)), std::ifstream::end);
+    uint64_t nChunks=0, indexOffset=0;
+    char magic[8];
+    readRaw(ifs, nChunks);
+    readRaw(ifs, indexOffset);
+    ifs.read(magic, sizeof(magic));
+
+    if (not ifs.good() or std::memcmp(magic, footerMagic, sizeof(magic))!=0){
+        Report::error("Binary Output Reader!","The index of "+filePath+" is not found."
+                      " (The file may not have been closed properly.)");
+    }
+
+    ifs.seekg(indexOffset);
+    index.resize(nChunks);
+    for (auto &entry : index){
+        readRaw(ifs, entry.firstTs);
+        readRaw(ifs, entry.lastTs);
+        readRaw(ifs, entry.nRecords);
+        readRaw(ifs, entry.offset);
+    }
+}
+
+
+// Returns the total number of records in the file.
+size_t BinaryOutputReader::get_nRecords() const{
+
+    size_t n = 0;
+    for (auto &entry : index){
+        n += entry.nRecords;
+    }
+    return n;
+}
+
+
+// Reads and uncompresses a chunk.
+void BinaryOutputReader::loadChunk(size_t c){
+
+    if (c==loadedChunk) return;
+
+    uint32_t nRecords=0;
+    uint64_t storedBytes=0;
+    ifs.clear();
+    ifs.seekg(index[c].offset);
+    readRaw(ifs, nRecords);
+    readRaw(ifs, storedBytes);
+
+    size_t rawBytes = size_t(nRecords)*(sizeof(uint32_t)+recordLength*sizeof(double));
+    std::vector<char> stored(storedBytes);
+    ifs.read(stored.data(), storedBytes);
+    if (not ifs.good()){
+        Report::error("Binary Output Reader!","Couldn't read a chunk of "+filePath);
+    }
+
+    if (compression){
+#ifdef OPENHDM_WITH_ZLIB
+        chunkBuffer.resize(rawBytes);
+        uLongf destLen = rawBytes;
+        if (uncompress(reinterpret_cast<Bytef*>(chunkBuffer.data()), &destLen,
+                       reinterpret_cast<const Bytef*>(stored.data()), storedBytes) != Z_OK
+            or destLen!=rawBytes){
+            Report::error("Binary Output Reader!","Couldn't uncompress a chunk of "+filePath);
+        }
+#endif
+    }
+    else{
+        if (storedBytes!=rawBytes){
+            Report::error("Binary Output Reader!","Corrupt chunk in "+filePath);
+        }
+        chunkBuffer.swap(stored);
+    }
+    loadedChunk = c;
+}
+
+
+// Returns the timesteps of all records in the file.
+std::vector<unsigned> BinaryOutputReader::getTimesteps(){
+
+    std::vector<unsigned> timesteps;
+    size_t recordBytes = sizeof(uint32_t)+recordLength*sizeof(double);
+    for (size_t c=0; c<index.size(); c++){
+        loadChunk(c);
+        for (uint32_t r=0; r<index[c].nRecords; r++){
+            uint32_t ts;
+            std::memcpy(&ts, chunkBuffer.data()+r*recordBytes, sizeof(ts));
+            timesteps.push_back(ts);
+        }
+    }
+    return timesteps;
+}
+
+
+// Reads the record of timestep ts into values. Returns false if there is no such record.
+bool BinaryOutputReader::readRecord(unsigned int ts, std::vector<double> &values){
+
+    // Find the chunk containing ts via the index:
+    auto it = std::lower_bound(index.begin(), index.end(), ts,
+                               [](BinaryChunkEntry const &entry, unsigned int t){
+                                    return entry.lastTs < t;});
+    if (it==index.end() or it->firstTs > ts) return false;
+
+    loadChunk(it-index.begin());
+
+    size_t recordBytes = sizeof(uint32_t)+recordLength*sizeof(double);
+    for (uint32_t r=0; r<it->nRecords; r++){
+        const char* record = chunkBuffer.data()+r*recordBytes;
+        uint32_t recordTs;
+        std::memcpy(&recordTs, record, sizeof(recordTs));
+        if (recordTs==ts){
+            values.resize(recordLength);
+            std::memcpy(values.data(), record+sizeof(uint32_t), recordLength*sizeof(double));
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Converts the file into text, where each record is written by the formatter.
+void BinaryOutputReader::writeText(std::string textFilePath, Formatter formatter){
+
+    std::ofstream tfs(textFilePath);
+    if (not tfs.is_open()){
+        Report::error("Binary Output Reader!","Couldn't open "+textFilePath);
+    }
+
+    tfs << title << "\n";
+
+    std::vector<double> values(recordLength);
+    size_t recordBytes = sizeof(uint32_t)+recordLength*sizeof(double);
+    for (size_t c=0; c<index.size(); c++){
+        loadChunk(c);
+        for (uint32_t r=0; r<index[c].nRecords; r++){
+            const char* record = chunkBuffer.data()+r*recordBytes;
+            uint32_t ts;
+            std::memcpy(&ts, record, sizeof(ts));
+            std::memcpy(values.data(), record+sizeof(uint32_t), recordLength*sizeof(double));
+            formatter(tfs, ts, values);
+        }
+    }
+}
+
+
+// Writes a record in text: the timestep, followed by a line for each value.
+void BinaryOutputReader::defaultFormatter(std::ostream &os, unsigned int ts, std::vector<double> const &values){
+
+    os << ts << "\n";
+    for (size_t i=0; i<values.size(); i++){
+        os << i+1 << "\t" << values[i] << "\n";
+    }
+}
@@ -0,0 +1,136 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BINARYOUTPUT_H
+#define BINARYOUTPUT_H
+
+#include <cstdint>
+#include <climits>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include "output.h"
+
+namespace OpenHDM {
+
+// --------------------------------------------------------------------
+// BinaryOutput: The class "BinaryOutput" is aimed to be used as a base
+//   class for derived output classes that write raw arrays instead of
+//   formatted text. Each timestep is written as a fixed-size record of
+//   recordLength doubles. Records are grouped into chunks of chunkSize
+//   records, which are optionally compressed (if OpenHDM is built with
+//   OPENHDM_WITH_ZLIB). An index of chunks is appended at the end of
+//   the file, so that the records can be accessed by timestep.
+//
+//   File layout (little-endian; little-endian hosts only):
+//     header:  "OHDMBIN1", version, recordLength, chunkSize,
+//              compression, titleLength, title
+//     chunks:  nRecords, storedBytes, payload. The (uncompressed)
+//              payload of a chunk is nRecords x (ts, recordLength
+//              doubles)
+//     index:   nChunks x (firstTs, lastTs, nRecords, offset)
+//     footer:  nChunks, indexOffset, "OHDMIDX1"
+//
+//   Derived classes implement writeOutput(), which either calls
+//   writeRecord() directly, or (for asynchronous output) fills a buffer
+//   and calls submit().
+// --------------------------------------------------------------------
+
+// An entry of the chunk index:
+struct BinaryChunkEntry{
+    uint32_t firstTs;
+    uint32_t lastTs;
+    uint32_t nRecords;
+    uint64_t offset;
+};
+
+class BinaryOutput: public Output
+{
+public:
+    BinaryOutput(bool isChild_, unsigned recordLength_, unsigned chunkSize_=64, bool compress_=false);
+    virtual ~BinaryOutput();
+
+    virtual void writeHeader();
+    virtual void closeOutputFile();
+
+protected:
+    void writeRecord(unsigned int ts, const double* values);
+    void writeRecord(unsigned int ts, std::vector<double> const &values);
+    virtual void writeSnapshot(unsigned int ts, Buffer const &buffer);
+
+    unsigned get_recordLength() const {return recordLength;}
+
+private:
+    void writeChunk();
+    void writeIndex();
+
+    unsigned recordLength;
+    unsigned chunkSize;
+    bool compress;
+    bool headerWritten = false;
+    unsigned nPending   = 0;        // no. of records in the current chunk
+    uint32_t firstTs    = 0;        // first timestep of the current chunk
+    uint32_t lastTs     = 0;        // last timestep written
+    bool hasRecords     = false;    // whether any record is written to the file
+    std::vector<char> chunkBuffer;  // payload of the current chunk
+    std::vector<BinaryChunkEntry> index;
+};
+
+
+// --------------------------------------------------------------------
+// BinaryOutputReader: Reads the files written by BinaryOutput. Records
+//   can be read by timestep, and files can be converted into text.
+// --------------------------------------------------------------------
+
+class BinaryOutputReader
+{
+public:
+    using Formatter = std::function<void(std::ostream&, unsigned int, std::vector<double> const&)>;
+
+    BinaryOutputReader(std::string filePath_);
+
+    std::string             getTitle()          const {return title;}
+    unsigned                get_recordLength()  const {return recordLength;}
+    size_t                  get_nRecords()      const;
+    std::vector<unsigned>   getTimesteps();
+    bool                    readRecord(unsigned int ts, std::vector<double> &values);
+    void                    writeText(std::string textFilePath, Formatter formatter=defaultFormatter);
+
+    static void defaultFormatter(std::ostream &os, unsigned int ts, std::vector<double> const &values);
+
+private:
+    void readHeader();
+    void readIndex();
+    void loadChunk(size_t c);
+
+    std::string filePath;
+    std::ifstream ifs;
+    std::string title;
+    unsigned recordLength   = 0;
+    unsigned chunkSize      = 0;
+    unsigned compression    = 0;
+    std::vector<BinaryChunkEntry> index;
+    size_t loadedChunk      = SIZE_MAX;
+    std::vector<char> chunkBuffer;  // uncompressed payload of the loaded chunk
+};
+
+} // end of namespace OpenHDM
+
+#endif // BINARYOUTPUT_H
@@ -0,0 +1,169 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cerrno>
+#include <cctype>
+#include <fstream>
+#include <set>
+#include <map>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "report.h"
+#include "checkpoint.h"
+#include "serialization.h"
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the
+// "CheckpointWriter" class defined in checkpoint.h
+// --------------------------------------------------------------------
+
+// Note: This class is Linux-specific (mkdir, opendir) !!!
+
+CheckpointWriter::CheckpointWriter(std::string dir_, unsigned maxPending_):
+    dir(dir_),
+    maxPending(std::max(1u,maxPending_))
+{
+    if ( mkdir(dir.c_str(), 0744) != 0 and errno != EEXIST){
+        Report::error("Checkpoint!",dir+" directory could not be created");
+    }
+    ioThread = std::thread(&CheckpointWriter::ioLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter(){
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+    }
+    queueCond.notify_one();
+    ioThread.join();
+}
+
+
+// Hands over a serialized checkpoint to the I/O thread. Blocks while the queue is full.
+void CheckpointWriter::submit(std::string fileName, std::vector<char> &&buffer){
+
+    std::unique_lock<std::mutex> lock(mtx);
+    spaceCond.wait(lock, [&]{return queue.size()+nWriting < maxPending;});
+    queue.emplace_back(fileName, std::move(buffer));
+    lock.unlock();
+    queueCond.notify_one();
+}
+
+
+// Blocks until all of the submitted checkpoints are written.
+void CheckpointWriter::flush(){
+
+    std::unique_lock<std::mutex> lock(mtx);
+    spaceCond.wait(lock, [&]{return queue.empty() and nWriting==0;});
+}
+
+
+// The main loop of the I/O thread.
+void CheckpointWriter::ioLoop(){
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true){
+        queueCond.wait(lock, [&]{return stop or not queue.empty();});
+        if (queue.empty()) break;   // stop is set and all checkpoints are written
+
+        auto checkpoint = std::move(queue.front());
+        queue.pop_front();
+        nWriting = 1;
+        lock.unlock();
+
+        std::string filePath = dir+"/"+checkpoint.first;
+        std::string tmpPath = filePath+".tmp";
+        {
+            std::ofstream ofs(tmpPath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+            ofs.write(checkpoint.second.data(), checkpoint.second.size());
+            if (not ofs.good()){
+                Report::error("Checkpoint!","Couldn't write "+tmpPath);
+            }
+        }
+        if (std::rename(tmpPath.c_str(), filePath.c_str()) != 0){
+            Report::error("Checkpoint!","Couldn't rename "+tmpPath+" to "+filePath);
+        }
+        OPENHDM_LOG("Checkpoint "+filePath+" is written.",4);
+
+        lock.lock();
+        nWriting = 0;
+        spaceCond.notify_all();
+    }
+}
+
+
+// Returns the name of the checkpoint file of a domain at timestep ts.
+std::string CheckpointWriter::fileName(std::string domainID, unsigned ts){
+    return domainID+"_"+std::to_string(ts)+".chk";
+}
+
+
+// Returns the latest timestep for which valid checkpoints of all of the given domains exist in
+// a directory, or zero if there is no such timestep. The checkpoints of a timestep that are
+// truncated or corrupt, e.g., written by a crashed run, are skipped. (See Domain<>::writeCheckpoint())
+unsigned CheckpointWriter::findLatest(std::string dir, std::vector<std::string> const &domainIDs){
+
+    DIR* d = opendir(dir.c_str());
+    if (not d){
+        Report::error("Checkpoint!","Couldn't open the checkpoint directory "+dir);
+    }
+
+    // Collect the timesteps of the checkpoints of each domain:
+    std::map<unsigned, std::set<std::string>> checkpoints;
+    std::string suffix = ".chk";
+    while (dirent* entry = readdir(d)){
+        std::string name = entry->d_name;
+        if (name.size()<=suffix.size() or
+            name.compare(name.size()-suffix.size(), suffix.size(), suffix)!=0) continue;
+
+        for (auto &domainID : domainIDs){
+            std::string prefix = domainID+"_";
+            if (name.compare(0, prefix.size(), prefix)!=0) continue;
+            std::string tsStr = name.substr(prefix.size(), name.size()-prefix.size()-suffix.size());
+            if (tsStr.empty() or not std::all_of(tsStr.begin(), tsStr.end(), ::isdigit)) continue;
+            checkpoints[std::stoul(tsStr)].insert(domainID);
+        }
+    }
+    closedir(d);
+
+    for (auto it=checkpoints.rbegin(); it!=checkpoints.rend(); ++it){
+        if (it->second.size()!=domainIDs.size()) continue;
+        bool valid = true;
+        for (auto &domainID : domainIDs){
+            std::string filePath = dir+"/"+fileName(domainID, it->first);
+            Deserializer d(filePath);
+            if (not d.verifyChecksum()){
+                Report::warning("Checkpoint!",filePath+" is truncated or corrupt, skipping the "
+                                "checkpoints of timestep "+std::to_string(it->first));
+                valid = false;
+                break;
+            }
+        }
+        if (valid){
+            return it->first;
+        }
+    }
+    return 0;
+}
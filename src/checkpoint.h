@@ -0,0 +1,75 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace OpenHDM {
+
+// --------------------------------------------------------------------
+// CheckpointWriter: Writes the checkpoints of domains asynchronously.
+//   Timestepping threads serialize the domain state into an in-memory
+//   buffer (see Domain<>::writeCheckpoint()) and submit it to the
+//   writer, whose background thread writes the buffer to the
+//   checkpoint directory. Each file is first written to a temporary
+//   file and then renamed, so a checkpoint file is either complete or
+//   absent. submit() blocks when maxPending buffers are pending.
+// --------------------------------------------------------------------
+
+class CheckpointWriter
+{
+public:
+    CheckpointWriter(std::string dir_, unsigned maxPending_=8);
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+    ~CheckpointWriter();
+
+    void submit(std::string fileName, std::vector<char> &&buffer);
+    void flush();
+
+    std::string getDir()const{return dir;}
+
+    // Checkpoint file names and lookup:
+    static std::string fileName(std::string domainID, unsigned ts);
+    static unsigned findLatest(std::string dir, std::vector<std::string> const &domainIDs);
+
+private:
+    void ioLoop();
+
+    std::string dir;
+    unsigned maxPending;
+    bool stop           = false;
+    unsigned nWriting   = 0;
+    std::deque<std::pair<std::string, std::vector<char>>> queue;
+    std::mutex mtx;
+    std::condition_variable queueCond;  // notified when a checkpoint is submitted or stop is set
+    std::condition_variable spaceCond;  // notified when a checkpoint has been written
+    std::thread ioThread;
+};
+
+} // end of namespace OpenHDM
+
+#endif // CHECKPOINT_H
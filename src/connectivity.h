@@ -0,0 +1,273 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <climits>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include "report.h"
+
+namespace OpenHDM {
+
+// --------------------------------------------------------------------
+// Adjacency: The class template "Adjacency" is a compact (CSR)
+//   connectivity structure from the units of type fromType to the
+//   units of type toType within a grid, e.g., node-to-node or
+//   element-to-node adjacency. The neighbors of the unit at position
+//   pos are stored contiguously in indices[offsets[pos]:offsets[pos+1]]
+//   as the positions of toType units. Units at positions beyond the
+//   last row (e.g., newly inserted units) have no neighbors, so the
+//   structure remains consistent as units are inserted to the grid.
+// --------------------------------------------------------------------
+
+template <class fromType, class toType>
+class Adjacency{
+public:
+
+    // A range of neighbor positions:
+    struct Range{
+        const unsigned int* first;
+        const unsigned int* last;
+        const unsigned int* begin()const{return first;}
+        const unsigned int* end()const{return last;}
+        size_t size()const{return last-first;}
+        bool empty()const{return first==last;}
+    };
+
+    void build(std::vector<std::pair<unsigned int,unsigned int>> const &edges);
+    void setNeighbors(unsigned int pos, std::vector<unsigned int> const &neighbors);
+    void clear(){offsets.clear(); indices.clear();}
+
+    Range  neighbors(unsigned int pos)const;
+    size_t degree(unsigned int pos)const{return neighbors(pos).size();}
+    size_t nRows()const{return offsets.empty() ? 0 : offsets.size()-1;}
+    size_t nEdges()const{return indices.size();}
+    bool   empty()const{return indices.empty();}
+
+    // Functions for adjacencies of a unit type to itself: Whether each pair of neighbors is
+    // stored in both directions, and adding the missing reverse pairs.
+    bool isSymmetric()const;
+    void symmetrize();
+
+    // Functions to keep the structure consistent when a unit is removed from the grid and
+    // the positions of the subsequent units are decremented. (See Grid::removeUnit())
+    void removeRow(unsigned int pos);
+    void removeTarget(unsigned int pos);
+
+    // Functions to keep the structure consistent when the units of the grid are reordered.
+    // (See Grid::reorderUnits())
+    void permuteRows(std::vector<unsigned int> const &order);
+    void remapTargets(std::vector<unsigned int> const &old2new);
+
+private:
+    std::vector<unsigned int> offsets;  // (nRows+1) row offsets
+    std::vector<unsigned int> indices;  // neighbor positions
+};
+
+// Constructs the structure from a list of (from,to) position pairs. The neighbors of each unit
+// are sorted and duplicate pairs are removed.
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::build(std::vector<std::pair<unsigned int,unsigned int>> const &edges){
+
+    unsigned int n = 0;
+    for (auto &edge : edges){
+        n = std::max(n, edge.first+1);
+    }
+
+    // Count the neighbors of each row:
+    offsets.assign(n+1, 0);
+    for (auto &edge : edges){
+        offsets[edge.first+1]++;
+    }
+    for (unsigned int i=0; i<n; i++){
+        offsets[i+1] += offsets[i];
+    }
+
+    // Place the neighbors:
+    indices.resize(edges.size());
+    std::vector<unsigned int> next(offsets.begin(), offsets.end()-1);
+    for (auto &edge : edges){
+        indices[next[edge.first]++] = edge.second;
+    }
+
+    // Sort the rows and remove duplicates:
+    unsigned int out = 0;
+    for (unsigned int i=0; i<n; i++){
+        auto first = indices.begin()+offsets[i];
+        auto last = indices.begin()+offsets[i+1];
+        std::sort(first, last);
+        last = std::unique(first, last);
+        unsigned int rowBegin = out;
+        for (auto it=first; it!=last; ++it){
+            indices[out++] = *it;
+        }
+        offsets[i] = rowBegin;
+    }
+    offsets[n] = out;
+    indices.resize(out);
+}
+
+// Returns true if the unit at position j is a neighbor of the unit at position i whenever i is a
+// neighbor of j.
+template <class fromType, class toType>
+bool Adjacency<fromType,toType>::isSymmetric()const{
+
+    for (unsigned int pos=0; pos<nRows(); pos++){
+        for (auto neighbor : neighbors(pos)){
+            auto range = neighbors(neighbor);
+            if (not std::binary_search(range.begin(), range.end(), pos)){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Adds the reverse of each pair of neighbors, e.g., to an adjacency built from a list of directed
+// (from,to) pairs.
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::symmetrize(){
+
+    std::vector<std::pair<unsigned int,unsigned int>> edges;
+    edges.reserve(2*indices.size());
+    for (unsigned int pos=0; pos<nRows(); pos++){
+        for (auto neighbor : neighbors(pos)){
+            edges.emplace_back(pos, neighbor);
+            edges.emplace_back(neighbor, pos);
+        }
+    }
+    build(edges);
+}
+
+// Sets the neighbors of the unit at a given position. Appending the row of a unit beyond the
+// last row takes O(degree) time, whereas replacing an existing row takes O(nEdges) time.
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::setNeighbors(unsigned int pos, std::vector<unsigned int> const &neighbors){
+
+    if (offsets.empty()){
+        offsets.push_back(0);
+    }
+
+    if (pos >= nRows()){
+        // Append empty rows up to pos, and the new row:
+        offsets.resize(pos+1, offsets.back());
+        indices.insert(indices.end(), neighbors.begin(), neighbors.end());
+        offsets.push_back(unsigned(indices.size()));
+    }
+    else{
+        // Replace the existing row:
+        unsigned int first = offsets[pos], last = offsets[pos+1];
+        int diff = int(neighbors.size()) - int(last-first);
+        indices.erase(indices.begin()+first, indices.begin()+last);
+        indices.insert(indices.begin()+first, neighbors.begin(), neighbors.end());
+        for (size_t i=pos+1; i<offsets.size(); i++){
+            offsets[i] += diff;
+        }
+    }
+}
+
+// Returns the positions of the neighbors of the unit at a given position
+template <class fromType, class toType>
+typename Adjacency<fromType,toType>::Range Adjacency<fromType,toType>::neighbors(unsigned int pos)const{
+
+    if (pos >= nRows()){
+        return Range{nullptr, nullptr};
+    }
+    const unsigned int* data = indices.data();
+    return Range{data+offsets[pos], data+offsets[pos+1]};
+}
+
+// Removes the row of a removed fromType unit. The subsequent rows are shifted by one.
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::removeRow(unsigned int pos){
+
+    if (pos >= nRows()) return;
+
+    unsigned int first = offsets[pos], last = offsets[pos+1];
+    indices.erase(indices.begin()+first, indices.begin()+last);
+    offsets.erase(offsets.begin()+pos+1);
+    for (size_t i=pos+1; i<offsets.size(); i++){
+        offsets[i] -= (last-first);
+    }
+}
+
+// Removes the references to a removed toType unit, and decrements the neighbor positions
+// greater than pos.
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::removeTarget(unsigned int pos){
+
+    unsigned int out = 0;
+    for (size_t row=0; row<nRows(); row++){
+        unsigned int rowBegin = out;
+        for (unsigned int i=offsets[row]; i<offsets[row+1]; i++){
+            unsigned int neighbor = indices[i];
+            if (neighbor==pos) continue;
+            indices[out++] = (neighbor>pos) ? neighbor-1 : neighbor;
+        }
+        offsets[row] = rowBegin;
+    }
+    if (not offsets.empty()){
+        offsets.back() = out;
+    }
+    indices.resize(out);
+}
+
+// Reorders the rows such that the new row i is the old row order[i]. (Rows beyond the last row
+// are empty.)
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::permuteRows(std::vector<unsigned int> const &order){
+
+    if (empty()) return;
+
+    std::vector<unsigned int> newOffsets(order.size()+1, 0);
+    std::vector<unsigned int> newIndices;
+    newIndices.reserve(indices.size());
+    for (size_t i=0; i<order.size(); i++){
+        auto range = neighbors(order[i]);
+        newIndices.insert(newIndices.end(), range.begin(), range.end());
+        newOffsets[i+1] = unsigned(newIndices.size());
+    }
+    offsets.swap(newOffsets);
+    indices.swap(newIndices);
+}
+
+// Replaces each neighbor position p with old2new[p], and sorts the rows.
+template <class fromType, class toType>
+void Adjacency<fromType,toType>::remapTargets(std::vector<unsigned int> const &old2new){
+
+    for (auto &neighbor : indices){
+        neighbor = old2new[neighbor];
+    }
+    for (size_t row=0; row<nRows(); row++){
+        std::sort(indices.begin()+offsets[row], indices.begin()+offsets[row+1]);
+    }
+}
+
+
+// AdjacencyRow: The adjacencies from a unit type to each of the unit types of a grid.
+template <class fromType, class ...toTypes>
+using AdjacencyRow = std::tuple<Adjacency<fromType,toTypes>...>;
+
+} // end of namespace OpenHDM
+
+#endif // CONNECTIVITY_H
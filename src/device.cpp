@@ -0,0 +1,291 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include "device.h"
+
+#ifdef OPENHDM_WITH_CUDA
+#include <cuda_runtime.h>
+#endif
+
+using namespace OpenHDM;
+using namespace OpenHDM::Device;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the device backends
+// and the non-template mirror classes defined in device.h
+// --------------------------------------------------------------------
+
+
+// HostBackend:
+
+void* HostBackend::allocate(size_t nBytes){
+    void* ptr = std::malloc(nBytes ? nBytes : 1);
+    if (not ptr){
+        Report::error("Device::HostBackend","Cannot allocate "+std::to_string(nBytes)+" bytes.");
+    }
+    return ptr;
+}
+
+void HostBackend::release(void* devicePtr){
+    std::free(devicePtr);
+}
+
+void HostBackend::toDevice(void* devicePtr, const void* hostPtr, size_t nBytes){
+    std::memcpy(devicePtr, hostPtr, nBytes);
+}
+
+void HostBackend::toHost(void* hostPtr, const void* devicePtr, size_t nBytes){
+    std::memcpy(hostPtr, devicePtr, nBytes);
+}
+
+void HostBackend::copy(void* dstDevicePtr, const void* srcDevicePtr, size_t nBytes){
+    std::memcpy(dstDevicePtr, srcDevicePtr, nBytes);
+}
+
+
+// CudaBackend:
+
+#ifdef OPENHDM_WITH_CUDA
+
+namespace {
+
+void check(cudaError_t err, const char* call){
+    if (err!=cudaSuccess){
+        Report::error("Device::CudaBackend", std::string(call)+" failed: "+cudaGetErrorString(err));
+    }
+}
+
+} // end of anonymous namespace
+
+// (The current device is set for each call, since the mirrors of a domain may be used by the
+// timestepping thread and by the setup threads.)
+CudaBackend::CudaBackend(int device_):
+    device(device_)
+{
+    check(cudaSetDevice(device), "cudaSetDevice");
+}
+
+void* CudaBackend::allocate(size_t nBytes){
+    void* ptr = nullptr;
+    check(cudaSetDevice(device), "cudaSetDevice");
+    check(cudaMalloc(&ptr, nBytes ? nBytes : 1), "cudaMalloc");
+    return ptr;
+}
+
+void CudaBackend::release(void* devicePtr){
+    cudaSetDevice(device);
+    cudaFree(devicePtr);
+}
+
+void CudaBackend::toDevice(void* devicePtr, const void* hostPtr, size_t nBytes){
+    check(cudaSetDevice(device), "cudaSetDevice");
+    check(cudaMemcpy(devicePtr, hostPtr, nBytes, cudaMemcpyHostToDevice), "cudaMemcpy");
+}
+
+void CudaBackend::toHost(void* hostPtr, const void* devicePtr, size_t nBytes){
+    check(cudaSetDevice(device), "cudaSetDevice");
+    check(cudaMemcpy(hostPtr, devicePtr, nBytes, cudaMemcpyDeviceToHost), "cudaMemcpy");
+}
+
+void CudaBackend::copy(void* dstDevicePtr, const void* srcDevicePtr, size_t nBytes){
+    check(cudaSetDevice(device), "cudaSetDevice");
+    check(cudaMemcpy(dstDevicePtr, srcDevicePtr, nBytes, cudaMemcpyDeviceToDevice), "cudaMemcpy");
+}
+
+void CudaBackend::synchronize(){
+    check(cudaSetDevice(device), "cudaSetDevice");
+    check(cudaDeviceSynchronize(), "cudaDeviceSynchronize");
+}
+
+#endif
+
+std::shared_ptr<Backend> Device::getDefaultBackend(){
+
+    static std::once_flag once;
+    static std::shared_ptr<Backend> backend;
+
+    std::call_once(once, []{
+#ifdef OPENHDM_WITH_CUDA
+        int nDevices = 0;
+        if (cudaGetDeviceCount(&nDevices)==cudaSuccess and nDevices>0){
+            backend = std::make_shared<CudaBackend>(0);
+        }
+#endif
+        if (not backend){
+            backend = std::make_shared<HostBackend>();
+        }
+        OPENHDM_LOG("Device backend: "+backend->getName(), 1);
+    });
+    return backend;
+}
+
+
+// Buffer:
+
+Buffer::Buffer(std::shared_ptr<Backend> backend_):
+    backend(backend_)
+{}
+
+Buffer::Buffer(Buffer&& other):
+    backend(other.backend),
+    ptr(other.ptr),
+    nBytes(other.nBytes)
+{
+    other.ptr = nullptr;
+    other.nBytes = 0;
+}
+
+Buffer::~Buffer(){
+    if (ptr) backend->release(ptr);
+}
+
+// Grows the allocation geometrically, preserving the contents
+void Buffer::reserve(size_t nBytes_){
+
+    if (nBytes_<=nBytes) return;
+    size_t newBytes = std::max(nBytes_, 2*nBytes);
+    void* newPtr = backend->allocate(newBytes);
+    if (ptr){
+        backend->copy(newPtr, ptr, nBytes);
+        backend->release(ptr);
+    }
+    ptr = newPtr;
+    nBytes = newBytes;
+}
+
+
+// FieldMirror:
+
+FieldMirror::FieldMirror(std::shared_ptr<Backend> backend_, size_t elemSize_):
+    backend(backend_),
+    buffer(backend_),
+    elemSize(elemSize_)
+{
+    hostModified.add(0, SIZE_MAX);
+}
+
+// Transfers the range modified on the host, along with the elements appended since the last
+// transfer, to the device
+void FieldMirror::toDevice(const void* hostPtr, size_t n){
+
+    if (n>mirroredSize){
+        buffer.reserve(n*elemSize);
+        hostModified.add(mirroredSize, n);
+        mirroredSize = n;
+    }
+    else if (n<mirroredSize){
+        mirroredSize = n;
+    }
+    size_t end = std::min(hostModified.end, n);
+    if (hostModified.begin<end){
+        size_t offset = hostModified.begin*elemSize;
+        size_t nBytes = (end-hostModified.begin)*elemSize;
+        backend->toDevice(static_cast<char*>(buffer.data())+offset,
+                          static_cast<const char*>(hostPtr)+offset, nBytes);
+        transferredBytes += nBytes;
+    }
+    hostModified.clear();
+}
+
+// Transfers the range modified on the device to the host
+void FieldMirror::toHost(void* hostPtr, size_t n){
+
+    size_t end = std::min({deviceModified.end, n, mirroredSize});
+    if (deviceModified.begin<end){
+        size_t offset = deviceModified.begin*elemSize;
+        size_t nBytes = (end-deviceModified.begin)*elemSize;
+        backend->synchronize();
+        backend->toHost(static_cast<char*>(hostPtr)+offset,
+                        static_cast<const char*>(buffer.data())+offset, nBytes);
+        transferredBytes += nBytes;
+    }
+    deviceModified.clear();
+}
+
+
+// Access:
+
+Access& Access::add(std::shared_ptr<Mirror> mirror, unsigned field, Mode mode,
+                    size_t begin, size_t end){
+    if (field>=mirror->get_nFields()){
+        Report::error("Device::Access","Invalid field: "+std::to_string(field));
+    }
+    if (begin>end){
+        Report::error("Device::Access","Invalid range of field "+std::to_string(field)+": ["+
+                      std::to_string(begin)+","+std::to_string(end)+")");
+    }
+    entries.push_back({mirror, field, mode, begin, end});
+    return *this;
+}
+
+Access& Access::reads(std::shared_ptr<Mirror> mirror, unsigned field){
+    return add(mirror, field, Read);
+}
+
+Access& Access::writes(std::shared_ptr<Mirror> mirror, unsigned field, size_t begin, size_t end){
+    return add(mirror, field, Write, begin, end);
+}
+
+Access& Access::exports(std::shared_ptr<Mirror> mirror, unsigned field, size_t begin, size_t end){
+    return add(mirror, field, Export, begin, end);
+}
+
+Access& Access::reads(std::shared_ptr<Mirror> mirror){
+    for (unsigned f=0; f<mirror->get_nFields(); f++) reads(mirror, f);
+    return *this;
+}
+
+Access& Access::writes(std::shared_ptr<Mirror> mirror){
+    for (unsigned f=0; f<mirror->get_nFields(); f++) writes(mirror, f);
+    return *this;
+}
+
+// Transfers the accessed fields modified on the host to the device
+void Access::beginDevicePhase(){
+    for (auto &entry : entries){
+        entry.mirror->toDevice(entry.field);
+    }
+}
+
+void Access::endDevicePhase(){
+    for (auto &entry : entries){
+        if (entry.mode==Read) continue;
+        entry.mirror->markDeviceModified(entry.field, entry.begin, entry.end);
+        if (entry.mode==Export){
+            entry.mirror->toHost(entry.field);
+        }
+    }
+}
+
+// Transfers the accessed fields modified on the device to the host
+void Access::beginHostPhase(){
+    for (auto &entry : entries){
+        entry.mirror->toHost(entry.field);
+    }
+}
+
+void Access::endHostPhase(){
+    for (auto &entry : entries){
+        if (entry.mode==Read) continue;
+        entry.mirror->markHostModified(entry.field, entry.begin, entry.end);
+    }
+}
@@ -0,0 +1,448 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DEVICE_H
+#define DEVICE_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "unitcolumns.h"
+#include "report.h"
+
+namespace OpenHDM {
+namespace Device {
+
+// --------------------------------------------------------------------
+// Device: Mirrors of the grid data in device (e.g., GPU) memory, for
+//   the phases of a domain executed on a device. A mirror holds flat
+//   copies of the field columns of a columnar unit type (see
+//   unitcolumns.h: UnitColumns), or of the unit positions of a patch,
+//   and tracks the ranges modified on the host and on the device, so
+//   that only the modified ranges are transferred at phase boundaries.
+//   The phases declare the fields they access (see Access), e.g.,
+//
+//     auto nodes = std::make_shared<ColumnsMirror<Node>>(grid->getColumns<Node>());
+//     auto wet = std::make_shared<PositionsMirror<Node>>(patch.getPositionList<Node>());
+//     addMirror(nodes); addMirror(wet);
+//
+//     insertDevicePhase([=](unsigned ts){
+//         launchContinuity(nodes->device<Node::ETA>(), wet->device(), wet->size(), ts);
+//     }, Access().reads(wet).reads(nodes, Node::U).writes(nodes, Node::ETA));
+//
+//   See Domain::insertDevicePhase().
+// --------------------------------------------------------------------
+
+
+// --------------------------------------------------------------------
+// Backend: The interface to the memory of a device. HostBackend keeps
+//   the "device" memory in host memory, e.g., for testing the device
+//   phases on the host, and CudaBackend (if OPENHDM_WITH_CUDA) uses
+//   the CUDA runtime.
+// --------------------------------------------------------------------
+
+class Backend{
+public:
+    virtual ~Backend(){}
+
+    virtual std::string getName()const=0;
+    virtual void* allocate(size_t nBytes)=0;
+    virtual void release(void* devicePtr)=0;
+    virtual void toDevice(void* devicePtr, const void* hostPtr, size_t nBytes)=0;
+    virtual void toHost(void* hostPtr, const void* devicePtr, size_t nBytes)=0;
+    virtual void copy(void* dstDevicePtr, const void* srcDevicePtr, size_t nBytes)=0;
+    virtual void synchronize()=0;   // waits for the kernels and transfers issued
+};
+
+class HostBackend: public Backend{
+public:
+    std::string getName()const override{return "host";}
+    void* allocate(size_t nBytes) override;
+    void release(void* devicePtr) override;
+    void toDevice(void* devicePtr, const void* hostPtr, size_t nBytes) override;
+    void toHost(void* hostPtr, const void* devicePtr, size_t nBytes) override;
+    void copy(void* dstDevicePtr, const void* srcDevicePtr, size_t nBytes) override;
+    void synchronize() override{}
+};
+
+#ifdef OPENHDM_WITH_CUDA
+class CudaBackend: public Backend{
+public:
+    CudaBackend(int device_=0);
+    std::string getName()const override{return "cuda:"+std::to_string(device);}
+    void* allocate(size_t nBytes) override;
+    void release(void* devicePtr) override;
+    void toDevice(void* devicePtr, const void* hostPtr, size_t nBytes) override;
+    void toHost(void* hostPtr, const void* devicePtr, size_t nBytes) override;
+    void copy(void* dstDevicePtr, const void* srcDevicePtr, size_t nBytes) override;
+    void synchronize() override;
+private:
+    int device;
+};
+#endif
+
+// Returns the CUDA backend of the first device if available, and the host backend otherwise
+std::shared_ptr<Backend> getDefaultBackend();
+
+
+// --------------------------------------------------------------------
+// Buffer: A contiguous allocation of device memory (RAII), which grows
+//   as a vector, i.e., the contents are preserved.
+// --------------------------------------------------------------------
+
+class Buffer{
+public:
+    Buffer(std::shared_ptr<Backend> backend_);
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+    Buffer(Buffer&& other);
+    ~Buffer();
+
+    void reserve(size_t nBytes_);
+    void* data(){return ptr;}
+    const void* data()const{return ptr;}
+    size_t capacity()const{return nBytes;}
+
+private:
+    std::shared_ptr<Backend> backend;
+    void* ptr = nullptr;
+    size_t nBytes = 0;
+};
+
+
+// --------------------------------------------------------------------
+// Range: A range [begin,end) of the elements of a field, expanded to
+//   cover the ranges added.
+// --------------------------------------------------------------------
+
+struct Range{
+    size_t begin = SIZE_MAX;
+    size_t end = 0;
+
+    void add(size_t begin_, size_t end_){
+        begin = std::min(begin, begin_);
+        end = std::max(end, end_);
+    }
+    bool empty()const{return begin>=end;}
+    void clear(){begin = SIZE_MAX; end = 0;}
+};
+
+
+// --------------------------------------------------------------------
+// FieldMirror: The device copy of a host array of trivially copyable
+//   elements, e.g., a field column, along with the ranges modified on
+//   either side since the last transfer.
+// --------------------------------------------------------------------
+
+class FieldMirror{
+public:
+    FieldMirror(std::shared_ptr<Backend> backend_, size_t elemSize_);
+
+    void toDevice(const void* hostPtr, size_t n);
+    void toHost(void* hostPtr, size_t n);
+
+    void* data(){return buffer.data();}
+
+    Range hostModified;                 // (initially, the whole array)
+    Range deviceModified;
+    size_t transferredBytes = 0;        // total bytes transferred in both directions
+
+private:
+    std::shared_ptr<Backend> backend;
+    Buffer buffer;
+    size_t elemSize;
+    size_t mirroredSize = 0;            // no. of elements of the device copy
+};
+
+
+// --------------------------------------------------------------------
+// Mirror: The interface of the mirrors, through which the fields are
+//   synchronized at phase boundaries. (See Access)
+// --------------------------------------------------------------------
+
+class Mirror{
+public:
+    virtual ~Mirror(){}
+
+    virtual unsigned get_nFields()const=0;
+    virtual void toDevice(unsigned field)=0;            // transfers the range modified on the host
+    virtual void toHost(unsigned field)=0;              // transfers the range modified on the device
+    virtual size_t getTransferredBytes()const=0;
+
+    // Marks the range [begin,end) of unit positions of a field as modified:
+    virtual void markHostModified(unsigned field, size_t begin, size_t end)=0;
+    virtual void markDeviceModified(unsigned field, size_t begin, size_t end)=0;
+
+    // The whole field:
+    void markHostModified(unsigned field){markHostModified(field, 0, SIZE_MAX);}
+    void markDeviceModified(unsigned field){markDeviceModified(field, 0, SIZE_MAX);}
+
+    // All of the fields:
+    void toDevice(){for (unsigned f=0; f<get_nFields(); f++) toDevice(f);}
+    void toHost(){for (unsigned f=0; f<get_nFields(); f++) toHost(f);}
+    void markHostModified(){for (unsigned f=0; f<get_nFields(); f++) markHostModified(f);}
+};
+
+
+// --------------------------------------------------------------------
+// ColumnsMirror: The mirror of the field columns of a columnar unit
+//   type, i.e., a flat device array for each field. The units inserted
+//   on the host are transferred with the next transfer of each field,
+//   and if the units are reordered or reloaded (see Grid::reorderUnits()
+//   and Grid::loadSnapshot()), all of the fields are transferred. The
+//   ranges of the units modified by the host or device code outside of
+//   the declared phase accesses can be marked explicitly. (The shared
+//   fields a child borrows from its parent are copied into the child
+//   columns to be mirrored.)
+// --------------------------------------------------------------------
+
+template <class unitType>
+class ColumnsMirror: public Mirror{
+public:
+
+    static constexpr size_t nFields = unitType::nFields;
+
+    template <size_t I>
+    using fieldType = typename UnitColumns<unitType>::template fieldType<I>;
+
+    ColumnsMirror(UnitColumns<unitType> &columns_, std::shared_ptr<Backend> backend=getDefaultBackend());
+
+    // device pointers of the columns (valid until the next transfer of the column):
+    template <size_t I>
+    fieldType<I>* device(){return static_cast<fieldType<I>*>(fields[I].data());}
+    size_t size()const{return columns.size();}
+
+    unsigned get_nFields()const override{return unsigned(nFields);}
+    void toDevice(unsigned field) override;
+    void toHost(unsigned field) override;
+    void markHostModified(unsigned field, size_t begin, size_t end) override;
+    void markDeviceModified(unsigned field, size_t begin, size_t end) override;
+    size_t getTransferredBytes()const override;
+
+    using Mirror::toDevice;
+    using Mirror::toHost;
+    using Mirror::markHostModified;
+    using Mirror::markDeviceModified;
+
+private:
+
+    template <size_t ...I>
+    static std::array<std::pair<void*,size_t>,nFields> columnTable(UnitColumns<unitType> &columns,
+                                                                    std::index_sequence<I...>);
+    template <size_t ...I>
+    static constexpr bool triviallyCopyable(std::index_sequence<I...>);
+
+    void checkGeneration();
+
+    UnitColumns<unitType> &columns;
+    std::vector<FieldMirror> fields;
+    uint64_t generation;
+};
+
+template <class unitType>
+ColumnsMirror<unitType>::ColumnsMirror(UnitColumns<unitType> &columns_, std::shared_ptr<Backend> backend):
+    columns(columns_),
+    generation(columns_.getGeneration())
+{
+    static_assert(triviallyCopyable(std::make_index_sequence<nFields>()),
+                  "The fields of the mirrored unit type must be trivially copyable");
+
+    auto table = columnTable(columns, std::make_index_sequence<nFields>());
+    fields.reserve(nFields);
+    for (size_t i=0; i<nFields; i++){
+        fields.emplace_back(backend, table[i].second);
+    }
+}
+
+template <class unitType>
+void ColumnsMirror<unitType>::toDevice(unsigned field){
+    checkGeneration();
+    auto table = columnTable(columns, std::make_index_sequence<nFields>());
+    fields[field].toDevice(table[field].first, columns.size());
+}
+
+template <class unitType>
+void ColumnsMirror<unitType>::toHost(unsigned field){
+    checkGeneration();
+    auto table = columnTable(columns, std::make_index_sequence<nFields>());
+    fields[field].toHost(table[field].first, columns.size());
+}
+
+template <class unitType>
+void ColumnsMirror<unitType>::markHostModified(unsigned field, size_t begin, size_t end){
+    fields[field].hostModified.add(begin, end);
+}
+
+template <class unitType>
+void ColumnsMirror<unitType>::markDeviceModified(unsigned field, size_t begin, size_t end){
+    fields[field].deviceModified.add(begin, end);
+}
+
+template <class unitType>
+size_t ColumnsMirror<unitType>::getTransferredBytes()const{
+    size_t n = 0;
+    for (auto &field : fields){
+        n += field.transferredBytes;
+    }
+    return n;
+}
+
+// Once the units are reordered or reloaded on the host, the device copies are out of date. (The
+// fields modified on the device must be transferred to the host beforehand.)
+template <class unitType>
+void ColumnsMirror<unitType>::checkGeneration(){
+
+    if (generation==columns.getGeneration()) return;
+    generation = columns.getGeneration();
+    for (auto &field : fields){
+        field.deviceModified.clear();
+        field.hostModified.add(0, SIZE_MAX);
+    }
+}
+
+// Returns the host pointers and the element sizes of the columns
+template <class unitType>
+template <size_t ...I>
+std::array<std::pair<void*,size_t>,ColumnsMirror<unitType>::nFields>
+ColumnsMirror<unitType>::columnTable(UnitColumns<unitType> &columns, std::index_sequence<I...>){
+    return {{ std::pair<void*,size_t>(columns.template column<I>().data(), sizeof(fieldType<I>))... }};
+}
+
+template <class unitType>
+template <size_t ...I>
+constexpr bool ColumnsMirror<unitType>::triviallyCopyable(std::index_sequence<I...>){
+    bool all = true;
+    using expand = bool[];
+    (void)expand{true, (all = all and std::is_trivially_copyable<fieldType<I>>::value)...};
+    return all;
+}
+
+
+// --------------------------------------------------------------------
+// PositionsMirror: The mirror of the unit positions of a patch, e.g.,
+//   the index list of the active units over which the device kernels
+//   iterate. The modified range of the list is recorded by the patch
+//   (see PositionList), so that the list is updated incrementally as
+//   the patch changes. The list is read-only on the device.
+// --------------------------------------------------------------------
+
+template <class unitType>
+class PositionsMirror: public Mirror{
+public:
+
+    PositionsMirror(PositionList<unitType> const &positions_, std::shared_ptr<Backend> backend=getDefaultBackend());
+
+    const unsigned* device(){return static_cast<const unsigned*>(list.data());}
+    size_t size()const{return positions.size();}
+
+    unsigned get_nFields()const override{return 1;}
+    void toDevice(unsigned field) override;
+    void toHost(unsigned) override{}
+    void markHostModified(unsigned, size_t, size_t) override{}     // (recorded by the list itself)
+    void markDeviceModified(unsigned, size_t, size_t) override;
+    size_t getTransferredBytes()const override{return list.transferredBytes;}
+
+    using Mirror::toDevice;
+    using Mirror::toHost;
+    using Mirror::markHostModified;
+    using Mirror::markDeviceModified;
+
+private:
+    PositionList<unitType> const &positions;
+    FieldMirror list;
+};
+
+template <class unitType>
+PositionsMirror<unitType>::PositionsMirror(PositionList<unitType> const &positions_,
+                                           std::shared_ptr<Backend> backend):
+    positions(positions_),
+    list(backend, sizeof(unsigned))
+{
+    list.hostModified.clear();      // the modified range is recorded by the list
+}
+
+template <class unitType>
+void PositionsMirror<unitType>::toDevice(unsigned){
+
+    list.hostModified.add(positions.modifiedBegin, positions.modifiedEnd);
+    positions.modifiedBegin = SIZE_MAX;
+    positions.modifiedEnd = 0;
+    list.toDevice(positions.data(), positions.size());
+}
+
+template <class unitType>
+void PositionsMirror<unitType>::markDeviceModified(unsigned, size_t, size_t){
+    Report::error("Device::PositionsMirror","The unit positions cannot be modified on the device.");
+}
+
+
+// --------------------------------------------------------------------
+// Access: The fields accessed by a phase, i.e., the (mirror, field)
+//   pairs the phase reads, writes (and reads), or exports, i.e., writes
+//   on the device and transfers to the host at the end of the phase,
+//   e.g., the boundary fields of a parent read by its children. Before
+//   a device phase, the accessed fields modified on the host are
+//   transferred to the device, and before a host phase, those modified
+//   on the device are transferred to the host. A write or export may
+//   declare the range [begin,end) of unit positions the phase modifies,
+//   so that only that range is transferred; otherwise, the whole field
+//   is treated as modified.
+// --------------------------------------------------------------------
+
+class Access{
+public:
+
+    Access& reads(std::shared_ptr<Mirror> mirror, unsigned field);
+    Access& writes(std::shared_ptr<Mirror> mirror, unsigned field, size_t begin=0, size_t end=SIZE_MAX);
+    Access& exports(std::shared_ptr<Mirror> mirror, unsigned field, size_t begin=0, size_t end=SIZE_MAX);
+
+    // All of the fields of a mirror:
+    Access& reads(std::shared_ptr<Mirror> mirror);
+    Access& writes(std::shared_ptr<Mirror> mirror);
+
+    void beginDevicePhase();
+    void endDevicePhase();
+    void beginHostPhase();
+    void endHostPhase();
+
+private:
+
+    enum Mode: uint8_t {Read, Write, Export};
+
+    struct Entry{
+        std::shared_ptr<Mirror> mirror;
+        unsigned field;
+        Mode mode;
+        size_t begin, end;      // the modified range of unit positions
+    };
+
+    Access& add(std::shared_ptr<Mirror> mirror, unsigned field, Mode mode,
+                size_t begin=0, size_t end=SIZE_MAX);
+
+    std::vector<Entry> entries;
+};
+
+} // end of namespace Device
+} // end of namespace OpenHDM
+
+#endif // DEVICE_H
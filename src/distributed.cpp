@@ -0,0 +1,550 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <climits>
+#include <condition_variable>
+#include <map>
+#include <tuple>
+#include "distributed.h"
+
+using namespace OpenHDM;
+using namespace OpenHDM::Distributed;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the communicators
+// and the class "Link" defined in distributed.h
+// --------------------------------------------------------------------
+
+
+// The mailboxes and the reduction state shared by the ranks of a LocalCommunicator:
+struct LocalCommunicator::Hub{
+    int nRanks = 0;
+    std::mutex mtx;
+    std::condition_variable cond;
+    std::map<std::tuple<int,int,int>,std::deque<std::vector<char>>> mailboxes; // (source,dest,tag)
+
+    unsigned generation = 0;    // no. of completed reductions
+    int nArrived        = 0;
+    uint64_t minValue   = UINT64_MAX;
+    uint64_t result     = 0;
+};
+
+// Creates the communicators of nRanks emulated ranks
+std::vector<std::shared_ptr<Communicator>> LocalCommunicator::create(int nRanks){
+
+    auto hub = std::make_shared<Hub>();
+    hub->nRanks = std::max(1, nRanks);
+
+    std::vector<std::shared_ptr<Communicator>> comms;
+    for (int r=0; r<hub->nRanks; r++){
+        comms.emplace_back(new LocalCommunicator(hub, r));
+    }
+    return comms;
+}
+
+LocalCommunicator::LocalCommunicator(std::shared_ptr<Hub> hub_, int rank__):
+    hub(hub_),
+    rank_(rank__)
+{
+
+}
+
+int LocalCommunicator::size()const{
+    return hub->nRanks;
+}
+
+void LocalCommunicator::send(int dest, int tag, std::vector<char> const &message){
+
+    if (dest<0 or dest>=hub->nRanks){
+        Report::error("LocalCommunicator","Invalid destination rank "+std::to_string(dest));
+    }
+
+    std::lock_guard<std::mutex> lock(hub->mtx);
+    hub->mailboxes[std::make_tuple(rank_,dest,tag)].push_back(message);
+    hub->cond.notify_all();
+}
+
+std::vector<char> LocalCommunicator::recv(int source, int tag){
+
+    std::unique_lock<std::mutex> lock(hub->mtx);
+    auto &mailbox = hub->mailboxes[std::make_tuple(source,rank_,tag)];
+    hub->cond.wait(lock, [&]{return not mailbox.empty();});
+
+    std::vector<char> message = std::move(mailbox.front());
+    mailbox.pop_front();
+    return message;
+}
+
+uint64_t LocalCommunicator::reduceMin(uint64_t value){
+
+    std::unique_lock<std::mutex> lock(hub->mtx);
+    unsigned generation = hub->generation;
+    hub->minValue = std::min(hub->minValue, value);
+
+    if (++(hub->nArrived) == hub->nRanks){
+        hub->result = hub->minValue;
+        hub->minValue = UINT64_MAX;
+        hub->nArrived = 0;
+        hub->generation++;
+        hub->cond.notify_all();
+    }
+    else{
+        hub->cond.wait(lock, [&]{return hub->generation!=generation;});
+    }
+    return hub->result;
+}
+
+
+#ifdef OPENHDM_WITH_MPI
+
+MPICommunicator::MPICommunicator(MPI_Comm comm_):
+    comm(comm_)
+{
+    int initialized = 0;
+    MPI_Initialized(&initialized);
+    if (not initialized){
+        Report::error("MPICommunicator","MPI is not initialized.");
+    }
+
+    int provided = 0;
+    MPI_Query_thread(&provided);
+    if (provided<MPI_THREAD_MULTIPLE){
+        Report::error("MPICommunicator","MPI must be initialized with MPI_THREAD_MULTIPLE support.");
+    }
+
+    MPI_Comm_rank(comm, &rank_);
+    MPI_Comm_size(comm, &size_);
+}
+
+MPICommunicator::~MPICommunicator(){
+    std::lock_guard<std::mutex> lock(mtx);
+    completeSends(true);
+}
+
+void MPICommunicator::send(int dest, int tag, std::vector<char> const &message){
+
+    if (message.size()>size_t(INT_MAX)){
+        Report::error("MPICommunicator","Message size exceeds the limit of MPI counts.");
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    completeSends(false);
+
+    pending.emplace_back(message, MPI_REQUEST_NULL);
+    auto &buffer = pending.back();
+    MPI_Isend(buffer.first.data(), int(buffer.first.size()), MPI_BYTE, dest, tag, comm, &buffer.second);
+}
+
+std::vector<char> MPICommunicator::recv(int source, int tag){
+
+    // Matched probe, so that the message cannot be received by another thread in between:
+    MPI_Message msg;
+    MPI_Status status;
+    MPI_Mprobe(source, tag, comm, &msg, &status);
+
+    int n = 0;
+    MPI_Get_count(&status, MPI_BYTE, &n);
+    std::vector<char> message(n);
+    MPI_Mrecv(message.data(), n, MPI_BYTE, &msg, MPI_STATUS_IGNORE);
+    return message;
+}
+
+uint64_t MPICommunicator::reduceMin(uint64_t value){
+
+    unsigned long long local = value, result = 0;
+    MPI_Allreduce(&local, &result, 1, MPI_UNSIGNED_LONG_LONG, MPI_MIN, comm);
+    return uint64_t(result);
+}
+
+// Frees the buffers of the completed sends. If wait is true, waits for all of the sends to complete.
+void MPICommunicator::completeSends(bool wait){
+
+    for (auto it=pending.begin(); it!=pending.end(); ){
+        int completed = 1;
+        if (wait){
+            MPI_Wait(&it->second, MPI_STATUS_IGNORE);
+        }
+        else{
+            MPI_Test(&it->second, &completed, MPI_STATUS_IGNORE);
+        }
+        it = completed ? pending.erase(it) : std::next(it);
+    }
+}
+
+#endif // OPENHDM_WITH_MPI
+
+
+// Link constructor. The peer is the rank of the remote side, and the tag identifies the link
+// among the links between the two ranks.
+Link::Link(std::shared_ptr<Communicator> comm_, int peer_, int tag_):
+    comm(comm_),
+    peer(peer_),
+    tag(tag_)
+{
+
+}
+
+Link::~Link(){
+    if (progressThread.joinable()){
+        progressThread.join();
+    }
+}
+
+// Adds the control point of a local domain, i.e., the parent or one of the children sharing the link.
+// The function onBoundary of a child, if given, is called by the progress thread with the count of
+// the parent phase whose boundary values are unpacked into the shadow parent. (e.g., lagged children,
+// see Domain::setLagWindow())
+void Link::addLocal(Threading::ControlPoint &localCP, std::function<void(uint64_t)> onBoundary_){
+    localCPs.push_back(&localCP);
+    localPositions.emplace_back();
+    if (onBoundary_){
+        onBoundary.push_back(std::move(onBoundary_));
+    }
+}
+
+// Assigns the boundary fields of the shadow parent into which the received values are unpacked.
+void Link::setShadowFields(std::vector<BoundaryField> const *fields){
+    shadowFields = fields;
+}
+
+// Called by each local domain before timestepping. The first call exchanges the initial states with
+// the remote side and launches the progress thread.
+void Link::start(unsigned int nts){
+
+    std::lock_guard<std::mutex> lock(startMtx);
+    if (not started){
+        handshake(nts);
+        started = true;
+    }
+}
+
+// Called by each local domain after timestepping. Once all of the local domains are finished, the
+// remote side is notified, and the link waits for the remote side to finish as well.
+void Link::finish(){
+
+    std::lock_guard<std::mutex> lock(startMtx);
+    if (++nFinished < localCPs.size()) return;
+
+    Serializer s;
+    s.write(uint8_t(Final));
+    comm->send(peer, tag, s.getBuffer());
+
+    if (progressThread.joinable()){
+        progressThread.join();
+    }
+}
+
+// Exchanges the initial states of the two sides. The domains must have the same number of phases and
+// timesteps (unless the children are subcycled, see Domain::setTimestepRatio()), and must begin
+// timestepping from the same state, e.g., from the checkpoints of the same timestep.
+void Link::handshake(unsigned int nts){
+
+    Threading::ControlPoint &localCP = *localCPs.front();
+    for (auto cpPtr : localCPs){
+        if (cpPtr->ncp!=localCP.ncp or cpPtr->ratio!=localCP.ratio or cpPtr->lag!=localCP.lag){
+            Report::error("Distributed::Link","The children of a parent domain on the same rank must"
+                          " have the same number of phases, timestep ratio and lag window."
+                          " (tag "+std::to_string(tag)+")");
+        }
+    }
+
+    postedState = getLocalState();
+
+    Serializer s;
+    s.write(uint8_t(Hello));
+    s.write(postedState);
+    s.write(localCP.ncp);
+    s.write(localCP.ratio);
+    s.write(localCP.lag);
+    s.write(nts);
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        writePositions(s);
+    }
+    comm->send(peer, tag, s.getBuffer());
+
+    Deserializer d(comm->recv(peer, tag));
+    if (d.get<uint8_t>()!=Hello){
+        Report::error("Distributed::Link","Unexpected message from rank "+std::to_string(peer)+
+                      " (tag "+std::to_string(tag)+") at the beginning of timestepping.");
+    }
+    uint64_t state = d.get<uint64_t>();
+    unsigned int ncp = d.get<unsigned int>();
+    unsigned int ratio = d.get<unsigned int>();
+    unsigned int lag = d.get<unsigned int>();
+    unsigned int remoteNts = d.get<unsigned int>();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        readPositions(d);
+    }
+
+    bool stepwise = (ratio>1 or lag>0 or localCP.isStepwise());
+    if ((not stepwise and ncp!=localCP.ncp) or remoteNts/ratio!=nts/localCP.ratio){
+        Report::error("Distributed::Link","The numbers of phases and timesteps of the linked domains"
+                      " (tag "+std::to_string(tag)+") are inconsistent.");
+    }
+
+    // The domains must begin from the same state, or from the same parent timestep if stepwise:
+    auto parentSteps = [](uint64_t state_, unsigned int ncp_, unsigned int ratio_){
+        return ncp_>0 ? Threading::ControlPoint::countOf(state_)/(uint64_t(ratio_)*ncp_) : 0;
+    };
+    if (stepwise ? parentSteps(state, ncp, ratio)!=parentSteps(postedState, localCP.ncp, localCP.ratio)
+                  : state!=postedState){
+        Report::error("Distributed::Link","The linked domains (tag "+std::to_string(tag)+
+                      ") begin timestepping from different states.");
+    }
+
+    remoteCP.ncp = ncp;
+    remoteCP.ratio = ratio;
+    remoteCP.lag = lag;
+    remoteCP.state.store(state, std::memory_order_release);
+
+    progressThread = std::thread(&Link::progress, this);
+}
+
+// Returns the state of the least advanced local domain
+uint64_t Link::getLocalState()const{
+
+    uint64_t state = UINT64_MAX;
+    for (auto cpPtr : localCPs){
+        state = std::min(state, cpPtr->getState());
+    }
+    return state;
+}
+
+// Sends the state of the local side if it has advanced, along with the boundary positions that are
+// updated after the last state sent.
+void Link::postState(){
+
+    std::lock_guard<std::mutex> lock(mtx);
+    uint64_t state = getLocalState();
+    if (state<=postedState) return;
+    postedState = state;
+
+    Serializer s;
+    bool updated = std::find(positionsUpdated.begin(), positionsUpdated.end(), true)!=positionsUpdated.end();
+    s.write(uint8_t(updated ? StateWithPositions : State));
+    s.write(state);
+    if (updated){
+        writePositions(s);
+    }
+    comm->send(peer, tag, s.getBuffer());
+}
+
+// Sends the state of the local parent, along with the packed values of the boundary fields at the
+// boundary positions of the remote children.
+void Link::postState(std::vector<BoundaryField> const &fields){
+
+    std::lock_guard<std::mutex> lock(mtx);
+    postedState = getLocalState();
+
+    Serializer s;
+    s.write(uint8_t(StateWithBoundary));
+    s.write(postedState);
+    s.write(unsigned(fields.size()));
+
+    static const PositionSet noPositions;
+    std::vector<double> values;
+    for (size_t i=0; i<fields.size(); i++){
+        unsigned int set = fields[i].set;
+        PositionSet const &positionSet = set<positionSets.size() ? positionSets[set] : noPositions;
+        auto const &transfer = getTransfer(i, fields[i], positionSet);
+        values.resize(transfer.size());
+        transfer.apply(fields[i].data(), values.data());
+        s.write(positionSet.version);
+        s.write(values);
+    }
+    comm->send(peer, tag, s.getBuffer());
+}
+
+// Sets a boundary position set of a local child, i.e., the positions of the parent units whose values
+// are accessed by the child. The union of the positions of the children is sent to the parent along
+// with the next state.
+void Link::setBoundaryPositions(Threading::ControlPoint const &localCP, unsigned int set,
+                                std::vector<unsigned int> positions){
+
+    size_t local = std::find(localCPs.begin(), localCPs.end(), &localCP)-localCPs.begin();
+    if (local>=localCPs.size()){
+        Report::error("Distributed::Link","The domain is not linked. (tag "+std::to_string(tag)+")");
+    }
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (set>=positionsUpdated.size()){
+        positionsUpdated.resize(set+1, false);
+        positionHistory.resize(set+1);
+    }
+    if (set>=localPositions[local].size()){
+        localPositions[local].resize(set+1);
+    }
+    localPositions[local][set] = std::move(positions);
+    positionsUpdated[set] = true;
+}
+
+// Receives the messages of the remote side until it finishes timestepping. Each state received is
+// stored in the mirrored control point after its contents are processed, i.e., after the boundary
+// values are unpacked, and the local domains are notified.
+void Link::progress(){
+
+    while (true){
+        Deserializer d(comm->recv(peer, tag));
+        uint8_t kind = d.get<uint8_t>();
+        if (kind==Final) return;
+
+        uint64_t state = d.get<uint64_t>();
+        switch (kind){
+            case State:
+                break;
+            case StateWithPositions:{
+                std::lock_guard<std::mutex> lock(mtx);
+                readPositions(d);
+                break;
+            }
+            case StateWithBoundary:{
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    unpackBoundary(d);
+                }
+                for (auto &f : onBoundary){
+                    f(Threading::ControlPoint::countOf(state));
+                }
+                break;
+            }
+            default:
+                Report::error("Distributed::Link","Unexpected message from rank "+std::to_string(peer)+
+                              " (tag "+std::to_string(tag)+")");
+        }
+
+        remoteCP.state.store(state, std::memory_order_release);
+        for (auto cpPtr : localCPs){
+            cpPtr->signal.notify();
+        }
+    }
+}
+
+// Unpacks the boundary values received from the parent into the fields of the shadow parent. The
+// positions are those of the union the parent has packed the values with. (mtx must be locked)
+void Link::unpackBoundary(Deserializer &d){
+
+    if (not shadowFields or d.get<unsigned>()!=shadowFields->size()){
+        Report::error("Distributed::Link","The number of boundary fields of the parent domain is"
+                      " not the same on all ranks. (tag "+std::to_string(tag)+")");
+    }
+
+    static const PositionSet noPositions;
+    std::vector<double> values;
+    for (size_t i=0; i<shadowFields->size(); i++){
+        BoundaryField const &field = (*shadowFields)[i];
+        unsigned int version = d.get<unsigned int>();
+        d.read(values);
+
+        // Drop the unions that are not in use by the parent anymore:
+        PositionSet const *positionSet = &noPositions;
+        if (field.set<positionHistory.size()){
+            auto &history = positionHistory[field.set];
+            while (history.size()>1 and history.front().version<version){
+                history.pop_front();
+            }
+            if (not history.empty() and history.front().version==version){
+                positionSet = &history.front();
+            }
+        }
+
+        auto const &transfer = getTransfer(i, field, *positionSet);
+        if (positionSet->version!=version or values.size()!=transfer.size()){
+            Report::error("Distributed::Link","The boundary values received from rank "
+                          +std::to_string(peer)+" do not match the boundary positions."
+                          " (tag "+std::to_string(tag)+")");
+        }
+        transfer.applyReverse(values.data(), field.data());
+    }
+}
+
+// Writes the unions of the updated boundary position sets of the local children to a message.
+// (mtx must be locked)
+void Link::writePositions(Serializer &s){
+
+    unsigned int nUpdated = std::count(positionsUpdated.begin(), positionsUpdated.end(), true);
+    s.write(nUpdated);
+    for (unsigned int set=0; set<positionsUpdated.size(); set++){
+        if (not positionsUpdated[set]) continue;
+
+        PositionSet positionSet;
+        for (auto &positions : localPositions){
+            if (set<positions.size()){
+                positionSet.positions.insert(positionSet.positions.end(),
+                                             positions[set].begin(), positions[set].end());
+            }
+        }
+        std::sort(positionSet.positions.begin(), positionSet.positions.end());
+        positionSet.positions.erase(std::unique(positionSet.positions.begin(), positionSet.positions.end()),
+                                    positionSet.positions.end());
+
+        auto &history = positionHistory[set];
+        positionSet.version = history.empty() ? 1 : history.back().version+1;
+
+        s.write(set);
+        s.write(positionSet.version);
+        s.write(positionSet.positions);
+        history.push_back(std::move(positionSet));
+        positionsUpdated[set] = false;
+    }
+}
+
+// Reads the boundary position sets of the remote children from a message (mtx must be locked)
+void Link::readPositions(Deserializer &d){
+
+    unsigned int nUpdated = d.get<unsigned int>();
+    for (unsigned int i=0; i<nUpdated; i++){
+        unsigned int set = d.get<unsigned int>();
+        if (set>=positionSets.size()){
+            positionSets.resize(set+1);
+        }
+        d.read(positionSets[set].version);
+        d.read(positionSets[set].positions);
+    }
+}
+
+// Returns the transfer between a boundary field and the packed buffer of its values, i.e., from the
+// parent units at the given positions to consecutive values. The transfer is rebuilt if the positions
+// are updated. (mtx must be locked)
+BoundaryTransfer const& Link::getTransfer(size_t fieldPos, BoundaryField const &field,
+                                          PositionSet const &positionSet){
+
+    if (fieldPos>=transfers.size()){
+        transfers.resize(fieldPos+1);
+    }
+
+    FieldTransfer &fieldTransfer = transfers[fieldPos];
+    if (not fieldTransfer.valid or fieldTransfer.version!=positionSet.version or
+        fieldTransfer.stride!=field.stride){
+
+        std::vector<std::pair<unsigned int,unsigned int>> pairs;
+        pairs.reserve(positionSet.positions.size());
+        for (unsigned int i=0; i<positionSet.positions.size(); i++){
+            pairs.emplace_back(i, positionSet.positions[i]);
+        }
+        fieldTransfer.transfer = BoundaryTransfer(pairs, field.stride, sizeof(double));
+        fieldTransfer.version = positionSet.version;
+        fieldTransfer.stride = field.stride;
+        fieldTransfer.valid = true;
+    }
+    return fieldTransfer.transfer;
+}
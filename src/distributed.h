@@ -0,0 +1,264 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <utility>
+#ifdef OPENHDM_WITH_MPI
+#include <mpi.h>
+#endif
+#include "threading.h"
+#include "transfer.h"
+#include "serialization.h"
+#include "report.h"
+
+namespace OpenHDM {
+
+namespace Distributed {
+
+// --------------------------------------------------------------------
+// Communicator: The message transport of a distributed run, in which
+//   the domains of a project are timestepped on multiple ranks, e.g.,
+//   the child domains of a regional parent on other nodes. (See
+//   Project::setDistribution()) Messages between a pair of ranks with
+//   the same tag are received in the order they are sent. send() does
+//   not block, recv() blocks until a matching message is received, and
+//   reduceMin() is a collective operation of all ranks.
+// --------------------------------------------------------------------
+
+class Communicator
+{
+public:
+    virtual ~Communicator(){}
+
+    virtual int rank()const=0;
+    virtual int size()const=0;
+    virtual void send(int dest, int tag, std::vector<char> const &message)=0;
+    virtual std::vector<char> recv(int source, int tag)=0;
+    virtual uint64_t reduceMin(uint64_t value)=0;
+};
+
+
+// --------------------------------------------------------------------
+// LocalCommunicator: A communicator of ranks that are emulated by the
+//   threads of a single process, each running its own Project
+//   instance. Useful for debugging distributed runs without MPI.
+//
+//     auto comms = LocalCommunicator::create(2);
+//     // in the thread of rank r:
+//     project.setDistribution(comms[r]);
+// --------------------------------------------------------------------
+
+class LocalCommunicator: public Communicator
+{
+public:
+    static std::vector<std::shared_ptr<Communicator>> create(int nRanks);
+
+    int rank()const override {return rank_;}
+    int size()const override;
+    void send(int dest, int tag, std::vector<char> const &message) override;
+    std::vector<char> recv(int source, int tag) override;
+    uint64_t reduceMin(uint64_t value) override;
+
+private:
+    struct Hub;
+    LocalCommunicator(std::shared_ptr<Hub> hub_, int rank__);
+
+    std::shared_ptr<Hub> hub;
+    int rank_;
+};
+
+
+#ifdef OPENHDM_WITH_MPI
+// --------------------------------------------------------------------
+// MPICommunicator: A communicator of MPI processes. MPI must be
+//   initialized by the application with MPI_THREAD_MULTIPLE support,
+//   since the messages of the domains are sent and received by
+//   multiple threads of a rank.
+// --------------------------------------------------------------------
+
+class MPICommunicator: public Communicator
+{
+public:
+    MPICommunicator(MPI_Comm comm_=MPI_COMM_WORLD);
+    MPICommunicator(const MPICommunicator&) = delete;
+    MPICommunicator& operator=(const MPICommunicator&) = delete;
+    ~MPICommunicator();
+
+    int rank()const override {return rank_;}
+    int size()const override {return size_;}
+    void send(int dest, int tag, std::vector<char> const &message) override;
+    std::vector<char> recv(int source, int tag) override;
+    uint64_t reduceMin(uint64_t value) override;
+
+private:
+    void completeSends(bool wait);
+
+    MPI_Comm comm;
+    int rank_ = 0;
+    int size_ = 1;
+
+    // Buffers of the sends in progress:
+    std::mutex mtx;
+    std::list<std::pair<std::vector<char>,MPI_Request>> pending;
+};
+#endif
+
+
+// --------------------------------------------------------------------
+// BoundaryField: A field of the units of a parent domain whose values
+//   at the boundaries of the remote children are shipped at the end
+//   of each phase of the parent. (See Domain::addBoundaryField()) The
+//   field is obtained via a function, since the field may be
+//   relocated, e.g., when new units are inserted to the grid. The
+//   stride is the distance (in bytes) between the values of
+//   consecutive units, and the set is the index of the boundary
+//   position set of the children the field is packed with, e.g., one
+//   set per unit type.
+// --------------------------------------------------------------------
+
+struct BoundaryField{
+    std::function<double*()> data;
+    size_t stride;
+    unsigned int set;
+};
+
+
+// --------------------------------------------------------------------
+// Link: One end of the connection between a parent domain and its
+//   children that are timestepped on another rank. On the rank of
+//   the children, the link is shared by the children, and their
+//   states are combined into the state of the least advanced child.
+//   The link mirrors the control point of the remote side: the state
+//   transitions of each side are sent as messages, which are received
+//   by a progress thread that updates the mirrored control point and
+//   notifies the local domain(s). Hence, the phasing mechanism is the
+//   same as that of local domains. (See Domain::phaseSync()) The
+//   children sharing a link must have the same number of phases and
+//   timestep ratio.
+//
+//   The parent attaches the packed values of the boundary fields to
+//   the messages marking the completion of its phases, and the
+//   progress thread of the children unpacks them into the fields of
+//   the local (shadow) instance of the parent domain, as if the parent
+//   were writing its fields. So, the phase functions of the children
+//   may access the parent as if it were local. The values are packed
+//   at the union of the boundary positions set by the children, which
+//   are attached to the messages of the children, and the parent packs
+//   a phase only after the children have completed the phase
+//   preceding the one that depends on it.
+// --------------------------------------------------------------------
+
+class Link
+{
+public:
+    Link(std::shared_ptr<Communicator> comm_, int peer_, int tag_);
+    Link(const Link&) = delete;
+    Link& operator=(const Link&) = delete;
+    ~Link();
+
+    Threading::ControlPoint& getRemoteCP(){return remoteCP;}
+    const Threading::ControlPoint& getRemoteCP()const{return remoteCP;}
+
+    // Configuration (before timestepping):
+    void addLocal(Threading::ControlPoint &localCP,
+                  std::function<void(uint64_t)> onBoundary=nullptr);      // (children)
+    void setShadowFields(std::vector<BoundaryField> const *fields);    // (children)
+
+    // Called by each local domain at the beginning and end of timestepping:
+    void start(unsigned int nts);
+    void finish();
+
+    // Posting the state transitions of the local domain(s):
+    void postState();
+    void postState(std::vector<BoundaryField> const &fields);          // (parent)
+
+    // Boundary positions of a local child, i.e., the positions of the parent units it accesses:
+    void setBoundaryPositions(Threading::ControlPoint const &localCP, unsigned int set,
+                              std::vector<unsigned int> positions);
+
+private:
+
+    enum Kind: uint8_t {Hello, State, StateWithBoundary, StateWithPositions, Final};
+
+    struct PositionSet{
+        unsigned int version = 0;
+        std::vector<unsigned int> positions;
+    };
+
+    struct FieldTransfer{
+        unsigned int version = 0;
+        size_t stride = 0;
+        bool valid = false;
+        BoundaryTransfer transfer;
+    };
+
+    uint64_t getLocalState()const;
+    void handshake(unsigned int nts);
+    void progress();
+    void unpackBoundary(Deserializer &d);
+    void writePositions(Serializer &s);
+    void readPositions(Deserializer &d);
+    BoundaryTransfer const& getTransfer(size_t fieldPos, BoundaryField const &field,
+                                        PositionSet const &positionSet);
+
+    std::shared_ptr<Communicator> comm;
+    int peer;
+    int tag;
+
+    Threading::ControlPoint remoteCP;                   // mirrored control point of the remote side
+    std::vector<Threading::ControlPoint*> localCPs;     // the parent, or the children sharing the link
+    std::vector<std::function<void(uint64_t)>> onBoundary;  // called after the boundary values of a
+                                                        // parent phase (count) are unpacked
+    std::vector<BoundaryField> const *shadowFields = nullptr;
+    std::thread progressThread;
+    std::mutex mtx;
+
+    // Start and finish of the local domains:
+    std::mutex startMtx;
+    bool started = false;
+    unsigned int nFinished = 0;
+    uint64_t postedState = 0;
+
+    // (parent) Boundary position sets received from the children:
+    std::vector<PositionSet> positionSets;
+
+    // (children) Boundary positions of each child, and the unions that may be in use by the parent:
+    std::vector<std::vector<std::vector<unsigned int>>> localPositions;
+    std::vector<bool> positionsUpdated;
+    std::vector<std::deque<PositionSet>> positionHistory;
+
+    std::vector<FieldTransfer> transfers;               // transfers of the boundary fields
+};
+
+} // end of namespace Distributed
+
+} // end of namespace OpenHDM
+
+#endif // DISTRIBUTED_H
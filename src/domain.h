@@ -24,9 +24,19 @@
 #include <memory>
 #include <vector>
 #include <list>
+#include <map>
+#include <functional>
 #include <string>
 #include <sstream>
+#include <chrono>
+#include <array>
+#include <thread>
 #include "threading.h"
+#include "profiler.h"
+#include "serialization.h"
+#include "checkpoint.h"
+#include "distributed.h"
+#include "device.h"
 #include "report.h"
 #include <boost/progress.hpp>
 
@@ -69,12 +79,19 @@ public:
     bool            isChild()       const;
     bool            isInitialized() const {return initialized;}
     bool            hierarchyIsSet()const {return hierarchySet;}
+    bool            isLocal()       const;
+    int             getRank()       const {return rank;}
+    unsigned        getTimestepRatio() const {return cp.ratio;}
+    unsigned        getLagWindow()  const {return cp.lag;}
     unsigned        get_nChild()    const {return childDomains.size();}
     unsigned        get_nPhases()   const {return phases.size();}
+    unsigned        get_nControlPoints() const {return cp.ncp;}
     std::string     getID()         const {return id;}
     std::string     getOutputDir()  const {return outputDir;}
     const std::shared_ptr<Domain> getParent()       const {return parent;}
     const std::shared_ptr<SolverType>& getSolver()  const {return solver;}
+    const std::shared_ptr<Threading::Executor>& getExecutor() const {return executor;}
+    const std::shared_ptr<Profiling::DomainProfile>& getProfile() const {return profile;}
     const std::shared_ptr<Domain> getChild(unsigned i);
     virtual unsigned get_nts()const=0;
 
@@ -101,13 +118,61 @@ protected:
 
     // Inter-Domain Parallelism:
     void setConcurrency(unsigned nProcTotal=0, unsigned nProcChild=0);
+    void setConcurrency(unsigned nProcParent, std::shared_ptr<Threading::Pool> sharedPool);
     void insertPhase(std::function<void(unsigned)> phase);
+    void insertPhase(std::function<void(unsigned)> phase, Threading::Dependencies const &deps);
     void phaseCheck();
+    void phaseSync();
     void completePhase();
 
+    // Subcycling of child domains:
+    void setTimestepRatio(unsigned ratio);
+    virtual void beginParentStep(unsigned){}    // (subcycled children) see setTimestepRatio()
+
+    // Pipelining of parent and child domains:
+    void setLagWindow(unsigned lag);
+    virtual void endParentStep(unsigned){}      // (lagged children) see setLagWindow()
+
     // Intra-Domain Parallelism:
     unsigned get_nProc_intraDomain() const{return nProc_intraDomain;}
 
+    // Pinning of the domain threads (see Project::setAffinity()):
+    void setAffinity(Affinity::Binding binding);
+    const Affinity::Binding& getAffinity() const{return affinity;}
+
+    // Adaptive rebalancing of processors between parent and children:
+    void setRebalancing(unsigned interval, double threshold=0.1);
+    void rebalance();
+
+    // Periodic reordering of grid units (see Grid<>::reorderUnits()):
+    void setReordering(unsigned interval);
+    virtual void reorderUnits(unsigned){}   // to be overridden by domains with adaptive grids
+
+    // Profiling of phase executions:
+    void setProfiling(Profiling::clock::time_point epoch, bool trace=false);
+
+    // Checkpoint/restart:
+    void setCheckpointing(unsigned interval, std::shared_ptr<CheckpointWriter> writer);
+    void writeCheckpoint(unsigned ts);
+    void readCheckpoint(std::string filePath);
+    unsigned getFirstTimestep() const {return firstTimestep;}
+
+    // Functions to be overridden by domains with state (other than the solver and grid state)
+    // to be included in checkpoints:
+    virtual void writeDomainState(Serializer &)const{}
+    virtual void readDomainState(Deserializer &){}
+
+    // Distributed execution (see Project::setDistribution() and distributed.h):
+    void setPlacement(std::shared_ptr<Distributed::Communicator> comm_, int rank_, int tag_);
+    void addBoundaryField(std::function<double*()> field, size_t stride=sizeof(double), unsigned set=0);
+    void setBoundaryPositions(std::vector<std::pair<unsigned,unsigned>> const &bcpairs, unsigned set=0);
+
+    // Device execution (see device.h):
+    void addMirror(std::shared_ptr<Device::Mirror> mirror);
+    void insertPhase(std::function<void(unsigned)> phase, Device::Access access);
+    void insertDevicePhase(std::function<void(unsigned)> phase, Device::Access access);
+    void synchronizeMirrors();
+
     // input parameters:
     std::string id              = "";
     std::string path            = "";
@@ -125,14 +190,64 @@ private:
     // Inter-Domain Parallelism:
     Threading::ControlPoint             cp;
     std::shared_ptr<Threading::Pool>    threadPool;
-    std::shared_ptr<std::mutex>         mtx;
-    std::shared_ptr<std::condition_variable> condition;
-    std::shared_ptr<std::condition_variable> condition4children;
     std::vector<std::reference_wrapper<Threading::ControlPoint>> childCPs;
     std::vector<std::function<void(unsigned int)>> phases;
+    Threading::PhaseGraph phaseGraph;   // dependencies of the phases within a timestep
+    void checkPhaseGraph()const;        // (after a phase is inserted)
+    bool showProgress = true;   // display the progress of timestepping (parent domains only)
+    bool childIsReady(Threading::ControlPoint const &childCP, uint64_t count) const;
+    bool packsBoundary(Threading::ControlPoint const &childCP, uint64_t count, uint64_t &childState) const;
+    bool parentIsReady(int parentCP, unsigned ts) const;
+
+    // Local phases (executed concurrently with the control points, see Threading::Dependencies):
+    void startLocalPhases();
+    void stopLocalPhases();
+    void executeLocalPhases();
+    std::vector<std::thread> localThreads;
+    std::atomic<unsigned> localStep{0};     // the timestep of the local phases to be executed
+    std::atomic<bool> localStop{false};
+    std::vector<std::array<Profiling::clock::time_point,4>> localTimes;
 
     // Intra-Domain Parallelism:
     unsigned nProc_intraDomain = 1;
+    std::shared_ptr<Threading::Executor> executor;
+    Affinity::Binding affinity;         // core set of the timestepping thread and the workers
+
+    // Adaptive rebalancing:
+    Threading::PhaseTimes phaseTimes;
+    unsigned rebalanceInterval  = 0;    // no. of timesteps between rebalancings (0: disabled)
+    double rebalanceThreshold   = 0.1;  // min. difference of wait fractions to move a processor
+    int rebalanceTrend          = 0;    // (+) consecutive decisions to move a proc to children
+                                        // (-) consecutive decisions to move a proc to parent
+    uint64_t lastParentCompute  = 0, lastParentWait = 0;
+    uint64_t lastChildCompute   = 0, lastChildWait  = 0;
+
+    // Reordering:
+    unsigned reorderInterval    = 0;    // no. of timesteps between reorderings (0: disabled)
+
+    // Profiling:
+    std::shared_ptr<Profiling::DomainProfile> profile;
+
+    // Checkpoint/restart:
+    unsigned firstTimestep      = 1;    // the timestep from which timestepping begins (or resumes)
+    unsigned checkpointInterval = 0;    // no. of timesteps between checkpoints (0: disabled)
+    std::shared_ptr<CheckpointWriter> checkpointWriter;
+
+    // Distributed execution:
+    std::shared_ptr<Distributed::Communicator> comm;
+    int rank                    = 0;    // rank on which the domain is timestepped
+    int tag                     = 0;    // tag of the messages of the domain
+    std::shared_ptr<Distributed::Link> parentLink;              // (child) link to a remote parent
+    std::shared_ptr<Distributed::Link> shadowLink;              // (shadow parent) link shared by the local children
+    std::vector<std::shared_ptr<Distributed::Link>> childLinks; // (parent) links to the ranks of remote children
+
+    // Device execution:
+    std::vector<std::shared_ptr<Device::Mirror>> mirrors;
+    std::vector<Distributed::BoundaryField> boundaryFields;     // (parent) fields shipped to remote children
+
+    std::vector<Domain*> laggedChildren;    // local children with a lag window (see setLagWindow())
+    unsigned get_nLocalChild() const;
+    void linkRemoteChildren();
 
 };
 
@@ -148,7 +263,7 @@ Domain<SolverType>::Domain(std::string  id_,
     parent(nullptr),
     solver(nullptr)
 {
-    Report::log("Domain "+id+" is constructed.",2);
+    OPENHDM_LOG("Domain "+id+" is constructed.",2);
 }
 
 
@@ -169,14 +284,37 @@ void Domain<SolverType>::initialize(){
 template <class SolverType>
 void Domain<SolverType>::timestepping(unsigned nts){
 
-    Report::log("Initiating timestepping for the domain "+getID(),1);
+    OPENHDM_LOG("Initiating timestepping for the domain "+getID(),1);
 
-    if (isParent() and get_nChild()==0){
+    // Pin the timestepping thread (thread 0 of the binding):
+    if (not affinity.empty()){
+        Affinity::pinCurrentThread(affinity.cpusOf(0));
+    }
+
+    // Exchange the initial states with the domains on other ranks (if any):
+    for (auto &link: childLinks){
+        link->start(nts);
+    }
+    if (parentLink){
+        parentLink->start(nts);
+    }
+
+    if (not threadPool){
         sequentialTimestepping(nts);
     }
     else{
         concurrentTimestepping(nts);
     }
+
+    // Transfer the fields modified on the device for post-processing:
+    synchronizeMirrors();
+
+    for (auto &link: childLinks){
+        link->finish();
+    }
+    if (parentLink){
+        parentLink->finish();
+    }
 }
 
 
@@ -185,13 +323,29 @@ template <class SolverType>
 void Domain<SolverType>::sequentialTimestepping(unsigned nts){
 
     // Create a progress display object:
-    boost::progress_display displayProgress(nts);
+    boost::progress_display displayProgress(nts>=firstTimestep ? nts-firstTimestep+1 : 0);
 
-    for (unsigned ts=1; ts<=nts; ts++){
-        for (auto &phase : phases){
+    for (unsigned ts=firstTimestep; ts<=nts; ts++){
+        for (unsigned p=0; p<phases.size(); p++){
 
             // Execute the phase
-            phase(ts);
+            auto t0 = Profiling::clock::now();
+            phases[p](ts);
+
+            if (profile){
+                profile->record(ts, p, t0, t0, t0, Profiling::clock::now());
+            }
+        }
+
+        // Write a checkpoint at the timestep boundary:
+        if (checkpointInterval>0 and ts%(cp.ratio*checkpointInterval)==0){
+            writeCheckpoint(ts);
+        }
+
+        // Reorder the grid units at the timestep boundary:
+        if (reorderInterval>0 and ts%reorderInterval==0 and get_nChild()==0){
+            synchronizeMirrors();
+            reorderUnits(ts);
         }
 
         // Update progress display:
@@ -207,27 +361,178 @@ void Domain<SolverType>::concurrentTimestepping(unsigned nts){
     // Create a progress display pointer:
     std::unique_ptr<boost::progress_display> displayProgress;
 
-    for (unsigned ts=1; ts<=nts; ts++){
-        for (auto &phase : phases){
+    using clock = Profiling::clock;
+
+    bool hasLocalPhases = phaseGraph.hasLocalPhases();
+    if (hasLocalPhases){
+        startLocalPhases();
+    }
 
-            // Check if ready to execute the phase
-            phaseCheck();
+    for (unsigned ts=firstTimestep; ts<=nts; ts++){
+
+        if (hasLocalPhases){
+            localStep.store(ts);
+            cp.signal.notify();
+        }
+
+        for (unsigned p=0; p<phases.size(); p++){
+
+            // (Local phases are executed by the local threads)
+            if (phaseGraph.isLocal(p)) continue;
+
+            // Wait for the local phases the phase depends on:
+            auto t0 = clock::now();
+            if (hasLocalPhases){
+                cp.signal.wait([&]{return phaseGraph.isReady(p, ts);});
+            }
+
+            // Check if ready to execute the phase, and acquire a processor
+            phaseSync();
+            auto t1 = clock::now();
+            threadPool->acquire();
 
             // Execute the phase
-            phase(ts);
+            auto t2 = clock::now();
+            phases[p](ts);
+            auto t3 = clock::now();
 
             // Notify phase completion
             completePhase();
+            if (hasLocalPhases){
+                phaseGraph.complete(p, ts);
+                cp.signal.notify();
+            }
+
+            // Accumulate the phase times:
+            phaseTimes.wait    += std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t0).count();
+            phaseTimes.compute += std::chrono::duration_cast<std::chrono::nanoseconds>(t3-t2).count();
+
+            if (profile){
+                profile->record(ts, p, t0, t1, t2, t3);
+            }
+        }
+
+        // Wait for the local phases of the timestep:
+        if (hasLocalPhases){
+            cp.signal.wait([&]{return phaseGraph.stepComplete(ts);});
+            if (profile){
+                for (unsigned p=0; p<phases.size(); p++){
+                    if (not phaseGraph.isLocal(p)) continue;
+                    auto &t = localTimes[p];
+                    profile->record(ts, p, t[0], t[1], t[2], t[3]);
+                }
+            }
+        }
+
+        // Write a checkpoint at the timestep boundary:
+        if (checkpointInterval>0 and ts%(cp.ratio*checkpointInterval)==0){
+            writeCheckpoint(ts);
+        }
+
+        // Reorder the grid units at the timestep boundary:
+        if (reorderInterval>0 and ts%reorderInterval==0 and get_nChild()==0){
+            synchronizeMirrors();
+            reorderUnits(ts);
+        }
+
+        // Rebalance the processors between the parent and the children:
+        if (isParent() and rebalanceInterval>0 and ts%rebalanceInterval==0){
+            rebalance();
         }
 
         // Update progress display:
-        if (isParent()){
+        if (isParent() and showProgress){
             if (not displayProgress){
-                displayProgress=std::make_unique<boost::progress_display>(nts);
+                displayProgress=std::make_unique<boost::progress_display>(nts-firstTimestep+1);
             }
             ++(*displayProgress);
         }
     }
+
+    if (hasLocalPhases){
+        stopLocalPhases();
+    }
+}
+
+
+// Starts the threads executing the local phases, one for each local phase
+template <class SolverType>
+void Domain<SolverType>::startLocalPhases(){
+
+    for (unsigned p=0; p<phases.size(); p++){
+        int parentCP = phaseGraph.getParentCP(p);
+        if (parentCP<0) continue;
+        if (not isChild() or cp.isStepwise()){
+            Report::error("Phasing!","Phase "+std::to_string(p)+" of domain "+id+" follows a "
+                          "control point of the parent, but the domain is not a child with a "
+                          "timestep ratio of 1 and no lag window.");
+        }
+        Threading::ControlPoint &parentCPref = parentLink ? parentLink->getRemoteCP() : parent->cp;
+        if (unsigned(parentCP)>=parentCPref.ncp){
+            Report::error("Phasing!","Phase "+std::to_string(p)+" of domain "+id+" follows the "
+                          "control point "+std::to_string(parentCP)+", but the parent has "
+                          +std::to_string(parentCPref.ncp)+" control points.");
+        }
+    }
+
+    phaseGraph.prepare();
+    localTimes.resize(phases.size());
+    localStop = false;
+    localStep = 0;
+    for (unsigned p=0; p<phases.size(); p++){
+        if (phaseGraph.isLocal(p)){
+            localThreads.emplace_back([this]{executeLocalPhases();});
+        }
+    }
+}
+
+template <class SolverType>
+void Domain<SolverType>::stopLocalPhases(){
+
+    localStop = true;
+    cp.signal.notify();
+    for (auto &thread : localThreads){
+        thread.join();
+    }
+    localThreads.clear();
+}
+
+// The loop of the local threads. Each thread claims the next ready local phase of the current
+// timestep, and executes it on a processor acquired from the pool.
+template <class SolverType>
+void Domain<SolverType>::executeLocalPhases(){
+
+    using clock = Profiling::clock;
+
+    if (not affinity.empty()){
+        Affinity::pinCurrentThread(affinity.cpus);
+    }
+
+    auto parentReady = [this](int parentCP){return parentIsReady(parentCP, localStep.load());};
+
+    while (true){
+        unsigned p = 0;
+        unsigned ts = 0;
+        cp.signal.wait([&]{
+            ts = localStep.load();
+            return localStop.load() or phaseGraph.claim(ts, p, parentReady);
+        });
+        if (localStop.load()) return;
+
+        auto t0 = clock::now();
+        threadPool->acquire();
+        auto t1 = clock::now();
+        phases[p](ts);
+        auto t2 = clock::now();
+        threadPool->release();
+
+        phaseTimes.wait    += std::chrono::duration_cast<std::chrono::nanoseconds>(t1-t0).count();
+        phaseTimes.compute += std::chrono::duration_cast<std::chrono::nanoseconds>(t2-t1).count();
+        localTimes[p] = {{t0, t0, t1, t2}};
+
+        phaseGraph.complete(p, ts);
+        cp.signal.notify();
+    }
 }
 
 
@@ -237,7 +542,7 @@ void Domain<SolverType>::setHierarchy(std::shared_ptr<Domain> parent){
 
     if (not (parent==nullptr)){
         parent->addChild(this->shared_from_this());
-        Report::log("Child: "+getID()+"  Parent: "+parent->getID(),3);
+        OPENHDM_LOG("Child: "+getID()+"  Parent: "+parent->getID(),3);
     }
 
     hierarchySet = true;
@@ -284,8 +589,8 @@ bool Domain<SolverType>::setParent(std::shared_ptr<Domain<SolverType>> pd){
 }
 
 
-// Configures domain concurrency constructs, e.g., mutexes and condition variables
-// of provides child domains with pointers to these constructs.
+// Configures domain concurrency constructs, e.g., the thread pool and control points,
+// or provides child domains with pointers to these constructs.
 template <class SolverType>
 void Domain<SolverType>::setConcurrency(unsigned nProcTotal, unsigned nProcChild){
 
@@ -294,11 +599,30 @@ void Domain<SolverType>::setConcurrency(unsigned nProcTotal, unsigned nProcChild
                       "Domain hierarchy is not set yet.");
     }
 
+    unsigned nProc_intraMax = 0;
+
+    if (not isLocal()){
+        // A shadow parent of local children (see Project::setDistribution()). Dedicate all
+        // available processors to the children (and to the setup of the shadow):
+        unsigned nProc = std::max(unsigned(1), nProcTotal);
+        threadPool  = std::make_shared<Threading::Pool>(nProc);
+        executor    = std::make_shared<Threading::Executor>(nProc);
+
+        OPENHDM_LOG("Number of processors allocated for the children of the shadow parent "+id+": "
+                    +std::to_string(nProc), 2);
+        return;
+    }
+
     if (isParent()){
 
-        if (get_nChild()==0){
-            // No children. Dedicate all available processors to parent:
+        if (get_nLocalChild()==0){
+            // No local children. Dedicate all available processors to parent:
             nProc_intraDomain = std::max(unsigned(1), nProcTotal);
+
+            // If the children are on other ranks, the parent is the only domain of the pool:
+            if (get_nChild()>0){
+                threadPool = std::make_shared<Threading::Pool>(1);
+            }
         }
         else{
             // Dedicate ~50% of procs to inter-domain concurrency:
@@ -312,97 +636,680 @@ void Domain<SolverType>::setConcurrency(unsigned nProcTotal, unsigned nProcChild
             // Dedicate remaining procs to parent domain:
             nProc_intraDomain = std::max(unsigned(1), nProcTotal-nProc_interDomain+1);
 
+            // If adaptive rebalancing is enabled, the parent may later use all of the procs but
+            // two of the pool (one for the parent and one for the children):
+            if (rebalanceInterval>0){
+                nProc_intraMax = std::max(nProc_intraDomain, nProc_intraDomain+nProc_interDomain-2);
+            }
+
             // Initialize inter-domain parallelism constructs:
             threadPool          = std::make_shared<Threading::Pool>(nProc_interDomain);
-            mtx                 = std::make_shared<std::mutex>();
-            condition           = std::make_shared<std::condition_variable>();
-            condition4children  = std::make_shared<std::condition_variable>();
 
-            Report::log("Number of processors allocated for domain concurrency: "
+            OPENHDM_LOG("Number of processors allocated for domain concurrency: "
                         +std::to_string(nProc_interDomain), 2);
         }
-        Report::log("Number of processors allocated for the parent: "
+        OPENHDM_LOG("Number of processors allocated for the parent: "
                     +std::to_string(nProc_intraDomain), 2);
+
+        linkRemoteChildren();
     }
     else{
         // For the child domain, get pointers to parent domain concurrency constructs:
         threadPool = parent->threadPool;
-        mtx        = parent->mtx;
-        condition  = parent->condition4children;
-        parent->childCPs.push_back(std::ref(cp));
+        if (parent->isLocal()){
+            parent->childCPs.push_back(std::ref(cp));
+            if (cp.lag>0){
+                parent->laggedChildren.push_back(this);
+            }
+        }
+        else{
+            // The parent is a shadow, i.e., timestepped on another rank. The children on this rank
+            // share a single link to the parent:
+            if (not parent->shadowLink){
+                parent->shadowLink = std::make_shared<Distributed::Link>(comm, parent->rank, parent->tag);
+                parent->shadowLink->setShadowFields(&parent->boundaryFields);
+            }
+            parentLink = parent->shadowLink;
+            if (cp.lag>0){
+                // The boundary values are pushed upon receipt, since the shadow parent runs ahead:
+                parentLink->addLocal(cp, [this](uint64_t parentCount){
+                    unsigned parentNcp = parentLink->getRemoteCP().ncp;
+                    if (parentCount%parentNcp==0){
+                        endParentStep(unsigned(parentCount/parentNcp));
+                    }
+                });
+            }
+            else{
+                parentLink->addLocal(cp);
+            }
+        }
     }
 
+    // Initialize the executor for intra-domain parallelism:
+    executor = std::make_shared<Threading::Executor>(std::max(nProc_intraDomain, nProc_intraMax));
+    executor->setActiveThreads(nProc_intraDomain);
+
 }
 
 
-// Inserts a phase to the vector of phases. Each phase is sequentially executed at every timestep
+// Assigns the core set of the domain, and pins the workers of the executor to it. The timestepping
+// thread is pinned at the beginning of timestepping. Must be called after setConcurrency().
+template <class SolverType>
+void Domain<SolverType>::setAffinity(Affinity::Binding binding){
+
+    affinity = std::move(binding);
+    if (executor and not affinity.empty() and not executor->setAffinity(affinity)){
+        Report::warning("Affinity","The threads of domain "+id+" cannot be pinned to the CPUs "
+                        +Affinity::toString(affinity.cpus));
+    }
+}
+
+
+// Enables adaptive rebalancing of processors between a parent domain and its children. Every
+// "interval" timesteps, the fractions of time the parent and the children spend waiting are
+// compared. If one side waits more than the other by "threshold" in two consecutive intervals,
+// a processor is moved from the waiting side to the other. Must be called before setConcurrency.
+template <class SolverType>
+void Domain<SolverType>::setRebalancing(unsigned interval, double threshold){
+    rebalanceInterval = interval;
+    rebalanceThreshold = threshold;
+}
+
+
+// Enables calling reorderUnits() at every interval timesteps, after the last phase of the timestep.
+// Since the child domains map their units to the positions of the parent units while they are
+// timestepping, periodic reordering is only carried out by domains without children. (Parent
+// grids may still be reordered during initialization, before the children copy their units.)
+template <class SolverType>
+void Domain<SolverType>::setReordering(unsigned interval){
+    if (interval>0 and get_nChild()>0){
+        Report::warning("Domain::setReordering","Periodic reordering is disabled for domain "+id+
+                        " since it has child domains.");
+    }
+    reorderInterval = interval;
+}
+
+
+// Moves a processor between the thread pool (children) and the executor (parent) if the
+// timings of the last interval indicate an imbalance. (See setRebalancing())
+template <class SolverType>
+void Domain<SolverType>::rebalance(){
+
+    if (not threadPool) return;
+
+    // Timings of the parent within the last interval:
+    uint64_t parentCompute = phaseTimes.compute.load();
+    uint64_t parentWait = phaseTimes.wait.load();
+    double dParentCompute = double(parentCompute-lastParentCompute);
+    double dParentWait = double(parentWait-lastParentWait);
+    lastParentCompute = parentCompute;
+    lastParentWait = parentWait;
+
+    // Timings of the children within the last interval:
+    uint64_t childCompute = 0, childWait = 0;
+    for (auto &childWP: childDomains){
+        auto child = childWP.lock();
+        if (not child) continue;
+        childCompute += child->phaseTimes.compute.load();
+        childWait += child->phaseTimes.wait.load();
+    }
+    double dChildCompute = double(childCompute-lastChildCompute);
+    double dChildWait = double(childWait-lastChildWait);
+    lastChildCompute = childCompute;
+    lastChildWait = childWait;
+
+    if (dParentCompute+dParentWait<=0. or dChildCompute+dChildWait<=0.) return;
+
+    // Compare wait fractions:
+    double parentWaitFrac = dParentWait/(dParentCompute+dParentWait);
+    double childWaitFrac = dChildWait/(dChildCompute+dChildWait);
+
+    if (parentWaitFrac-childWaitFrac > rebalanceThreshold){
+        rebalanceTrend = std::max(1, rebalanceTrend+1);
+    }
+    else if (childWaitFrac-parentWaitFrac > rebalanceThreshold){
+        rebalanceTrend = std::min(-1, rebalanceTrend-1);
+    }
+    else{
+        rebalanceTrend = 0;
+    }
+
+    unsigned nProc_pool = threadPool->get_nProcs();
+
+    if (rebalanceTrend>=2 and nProc_intraDomain>1 and nProc_pool<get_nChild()+1){
+        // The parent waits for the children. Move a processor to the children:
+        nProc_intraDomain--;
+        executor->setActiveThreads(nProc_intraDomain);
+        threadPool->resize(nProc_pool+1);
+        rebalanceTrend = 0;
+    }
+    else if (rebalanceTrend<=-2 and nProc_pool>2 and nProc_intraDomain<executor->get_nThreads()){
+        // The children wait for the parent. Move a processor to the parent:
+        threadPool->resize(nProc_pool-1);
+        nProc_intraDomain++;
+        executor->setActiveThreads(nProc_intraDomain);
+        rebalanceTrend = 0;
+    }
+    else{
+        return;
+    }
+
+    OPENHDM_LOG("Rebalanced processors. Parent: "+std::to_string(nProc_intraDomain)+
+                "  Domain concurrency: "+std::to_string(threadPool->get_nProcs()), 3);
+}
+
+
+// Configures the concurrency constructs of a parent domain whose hierarchy shares the thread
+// pool with other domain hierarchies of the project. nProcParent processors are dedicated to
+// the parent domain itself.
+template <class SolverType>
+void Domain<SolverType>::setConcurrency(unsigned nProcParent, std::shared_ptr<Threading::Pool> sharedPool){
+
+    if (not hierarchyIsSet()){
+        Report::error("Domain Concurrency Configuration",
+                      "Domain hierarchy is not set yet.");
+    }
+    if (not isParent()){
+        Report::error("Domain Concurrency Configuration",
+                      "A shared thread pool can only be assigned to parent domains.");
+    }
+
+    nProc_intraDomain = std::max(unsigned(1), nProcParent);
+    threadPool = sharedPool;
+
+    if (not isLocal()){
+        // A shadow parent of local children (see Project::setDistribution()):
+        executor = std::make_shared<Threading::Executor>(nProc_intraDomain);
+        return;
+    }
+
+    // Rebalancing is not applicable, since the pool is shared by multiple hierarchies:
+    if (rebalanceInterval>0){
+        Report::warning("Concurrency!","Adaptive rebalancing is disabled for domain "+id+
+                        " since the thread pool is shared by multiple parent domains.");
+        rebalanceInterval = 0;
+    }
+
+    OPENHDM_LOG("Number of processors allocated for the parent "+id+": "
+                +std::to_string(nProc_intraDomain), 2);
+
+    // Initialize the executor for intra-domain parallelism:
+    executor = std::make_shared<Threading::Executor>(nProc_intraDomain);
+
+    linkRemoteChildren();
+}
+
+
+// Returns the number of children that are timestepped on the same rank as the domain.
+template <class SolverType>
+unsigned Domain<SolverType>::get_nLocalChild()const{
+
+    unsigned nLocalChild = 0;
+    for (auto &childWP: childDomains){
+        auto child = childWP.lock();
+        nLocalChild += (child and child->isLocal());
+    }
+    return nLocalChild;
+}
+
+
+// Creates the links to the ranks of the children that are timestepped on other ranks. The children
+// on a rank share a single link, whose mirrored control point holds the state of the least advanced
+// child, and is synchronized with the parent as the control point of a local child.
+template <class SolverType>
+void Domain<SolverType>::linkRemoteChildren(){
+
+    std::map<int, std::shared_ptr<Distributed::Link>> rankLinks;
+    for (auto &childWP: childDomains){
+        auto child = childWP.lock();
+        if (not child or child->isLocal()) continue;
+
+        auto &link = rankLinks[child->rank];
+        if (not link){
+            link = std::make_shared<Distributed::Link>(comm, child->rank, tag);
+            link->addLocal(cp);
+            childLinks.push_back(link);
+            childCPs.push_back(std::ref(link->getRemoteCP()));
+        }
+
+        OPENHDM_LOG("Domain "+id+" is linked to the child "+child->getID()+" on rank "
+                    +std::to_string(child->rank), 3);
+    }
+}
+
+
+// Assigns the rank on which the domain is timestepped, and the tag of its messages, which must
+// be unique among the domains of the project. Called by Project::setDistribution() before the
+// concurrency is configured.
+template <class SolverType>
+void Domain<SolverType>::setPlacement(std::shared_ptr<Distributed::Communicator> comm_, int rank_, int tag_){
+    comm = comm_;
+    rank = rank_;
+    tag = tag_;
+}
+
+
+// Registers a field of the units of the domain whose values at the boundaries of the children on
+// other ranks are sent at the end of each phase. (See Distributed::BoundaryField) The fields must
+// be registered in the same order on all ranks, e.g., in instantiateMembers() or doInitialize().
+template <class SolverType>
+void Domain<SolverType>::addBoundaryField(std::function<double*()> field, size_t stride, unsigned set){
+    boundaryFields.push_back(Distributed::BoundaryField{field, stride, set});
+}
+
+
+// Sets the positions of the parent units whose values are received from a parent on another rank,
+// i.e., the parent positions of the given (child,parent) boundary pairs (see Grid::getBoundaryPairs()),
+// for the boundary fields of a given set. Should be called whenever the boundary pairs are updated,
+// e.g., by the phase in which the patches are adjusted. Has no effect if the parent is local.
+template <class SolverType>
+void Domain<SolverType>::setBoundaryPositions(std::vector<std::pair<unsigned,unsigned>> const &bcpairs, unsigned set){
+
+    if (not parentLink) return;
+
+    std::vector<unsigned> positions;
+    positions.reserve(bcpairs.size());
+    for (auto &bcpair : bcpairs){
+        positions.push_back(bcpair.second);
+    }
+    parentLink->setBoundaryPositions(cp, set, std::move(positions));
+}
+
+
+// Enables recording of phase compute, synchronization and pool wait times. The epoch is the
+// common origin of the trace event times of all of the domains. Must be called after all of
+// the phases are inserted.
+template <class SolverType>
+void Domain<SolverType>::setProfiling(Profiling::clock::time_point epoch, bool trace){
+    profile = std::make_shared<Profiling::DomainProfile>(id, get_nPhases(), epoch, trace);
+}
+
+
+// Enables writing checkpoints at every interval timesteps. The checkpoints are written
+// asynchronously by the given writer, which may be shared by multiple domains.
+template <class SolverType>
+void Domain<SolverType>::setCheckpointing(unsigned interval, std::shared_ptr<CheckpointWriter> writer){
+    checkpointInterval = interval;
+    checkpointWriter = writer;
+}
+
+
+// Writes a checkpoint of the domain at the end of timestep ts. The state of the solver (including
+// the grid) and the domain is serialized into memory, and the buffer is handed over to the
+// checkpoint writer, so the timestepping thread only pays for the copy. A checksum is appended, so
+// that truncated or corrupt checkpoints are detected. (See readCheckpoint())
+template <class SolverType>
+void Domain<SolverType>::writeCheckpoint(unsigned ts){
+
+    if (not checkpointWriter){
+        Report::error("Checkpoint!","No checkpoint writer is assigned to domain "+id);
+    }
+
+    synchronizeMirrors();
+
+    Serializer s;
+    s.write(std::string("OHDMDOM1"));
+    s.write(id);
+    s.write(ts);
+    s.write(get_nPhases());
+    s.write(bool(solver));
+    if (solver){
+        solver->writeCheckpoint(s);
+    }
+    writeDomainState(s);
+    s.writeChecksum();
+
+    // (The checkpoints of subcycled children are labeled with the timesteps of the parent.)
+    checkpointWriter->submit(CheckpointWriter::fileName(id, ts/cp.ratio), std::move(s.getBuffer()));
+}
+
+
+// Restores the state of the domain from a checkpoint written at the end of a timestep ts.
+// Timestepping resumes from ts+1, and the control point is set to the position after the last
+// phase of ts. Must be called after the domain is initialized.
+template <class SolverType>
+void Domain<SolverType>::readCheckpoint(std::string filePath){
+
+    Deserializer d(filePath);
+    if (not d.verifyChecksum()){
+        Report::error("Checkpoint!",filePath+" is truncated or corrupt");
+    }
+
+    std::string magic, checkpointID;
+    d.read(magic);
+    d.read(checkpointID);
+    if (magic!="OHDMDOM1" or checkpointID!=id){
+        Report::error("Checkpoint!",filePath+" is not a checkpoint of domain "+id);
+    }
+
+    unsigned ts = d.get<unsigned>();
+    if (d.get<unsigned>()!=get_nPhases()){
+        Report::error("Checkpoint!","The number of phases of domain "+id+" is inconsistent with "
+                      "the checkpoint "+filePath);
+    }
+    if (d.get<bool>() != bool(solver)){
+        Report::error("Checkpoint!","The solver of domain "+id+" is inconsistent with "
+                      "the checkpoint "+filePath);
+    }
+    if (solver){
+        solver->readCheckpoint(d);
+    }
+    readDomainState(d);
+
+    firstTimestep = ts+1;
+    cp.state.store(2*uint64_t(ts)*cp.ncp+1);
+
+    // The device copies are out of date:
+    for (auto &mirror: mirrors){
+        mirror->markHostModified();
+    }
+
+    OPENHDM_LOG("Domain "+id+" is restarted from timestep "+std::to_string(ts),2);
+}
+
+
+// Inserts a phase to the vector of phases. Each phase is sequentially executed at every timestep.
+// If the domain has device mirrors, the phase may access any of the mirrored fields, so all of the
+// fields modified on the device are transferred beforehand, and treated as modified on the host
+// afterwards. (See the overload below for phases that declare the fields accessed.)
 template <class SolverType>
 void Domain<SolverType>::insertPhase(std::function<void(unsigned)> phase){
 
     // add the function to the "phases" vector
-    phases.emplace_back(phase);
+    phases.emplace_back([this, phase](unsigned ts){
+        if (mirrors.empty()){
+            phase(ts);
+            return;
+        }
+        synchronizeMirrors();
+        phase(ts);
+        for (auto &mirror: mirrors){
+            mirror->markHostModified();
+        }
+    });
 
     // increment the number of control points
     (cp.ncp)++;
+    phaseGraph.insert();
 
     // check consistency
-    if (cp.ncp != phases.size()){
+    checkPhaseGraph();
+}
+
+
+// Checks that each phase has a node in the phase graph
+template <class SolverType>
+void Domain<SolverType>::checkPhaseGraph()const{
+    if (phaseGraph.size() != phases.size()){
         Report::error("Phasing!",
-                      "The number of phases and the number of control points are inconsistent");
+                      "The number of phases and the number of graph nodes are inconsistent");
+    }
+}
+
+
+// Inserts a phase with declared dependencies (see Threading::Dependencies). The phase is executed
+// once the phases it depends on are completed, and unless declared local, is a control point.
+// (Phases accessing the device mirrors are inserted along with their Device::Access instead.)
+template <class SolverType>
+void Domain<SolverType>::insertPhase(std::function<void(unsigned)> phase,
+                                     Threading::Dependencies const &deps){
+
+    phaseGraph.insert(deps);
+    if (not phaseGraph.isLocal(phaseGraph.size()-1)){
+        (cp.ncp)++;
+    }
+    phases.emplace_back(phase);
+
+    checkPhaseGraph();
+}
+
+
+// Inserts a host phase accessing the given fields of the device mirrors, i.e., only the accessed
+// fields modified on the device are transferred to the host beforehand.
+template <class SolverType>
+void Domain<SolverType>::insertPhase(std::function<void(unsigned)> phase, Device::Access access){
+
+    phases.emplace_back([phase, access](unsigned ts) mutable {
+        access.beginHostPhase();
+        phase(ts);
+        access.endHostPhase();
+    });
+    (cp.ncp)++;
+    phaseGraph.insert();
+
+    checkPhaseGraph();
+}
+
+
+// Inserts a device phase, i.e., a phase launching kernels on the device mirrors of the grid data.
+// The accessed fields modified on the host are transferred to the device beforehand, and the
+// fields written are treated as modified on the device afterwards. Phases of a domain are executed
+// in order, so a device phase is synchronized with the preceding and following phases through the
+// transfers (see Device::Access). Hence, the children of a parent with device phases may only
+// read the fields exported by the parent (see Device::Access::exports()).
+template <class SolverType>
+void Domain<SolverType>::insertDevicePhase(std::function<void(unsigned)> phase, Device::Access access){
+
+    phases.emplace_back([phase, access](unsigned ts) mutable {
+        access.beginDevicePhase();
+        phase(ts);
+        access.endDevicePhase();
+    });
+    (cp.ncp)++;
+    phaseGraph.insert();
+
+    checkPhaseGraph();
+}
+
+
+// Adds a device mirror of the grid data (see device.h). Must be called before timestepping
+template <class SolverType>
+void Domain<SolverType>::addMirror(std::shared_ptr<Device::Mirror> mirror){
+    mirrors.push_back(mirror);
+}
+
+
+// Transfers all of the fields modified on the device to the host, e.g., before checkpoints
+template <class SolverType>
+void Domain<SolverType>::synchronizeMirrors(){
+    for (auto &mirror: mirrors){
+        mirror->toHost();
     }
 }
 
 
-// Checks if the domain is ready to execute the next phase
+// Checks if the domain is ready to execute the next phase and acquires a processor
+// from the thread pool.
 template <class SolverType>
 void Domain<SolverType>::phaseCheck(){
 
+    phaseSync();
+    threadPool->acquire();
+}
+
+
+// Waits until the domain is ready to execute the next phase. A parent domain may enter its next
+// phase once all of its children have entered the current phase of the parent, and a child
+// domain may enter its next phase once the parent has completed that phase. Each domain waits
+// on the signal of its own control point, which is notified by the domain(s) it depends on.
+template <class SolverType>
+void Domain<SolverType>::phaseSync(){
+
     if (isParent()){
-        std::unique_lock<std::mutex> parentLock(*mtx);
-        condition->wait(parentLock, [&]{
+        cp.signal.wait([&]{
+            uint64_t count = cp.getCount();
             for (auto &childCPref: childCPs){
-                auto &childCP = childCPref.get();
-                if ( (cp.ncp + cp.getVal() - childCP.getVal())%cp.ncp > 0 ) return false;
+                if (not childIsReady(childCPref.get(), count)) return false;
             }
             return true;
         });
 
         cp.increment();
-        condition4children->notify_all();
-        threadPool->acquire();
+        for (auto &childCPref: childCPs){
+            childCPref.get().signal.notify();
+        }
+        for (auto &link: childLinks){
+            link->postState();
+        }
     }
     else{ // child
-        std::unique_lock<std::mutex> childLock(*mtx);
-        condition->wait(childLock, [&]{
-            if ( ( (cp.ncp + parent->cp.getVal() - cp.getVal())%cp.ncp > 1 ) or
-                 ( (cp.ncp + parent->cp.getVal() - cp.getVal())%cp.ncp == 1 and parent->cp.isDone() ) ){
-                return true;
+        Threading::ControlPoint &parentCP = parentLink ? parentLink->getRemoteCP() : parent->cp;
+
+        // A child depends on the parent phase of the same count. A stepwise (subcycled or lagged)
+        // child depends on the last phase of a parent timestep, at the beginning of each block of
+        // its (sub)steps:
+        uint64_t count = cp.getCount();
+        uint64_t blockSize = uint64_t(cp.ratio)*cp.ncp;
+        bool blockBegins = (not cp.isStepwise() or count%blockSize==0);
+        uint64_t parentCount = cp.isStepwise() ? (count/blockSize+1)*parentCP.ncp : count+1;
+
+        if (blockBegins){
+            cp.signal.wait([&]{
+                uint64_t parentState = parentCP.getState();
+                uint64_t pc = Threading::ControlPoint::countOf(parentState);
+                return ( pc > parentCount or
+                        (pc == parentCount and Threading::ControlPoint::isDone(parentState)) );
+            });
+
+            if (cp.isStepwise()){
+                beginParentStep(unsigned(parentCount/parentCP.ncp));
             }
-            return false;
-        });
+        }
+
         cp.increment();
-        parent->condition->notify_one();
-        threadPool->acquire();
+        if (parentLink){
+            parentLink->postState();
+        }
+        else{
+            parent->cp.signal.notify();
+        }
     }
 
 }
 
 
-// Signal phase completion
+// Signal phase completion. A parent domain sends the boundary values of the phase to its remote
+// children once they have completed the phase preceding the one that depends on this phase, i.e.,
+// once their boundary positions for the phase are received. (See Distributed::Link)
 template <class SolverType>
 void Domain<SolverType>::completePhase(){
 
+    // Push the boundary values of a completed parent timestep to the lagged children:
+    if (not laggedChildren.empty() and cp.getCount()%cp.ncp==0){
+        unsigned parentStep = unsigned(cp.getCount()/cp.ncp);
+        for (auto child : laggedChildren){
+            child->endParentStep(parentStep);
+        }
+    }
+
     threadPool->release();
-    std::unique_lock<std::mutex> lock(*mtx);
     cp.markDone();
 
     if (isParent()){
-        condition4children->notify_all();
+        for (auto &childCPref: childCPs){
+            childCPref.get().signal.notify();
+        }
+
+        for (auto &link: childLinks){
+            uint64_t count = cp.getCount();
+            uint64_t childState = 0;
+            if (packsBoundary(link->getRemoteCP(), count, childState)){
+                cp.signal.wait([&]{return link->getRemoteCP().getState() >= childState;});
+                link->postState(boundaryFields);
+            }
+            else{
+                link->postState();
+            }
+        }
     }
-    else{ // child
-        parent->condition->notify_one();
+    else if (parentLink){
+        parentLink->postState();
+    }
+
+}
+
+
+// Returns true if a child with a given control point lets the parent enter the phase following a
+// given count. The parent may enter a phase once the child has entered the current phase of the
+// parent, and a parent timestep n+1 once a stepwise child with a lag window of K has entered the
+// block of (sub)steps of the parent timestep n-K.
+template <class SolverType>
+bool Domain<SolverType>::childIsReady(Threading::ControlPoint const &childCP, uint64_t count)const{
+
+    if (not childCP.isStepwise()){
+        return childCP.getCount() == count;
+    }
+
+    if (count%cp.ncp!=0) return true;               // not the beginning of a parent timestep
+    uint64_t nSteps = count/cp.ncp;
+    if (nSteps<=childCP.lag) return true;
+    return childCP.getCount() >= (nSteps-childCP.lag-1)*childCP.ratio*childCP.ncp+1;
+}
+
+
+// Determines whether the boundary values of the parent phase of a given count are used by a remote
+// child, and if so, the state the child must have reached before the values are packed, i.e., the
+// completion of the phase before the one that depends on the parent phase.
+template <class SolverType>
+bool Domain<SolverType>::packsBoundary(Threading::ControlPoint const &childCP, uint64_t count,
+                                       uint64_t &childState)const{
+
+    if (not childCP.isStepwise()){
+        childState = 2*(count-1)+1;
+        return true;
+    }
+
+    if (count%cp.ncp!=0) return false;              // not the end of a parent timestep
+    if (childCP.lag>0){
+        childState = 0;                             // pushed by the link upon receipt
+        return true;
     }
+    uint64_t nSteps = count/cp.ncp;
+    childState = 2*(nSteps-1)*childCP.ratio*childCP.ncp+1;
+    return true;
+}
+
+
+// Returns true if the parent has completed its control point of a given index in timestep ts
+template <class SolverType>
+bool Domain<SolverType>::parentIsReady(int parentCP, unsigned ts)const{
 
+    Threading::ControlPoint const &parentCPref = parentLink ? parentLink->getRemoteCP() : parent->cp;
+    uint64_t count = uint64_t(ts-1)*parentCPref.ncp + unsigned(parentCP) + 1;
+    uint64_t parentState = parentCPref.getState();
+    uint64_t pc = Threading::ControlPoint::countOf(parentState);
+    return pc > count or (pc == count and Threading::ControlPoint::isDone(parentState));
+}
+
+
+// Sets the number of timesteps (substeps) a child domain executes per timestep of its parent. A
+// subcycled child must have ratio times the number of timesteps of the parent, and may have a
+// different number of phases. At the beginning of each block of substeps, the child waits until
+// the parent completes the corresponding timestep, and beginParentStep() is called, e.g., to store
+// the boundary values of the parent for interpolation across the substeps. (See transfer.h:
+// BoundaryInterpolation) The parent may advance to its next timestep once beginParentStep()
+// returns, and otherwise does not wait for the child. Must be called before run().
+template <class SolverType>
+void Domain<SolverType>::setTimestepRatio(unsigned ratio){
+
+    if (ratio==0){
+        Report::error("Subcycling!","The timestep ratio of domain "+id+" must be positive.");
+    }
+    cp.ratio = ratio;
+}
+
+
+// Sets the number of timesteps K by which the parent may run ahead of a child domain, e.g., to
+// absorb the load imbalance between the two. The parent enters its timestep n+1 once the child has
+// entered the block of (sub)steps of the parent timestep n-K, and the child synchronizes with the
+// parent at the beginning of each block only, as a subcycled child. (See setTimestepRatio()) Since
+// the parent fields may be ahead of the child, the parent calls endParentStep() of the child upon
+// completion of each of its timesteps, e.g., to push the boundary values into a ring buffer of K+1
+// states, from which the child consumes them in beginParentStep(). (See transfer.h:
+// BoundaryInterpolation) A lag window of 0 (default) disables pipelining. Must be called before run().
+template <class SolverType>
+void Domain<SolverType>::setLagWindow(unsigned lag){
+    cp.lag = lag;
 }
 
 // attribute accessors:
@@ -419,6 +1326,12 @@ bool Domain<SolverType>::isParent()const{
 
 }
 
+// Returns true unless the domain is timestepped on another rank. (See Project::setDistribution())
+template <class SolverType>
+bool Domain<SolverType>::isLocal()const{
+    return not comm or rank==comm->rank();
+}
+
 template <class SolverType>
 bool Domain<SolverType>::isChild()const{
 
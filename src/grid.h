@@ -28,13 +28,73 @@
 #include <tuple>
 #include <vector>
 #include <deque>
+#include <iterator>
+#include <algorithm>
+#include <utility>
 #include <list>
-#include <map>
 #include <unordered_map>
+#include <string>
+#include <fstream>
 #include "report.h"
+#include "unitcolumns.h"
+#include "serialization.h"
+#include "allocation.h"
+#include "connectivity.h"
+#include "reordering.h"
+#include "transfer.h"
 
 namespace OpenHDM {
 
+// --------------------------------------------------------------------
+// UnitIndex: The bookkeeping of the units of a given type within a
+//   grid, i.e., the lists of unit positions and the mappings of unit
+//   ids and positions. Grids store one UnitIndex per unit type in a
+//   tuple, which is resolved at compile time (similar to unitsTuple).
+//   The node-based containers (i.e., the position lists and the id
+//   map) are allocated by the allocation policy of the grid.
+// --------------------------------------------------------------------
+
+template <class unitType, class allocPolicy = StandardAllocation>
+struct UnitIndex{
+    template <class T>
+    using allocator = typename allocPolicy::template allocator<T>;
+
+    std::list<unsigned int, allocator<unsigned int>> upos;  // unit positions
+    std::list<unsigned int, allocator<unsigned int>> vpos;  // vacant unit positions
+
+    // mapping from id's of units to their position in vector "units":
+    std::unordered_map<int, unsigned int, std::hash<int>, std::equal_to<int>,
+                       allocator<std::pair<const int,unsigned int>>> id2pos;
+
+    // mapping from positions of child domain units to positions of corresponding parent domain units
+    // (indexed by child positions. UINT_MAX denotes unmapped positions.)
+    std::vector<unsigned int> cp2pp;
+
+    // mapping from positions of parent domain units to positions of corresponding child domain units
+    // (indexed by parent positions. UINT_MAX denotes unmapped positions.)
+    std::vector<unsigned int> pp2cp;
+
+    // (child,parent) position pairs of the units on the boundary of the active patch,
+    // sorted by child positions. (See Grid::updateBoundaryPairs())
+    std::vector<std::pair<unsigned int,unsigned int>> bcpairs;
+
+    void mapPositions(unsigned int childPos, unsigned int parentPos);
+};
+
+// Maps a child unit position to a parent unit position and vice versa
+template <class unitType, class allocPolicy>
+void UnitIndex<unitType,allocPolicy>::mapPositions(unsigned int childPos, unsigned int parentPos){
+
+    if (childPos >= cp2pp.size()){
+        cp2pp.resize(childPos+1, UINT_MAX);
+    }
+    if (parentPos >= pp2cp.size()){
+        pp2cp.resize(parentPos+1, UINT_MAX);
+    }
+    cp2pp[childPos] = parentPos;
+    pp2cp[parentPos] = childPos;
+}
+
 // --------------------------------------------------------------------
 // Grid: The variadic abstract class template Grid is the container and
 //   manager of discrete model data for individual domain instances. A
@@ -42,19 +102,27 @@ namespace OpenHDM {
 //   such as nodes, elements, cells, etc., depending on the type of the
 //   spatial discretization. A grid instance also owns one or more
 //   patches as members, which designate the active regions within the
-//   grid.
+//   grid. The containers of a grid are allocated by the allocation
+//   policy of its patch type. (See allocation.h)
 // --------------------------------------------------------------------
 
 template <class patchType, class ...unitTypes>
 class Grid{
 public:
 
+    // Allocation policy and container types:
+    using allocPolicy = typename patchType::allocationPolicy;
+    template <class T>
+    using allocator = typename allocPolicy::template allocator<T>;
+    template <class unitType>
+    using UnitContainer = typename UnitStorage<unitType,allocPolicy>::type;
+
     // Constructors & operators:
     Grid(std::shared_ptr<Grid> parent_);
-    Grid(const Grid&) = default;
-    Grid& operator=(const Grid&) = default;
-    Grid(Grid&&) = default;
-    Grid& operator=(Grid&&) = default;
+    Grid(const Grid& other);
+    Grid& operator=(const Grid& other);
+    Grid(Grid&& other);
+    Grid& operator=(Grid&& other);
     virtual ~Grid() = default;
 
 
@@ -66,49 +134,175 @@ public:
     template <class unitType>
     void copyFromParent(unitType const & parentUnit);
 
+    template <class unitType>
+    void reserveUnits(size_t n);
+
+    template <class InputIt>
+    void insertUnits(InputIt first, InputIt last);
+
+    template <class InputIt>
+    void copyFromParent(InputIt first, InputIt last);
+
     template <class unitType>
     void removeUnit(unitType const & u);
 
     template <class unitType>
-    void setUnitPosition(unitType &u, std::vector<unitType> &units, std::type_index &typeIndex);
+    void setUnitPosition(unitType &u, UnitContainer<unitType> &units);
 
     template <class unitType>
     bool confirmUnitPosition(unitType const &u)const;
 
+    template <class unitType>
+    bool unitExists(int id);
+
     bool unitExists(int id, std::type_index &typeIndex);
 
+    // Functions for columnar unit management (see unitcolumns.h):
+
+    template <class unitType, class ...FieldTypes>
+    unsigned insertColumnarUnit(int id, FieldTypes const &... values);
+
+    template <class unitType>
+    UnitColumns<unitType>& getColumns();
+
+    template <class unitType>
+    void copyFromParent(std::vector<unsigned int> const &parentPositions);
+
     // Functions for patch management:
     virtual void initializePatches()=0; // for parent domains
     patchType & addPatch();
     void removePatch(patchType &patch);
     void setPatchID(patchType &patch);
     patchType & getPatch(unsigned id);
+    void invalidatePatches();
 
     // attribute accessors:
     bool isChild()const;
-    unsigned int get_id2pos(int id, std::type_index &typeIndex){return id2pos[typeIndex][id];}
+    template <class unitType>
+    unsigned int get_id2pos(int id);
+    unsigned int get_id2pos(int id, std::type_index &typeIndex);
+
+    template <class unitType>
+    unsigned int get_cp2pp(unsigned int childPos)const;
+    template <class unitType>
+    unsigned int get_pp2cp(unsigned int parentPos)const;
+    template <class unitType>
+    const std::vector<std::pair<unsigned int,unsigned int>>& getBoundaryPairs()const;
+
+    // Functions for parent/child mappings:
+    template <class unitType>
+    void updateBoundaryPairs(patchType const &patch);
+    template <class unitType>
+    BoundaryTransfer getBoundaryTransfer(size_t parentStride=sizeof(double), size_t childStride=sizeof(double))const;
+
+    // Functions for unit connectivity (see connectivity.h):
+    template <class fromType, class toType>
+    Adjacency<fromType,toType>& getAdjacency();
+    template <class fromType, class toType>
+    const Adjacency<fromType,toType>& getAdjacency()const;
+    template <class fromType, class toType>
+    void buildAdjacency(std::vector<std::pair<int,int>> const &idPairs);
+
+    template <class unitType>
+    void getInactiveNeighbors(std::vector<unsigned int> const &front, std::vector<unsigned int> &neighbors)const;
+    template <class unitType>
+    void getInactiveNeighbors(patchType const &patch, std::vector<unsigned int> &neighbors);
+    template <class unitType>
+    void trackBoundary(patchType &patch);
+
+    // Functions for locality-improving reordering of units (see reordering.h):
+    template <class unitType>
+    std::vector<unsigned int> reorderUnits(std::vector<unsigned int> const &order);
+    template <class unitType>
+    std::vector<unsigned int> reorderUnitsRCM();
+    template <class unitType>
+    std::vector<unsigned int> reorderUnitsAlongCurve(std::vector<std::array<double,2>> const &coords,
+                                                     Reordering::Curve curve=Reordering::Curve::Hilbert);
+    template <class unitType>
+    void remapParentPositions(std::vector<unsigned int> const &parentOld2new);
+
+    // Functions for grid snapshots and checkpoints:
+    void saveSnapshot(std::string filePath, uint64_t key)const;
+    bool loadSnapshot(std::string filePath, uint64_t key);
+    void writeCheckpoint(Serializer &s)const;
+    void readCheckpoint(Deserializer &d);
 
 protected:
 
     std::shared_ptr<Grid> parent;
 
     // Computational patches:
-    std::deque<patchType> patches;
-    std::list<int> vpids;  // vacant patch id's
+    std::deque<patchType, allocator<patchType>> patches;
+    std::list<int, allocator<int>> vpids;  // vacant patch id's
 
     // Units:
-    std::tuple<std::vector<unitTypes>...> unitsTuple;           // the container for all of the grid units (of any type)
-    std::map< std::type_index, std::list<unsigned int> > upos;  // unit positions
-    std::map< std::type_index, std::list<unsigned int> > vpos;  // vacant unit positions
+    std::tuple<UnitContainer<unitTypes>...> unitsTuple; // the container for all of the grid units (of any type)
+    std::tuple<UnitIndex<unitTypes,allocPolicy>...> indexTuple;      // the bookkeeping of the grid units (of any type)
+    std::tuple<AdjacencyRow<unitTypes,unitTypes...>...> adjacencyTuple; // the connectivity of the grid units (optional)
 
-    // mapping from id's of units to their position in vector "units":
-    std::map< std::type_index, std::unordered_map<int,unsigned int> > id2pos;
+    template <class unitType>
+    UnitIndex<unitType,allocPolicy>& getUnitIndex(){return std::get<UnitIndex<unitType,allocPolicy>>(indexTuple);}
+    template <class unitType>
+    const UnitIndex<unitType,allocPolicy>& getUnitIndex()const{return std::get<UnitIndex<unitType,allocPolicy>>(indexTuple);}
 
-    // mapping from positions of child domain units to positions of corresponding parent domain units
-    std::map< std::type_index, std::unordered_map<unsigned int,unsigned int> > cp2pp;
+private:
+    template <class unitType>
+    void collectBoundaryPositions(patchType const &patch, std::vector<unsigned int> &positions, std::false_type);
+    template <class unitType>
+    void collectBoundaryPositions(patchType const &patch, std::vector<unsigned int> &positions, std::true_type);
 
-    // mapping from positions of parent domain units to positions of corresponding child domain units
-    std::map< std::type_index, std::unordered_map<unsigned int,unsigned int> > pp2cp;
+    // Connectivity helpers:
+    template <class unitType>
+    void removeAdjacencies(unsigned int pos);
+    template <class unitType>
+    bool unitIsActive(unsigned int pos, std::false_type)const;
+    template <class unitType>
+    bool unitIsActive(unsigned int pos, std::true_type)const;
+
+    // Reordering helpers:
+    template <class unitType>
+    void permuteUnits(std::vector<unsigned int> const &order, std::vector<unsigned int> const &old2new, std::false_type);
+    template <class unitType>
+    void permuteUnits(std::vector<unsigned int> const &order, std::vector<unsigned int> const &old2new, std::true_type);
+    template <class unitType>
+    void permuteIndex(std::vector<unsigned int> const &old2new);
+
+    // Boundary tracking helpers:
+    void linkTrackedBoundaries();
+    template <class unitType>
+    void linkTrackedBoundary(patchType &patch);
+
+    // Sharing of the parent fields (see UnitColumns):
+    void linkParentColumns();
+    template <class unitType>
+    void linkParentColumns(std::false_type){}
+    template <class unitType>
+    void linkParentColumns(std::true_type);
+
+    // Snapshot helpers:
+    static std::string snapshotSignature();
+    template <class unitType>
+    void saveUnits(Serializer &s, std::false_type, bool withState=false)const;
+    template <class unitType>
+    void saveUnits(Serializer &s, std::true_type, bool withState=false)const;
+    template <class unitType>
+    void loadUnits(Deserializer &d, std::false_type, bool withState=false);
+    template <class unitType>
+    void loadUnits(Deserializer &d, std::true_type, bool withState=false);
+    template <class unitType>
+    void savePatchUnits(Serializer &s, patchType const &patch, std::false_type)const;
+    template <class unitType>
+    void savePatchUnits(Serializer &s, patchType const &patch, std::true_type)const;
+    template <class unitType>
+    void loadPatchUnits(Deserializer &d, patchType &patch, std::false_type);
+    template <class unitType>
+    void loadPatchUnits(Deserializer &d, patchType &patch, std::true_type);
+    template <class unitType>
+    void saveIndex(Serializer &s)const;
+    template <class unitType>
+    void loadIndex(Deserializer &d);
+    template <class unitType>
+    bool isEmpty()const{return std::get<UnitContainer<unitType>>(unitsTuple).size()==0;}
 };
 
 template <class patchType, class ...unitTypes>
@@ -118,34 +312,129 @@ Grid<patchType,unitTypes...>::Grid(std::shared_ptr<Grid> parent_):
 
 }
 
+// Copy and move constructors & operators. The columns of a child grid refer to the child to parent
+// position mappings of the grid, and the patches tracking their boundaries refer to the adjacencies
+// and units of the grid, so they are linked to those of the copy. (See UnitColumns, trackBoundary())
+template <class patchType, class ...unitTypes>
+Grid<patchType,unitTypes...>::Grid(const Grid& other):
+    parent(other.parent),
+    patches(other.patches),
+    vpids(other.vpids),
+    unitsTuple(other.unitsTuple),
+    indexTuple(other.indexTuple),
+    adjacencyTuple(other.adjacencyTuple)
+{
+    linkParentColumns();
+    linkTrackedBoundaries();
+}
+
+template <class patchType, class ...unitTypes>
+Grid<patchType,unitTypes...>& Grid<patchType,unitTypes...>::operator=(const Grid& other){
+    parent = other.parent;
+    patches = other.patches;
+    vpids = other.vpids;
+    unitsTuple = other.unitsTuple;
+    indexTuple = other.indexTuple;
+    adjacencyTuple = other.adjacencyTuple;
+    linkParentColumns();
+    linkTrackedBoundaries();
+    return *this;
+}
+
+template <class patchType, class ...unitTypes>
+Grid<patchType,unitTypes...>::Grid(Grid&& other):
+    parent(std::move(other.parent)),
+    patches(std::move(other.patches)),
+    vpids(std::move(other.vpids)),
+    unitsTuple(std::move(other.unitsTuple)),
+    indexTuple(std::move(other.indexTuple)),
+    adjacencyTuple(std::move(other.adjacencyTuple))
+{
+    linkParentColumns();
+    linkTrackedBoundaries();
+}
+
+template <class patchType, class ...unitTypes>
+Grid<patchType,unitTypes...>& Grid<patchType,unitTypes...>::operator=(Grid&& other){
+    parent = std::move(other.parent);
+    patches = std::move(other.patches);
+    vpids = std::move(other.vpids);
+    unitsTuple = std::move(other.unitsTuple);
+    indexTuple = std::move(other.indexTuple);
+    adjacencyTuple = std::move(other.adjacencyTuple);
+    linkParentColumns();
+    linkTrackedBoundaries();
+    return *this;
+}
+
 // Inserts a unit of any type to unitsTuple
 template <class patchType, class ...unitTypes>
 template <class unitType>
 void Grid<patchType,unitTypes...>::insertUnit(unitType u){
 
-    auto typeIndex = std::type_index(typeid(unitType));
-    auto& units = std::get<std::vector<unitType>>(unitsTuple);
+    auto& index = getUnitIndex<unitType>();
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+    const unitType * unitsData = units.data();
 
     // Assign a position to the unit to be inserted:
-    setUnitPosition(u, units, typeIndex);
+    setUnitPosition(u, units);
 
     // Add the unit to the end of the "units" vector
     units.push_back(u);
 
     // Update positions list:
-    std::list<unsigned int> &up = upos[typeIndex];
-    up.push_back(units.back().getPos());
+    index.upos.push_back(units.back().getPos());
 
     // Update id2pos
-    id2pos[typeIndex][units.back().getID()] = units.back().getPos();
+    index.id2pos[units.back().getID()] = units.back().getPos();
 
-    // Adding to and removing from "units" vector may invalidate references to elements of the
-    // vector which are stored in "unitptrs" of patches. Inform all the patches of the grid:
-    for (auto &patch : patches){
-        if (patch.isUpToDate()){
-            patch.invalidate();
+    // Adding to "units" vector invalidates references to elements of the vector which are
+    // stored in "unitptrs" of patches if the vector is reallocated. Inform all the patches:
+    if (units.data() != unitsData){
+        invalidatePatches();
+    }
+}
+
+// Reserves storage for n units of a given type. As long as the number of units does not exceed
+// n, inserting units does not invalidate the patches of the grid.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::reserveUnits(size_t n){
+
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+
+    if (n > units.capacity()){
+        units.reserve(n);
+        if (not isColumnar<unitType>::value){
+            invalidatePatches();
         }
     }
+    getUnitIndex<unitType>().id2pos.reserve(n);
+}
+
+// Inserts a range of units of any type to unitsTuple. The storage is reserved up front, the
+// position and id maps are updated in a single pass, and the patches are invalidated at most
+// once (only if the units vector is reallocated).
+template <class patchType, class ...unitTypes>
+template <class InputIt>
+void Grid<patchType,unitTypes...>::insertUnits(InputIt first, InputIt last){
+
+    using unitType = typename std::iterator_traits<InputIt>::value_type;
+
+    auto& index = getUnitIndex<unitType>();
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+
+    // Reserve storage for the new units:
+    size_t nNew = std::distance(first, last);
+    reserveUnits<unitType>(units.size()+nNew);
+
+    for (auto it=first; it!=last; ++it){
+        unitType u(*it);
+        setUnitPosition(u, units);
+        units.push_back(u);
+        index.upos.push_back(units.back().getPos());
+        index.id2pos[units.back().getID()] = units.back().getPos();
+    }
 }
 
 // Copies a parent unit and inserts it to unitsTuple
@@ -153,8 +442,8 @@ template <class patchType, class ...unitTypes>
 template <class unitType>
 void Grid<patchType,unitTypes...>::copyFromParent(unitType const & parentUnit){
 
-    auto typeIndex = std::type_index(typeid(unitType));
-    auto& units = std::get<std::vector<unitType>>(unitsTuple);
+    auto& index = getUnitIndex<unitType>();
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
 
     if (not isChild()){
         Report::error("Grid","Cannot copy unit from parent grid."
@@ -168,62 +457,129 @@ void Grid<patchType,unitTypes...>::copyFromParent(unitType const & parentUnit){
     unsigned int childPos = units.back().getPos();
 
     // Construct the mapping from child unit positions to parent unit positions
-    cp2pp[typeIndex][childPos] = parentPos;
-    pp2cp[typeIndex][parentPos] = childPos;
+    index.mapPositions(childPos, parentPos);
 
 }
 
 
-// Removes a given unit
+// Copies a range of parent units and inserts them to unitsTuple. (See insertUnits())
+template <class patchType, class ...unitTypes>
+template <class InputIt>
+void Grid<patchType,unitTypes...>::copyFromParent(InputIt first, InputIt last){
+
+    using unitType = typename std::iterator_traits<InputIt>::value_type;
+
+    auto& index = getUnitIndex<unitType>();
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+
+    if (not isChild()){
+        Report::error("Grid","Cannot copy unit from parent grid."
+                      " The grid belongs to a parent domain");
+    }
+
+    size_t firstNew = units.size();
+    insertUnits(first, last);
+
+    // Construct the mappings between child unit positions and parent unit positions
+    index.cp2pp.resize(units.size(), UINT_MAX);
+
+    auto it = first;
+    for (size_t i=firstNew; i<units.size(); i++, ++it){
+        unsigned int parentPos = it->getPos();
+        unsigned int childPos = units[i].getPos();
+        index.mapPositions(childPos, parentPos);
+    }
+}
+
+
+// Removes a given unit. The units after it are shifted down by one position, and the unit pointers
+// of the patches, the index (see UnitIndex), the adjacencies and the tracked boundaries are updated
+// accordingly. (The parent positions of the child grids must be remapped, see remapParentPositions())
 // Note: Avoid using this function. Always prefer to deactivate the unit instead.
 template <class patchType, class ...unitTypes>
 template <class unitType>
 void Grid<patchType,unitTypes...>::removeUnit(const unitType &u){
 
-    Report::warning("Removing Unit at position "+std::to_string(u.getPos())+"\n",1);
+    static_assert(not isColumnar<unitType>::value, "removeUnit does not support columnar unit types."
+                  " Deactivate the unit instead.");
 
-    auto typeIndex = std::type_index(typeid(unitType));
-    auto& units = std::get<std::vector<unitType>>(unitsTuple);
+    OPENHDM_WARNING("Grid::removeUnit", "Removing unit at position "+std::to_string(u.getPos()));
+
+    auto& index = getUnitIndex<unitType>();
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
 
     // get the position of the unit:
     if ( not confirmUnitPosition(u) )
         Report::error("Grid::removeUnit","Unit position to be removed is incorrect.");
     unsigned int pos = u.getPos();
+    int id = u.getID();
 
-    // Update position lists:
-    std::list<unsigned int> &up = upos[typeIndex];
-    up.remove(pos);
-    std::list<unsigned int> &vp = vpos[typeIndex];
-    vp.push_back(pos);
-
-    // remove the unit
-    units.erase(units.begin()+pos);
+    // Remove the unit from its patch:
+    if (units[pos].isActive()){
+        getPatch(units[pos].getPatchID()).removeUnitPtr(&units[pos]);
+    }
 
-    // Update positions of the units after "u":
-    for (size_t i=pos; i<units.size(); i++){
-        units[i]->pos--;
-        // Update id2pos
-        (id2pos[typeIndex][units[i].getID()] )--;
+    // Construct the units vector without the unit: (Units are not assignable, see Unit::id)
+    UnitContainer<unitType> remaining;
+    remaining.reserve(units.capacity());
+    for (size_t i=0; i<units.size(); i++){
+        if (i==pos) continue;
+        remaining.push_back(units[i]);
+        remaining.back().pos = unsigned(remaining.size()-1);
     }
+    const unitType * oldData = units.data();
+    units.swap(remaining);
 
-    // Adding to and removing from "units" vector may invalidate references to elements of the
-    // vector which are stored in "unitptrs" of patches. Inform all the patches of the grid:
+    // Redirect the unit pointers of the patches:
     for (auto &patch : patches){
-        if (patch.isUpToDate()){
-            patch.invalidate();
+        for (auto &unitptr : std::get<typename patchType::template UnitPtrs<unitType>>(patch.unitptrsTuple)){
+            size_t oldPos = unitptr-oldData;
+            unitptr = &units[oldPos>pos ? oldPos-1 : oldPos];
+        }
+    }
+
+    // Update the index:
+    auto shift = [pos](std::list<unsigned int, allocator<unsigned int>> &positions){
+        positions.remove(pos);
+        for (auto &p : positions){
+            if (p>pos) p--;
         }
+    };
+    shift(index.upos);
+    shift(index.vpos);
+    index.id2pos.erase(id);
+    for (auto &entry : index.id2pos){
+        if (entry.second>pos) entry.second--;
+    }
+    if (pos<index.cp2pp.size()){
+        index.cp2pp.erase(index.cp2pp.begin()+pos);
+    }
+    for (auto &childPos : index.pp2cp){
+        if (childPos==pos) childPos = UINT_MAX;
+        else if (childPos!=UINT_MAX and childPos>pos) childPos--;
+    }
+    index.bcpairs.erase(std::remove_if(index.bcpairs.begin(), index.bcpairs.end(),
+                                       [pos](std::pair<unsigned int,unsigned int> const &bcpair){
+                                           return bcpair.first==pos;}),
+                        index.bcpairs.end());
+    for (auto &bcpair : index.bcpairs){
+        if (bcpair.first>pos) bcpair.first--;
     }
 
+    // Update the connectivity and the tracked boundaries:
+    removeAdjacencies<unitType>(pos);
+    for (auto &patch : patches){
+        patch.template rebuildBoundary<unitType>();
+    }
 }
 
 // Sets the position of a new unit.
 template <class patchType, class ...unitTypes>
 template <class unitType>
 void Grid<patchType,unitTypes...>::setUnitPosition(unitType &u,
-                                                   std::vector<unitType> &units,
-                                                   std::type_index &typeIndex){
+                                                   UnitContainer<unitType> &units){
 
-    std::list<unsigned int> &vp = vpos[typeIndex];
+    auto &vp = getUnitIndex<unitType>().vpos;
 
     if (vp.size()>0){
         u.pos = vp.front();
@@ -240,25 +596,849 @@ template <class patchType, class ...unitTypes>
 template <class unitType>
 bool Grid<patchType,unitTypes...>::confirmUnitPosition(unitType const &u)const{
 
-    auto& units = std::get<std::vector<unitType>>(unitsTuple);
-
-    auto it = std::find( units.begin(), units.end(), u);
-    unsigned int pos = std::distance(units.begin(),it);
-    return (pos==u.getPos());
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+    return (u.getPos()<units.size() and units[u.getPos()].getID()==u.getID());
 }
 
 
-// Checks if a unit exists by searching the corresponging vector in "id2pos" map
+// Checks if a unit exists by searching the corresponging map in "indexTuple"
+template <class patchType, class ...unitTypes>
+template <class unitType>
+bool Grid<patchType,unitTypes...>::unitExists(int id){
+
+    auto& id2pos = getUnitIndex<unitType>().id2pos;
+    return (id2pos.find(id) != id2pos.end());
+}
+
+// Checks if a unit exists, where the unit type is determined at runtime.
+// Note: Prefer unitExists<unitType>(id) whenever the unit type is known at compile time.
 template <class patchType, class ...unitTypes>
 bool Grid<patchType,unitTypes...>::unitExists(int id, std::type_index &typeIndex){
 
-    if (id2pos[typeIndex].find(id) == id2pos[typeIndex].end()){
-        return false;
+    bool exists = false;
+    using expand = int[];
+    (void)expand{0, ( (typeIndex == std::type_index(typeid(unitTypes))) ?
+                      (exists = unitExists<unitTypes>(id), 0) : 0 )...};
+    return exists;
+}
+
+// Returns the position of the unit with a given id
+template <class patchType, class ...unitTypes>
+template <class unitType>
+unsigned int Grid<patchType,unitTypes...>::get_id2pos(int id){
+
+    auto& id2pos = getUnitIndex<unitType>().id2pos;
+    auto it = id2pos.find(id);
+    if (it == id2pos.end()){
+        Report::error("Grid::get_id2pos","No unit with the given id exists: "+std::to_string(id));
+    }
+    return it->second;
+}
+
+// Returns the position of the unit with a given id, where the unit type is determined at runtime.
+// Note: Prefer get_id2pos<unitType>(id) whenever the unit type is known at compile time.
+template <class patchType, class ...unitTypes>
+unsigned int Grid<patchType,unitTypes...>::get_id2pos(int id, std::type_index &typeIndex){
+
+    unsigned int pos = UINT_MAX;
+    using expand = int[];
+    (void)expand{0, ( (typeIndex == std::type_index(typeid(unitTypes))) ?
+                      (pos = get_id2pos<unitTypes>(id), 0) : 0 )...};
+    if (pos == UINT_MAX){
+        Report::error("Grid::get_id2pos","Unit type "+std::string(typeIndex.name())+
+                      " is not a unit type of the grid");
+    }
+    return pos;
+}
+
+// Returns the position of the parent unit corresponding to a child unit position, or UINT_MAX
+// if the child unit is not copied from a parent unit.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+unsigned int Grid<patchType,unitTypes...>::get_cp2pp(unsigned int childPos)const{
+
+    auto& cp2pp = getUnitIndex<unitType>().cp2pp;
+    return (childPos < cp2pp.size()) ? cp2pp[childPos] : UINT_MAX;
+}
+
+// Returns the position of the child unit corresponding to a parent unit position, or UINT_MAX
+// if the parent unit is not copied to the child grid.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+unsigned int Grid<patchType,unitTypes...>::get_pp2cp(unsigned int parentPos)const{
+
+    auto& pp2cp = getUnitIndex<unitType>().pp2cp;
+    return (parentPos < pp2cp.size()) ? pp2cp[parentPos] : UINT_MAX;
+}
+
+// Returns the (child,parent) position pairs of the units on the patch boundary
+template <class patchType, class ...unitTypes>
+template <class unitType>
+const std::vector<std::pair<unsigned int,unsigned int>>& Grid<patchType,unitTypes...>::getBoundaryPairs()const{
+    return getUnitIndex<unitType>().bcpairs;
+}
+
+// Precomputes the (child,parent) position pairs of the units that lie on the boundary of a given
+// patch. The pairs are sorted by child positions, so that transferring parent values to child
+// boundary units becomes a linear gather. Must be called whenever the patch boundary changes.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::updateBoundaryPairs(patchType const &patch){
+
+    if (not isChild()){
+        Report::error("Grid::updateBoundaryPairs","The grid belongs to a parent domain");
+    }
+
+    auto& index = getUnitIndex<unitType>();
+
+    // Collect the positions of the boundary units of the patch:
+    std::vector<unsigned int> positions;
+    collectBoundaryPositions<unitType>(patch, positions,
+                                       std::integral_constant<bool,isColumnar<unitType>::value>());
+    std::sort(positions.begin(), positions.end());
+
+    // Construct the sorted list of (child,parent) pairs:
+    index.bcpairs.clear();
+    index.bcpairs.reserve(positions.size());
+    for (auto childPos : positions){
+        unsigned int parentPos = get_cp2pp<unitType>(childPos);
+        if (parentPos != UINT_MAX){
+            index.bcpairs.emplace_back(childPos, parentPos);
+        }
+    }
+}
+
+// Returns a transfer from a field of the parent units to a field of the boundary units of the child
+// grid, based on the current boundary pairs. (See updateBoundaryPairs() and transfer.h) The strides
+// are the distances (in bytes) between the field values of consecutive units, e.g., sizeof(double)
+// for columnar fields, or the size of the unit type for the members of unit objects.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+BoundaryTransfer Grid<patchType,unitTypes...>::getBoundaryTransfer(size_t parentStride, size_t childStride)const{
+    return BoundaryTransfer(getBoundaryPairs<unitType>(), parentStride, childStride);
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::collectBoundaryPositions(patchType const &patch,
+                                                             std::vector<unsigned int> &positions,
+                                                             std::false_type){
+    if (patch.template tracksBoundary<unitType>()){
+        auto& boundary = patch.template getBoundary<unitType>();
+        positions.insert(positions.end(), boundary.begin(), boundary.end());
+        return;
+    }
+    for (auto unitptr : std::get<typename patchType::template UnitPtrs<unitType>>(patch.unitptrsTuple)){
+        if (unitptr->isBoundary()){
+            positions.push_back(unitptr->getPos());
+        }
+    }
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::collectBoundaryPositions(patchType const &patch,
+                                                             std::vector<unsigned int> &positions,
+                                                             std::true_type){
+    if (patch.template tracksBoundary<unitType>()){
+        auto& boundary = patch.template getBoundary<unitType>();
+        positions.insert(positions.end(), boundary.begin(), boundary.end());
+        return;
+    }
+    auto& columns = std::get<UnitColumns<unitType>>(unitsTuple);
+    for (auto pos : patch.template getUnitPositions<unitType>()){
+        if (columns.isBoundary(pos)){
+            positions.push_back(pos);
+        }
+    }
+}
+
+// Returns the adjacency from the units of type fromType to the units of type toType
+template <class patchType, class ...unitTypes>
+template <class fromType, class toType>
+Adjacency<fromType,toType>& Grid<patchType,unitTypes...>::getAdjacency(){
+    return std::get<Adjacency<fromType,toType>>(std::get<AdjacencyRow<fromType,unitTypes...>>(adjacencyTuple));
+}
+
+template <class patchType, class ...unitTypes>
+template <class fromType, class toType>
+const Adjacency<fromType,toType>& Grid<patchType,unitTypes...>::getAdjacency()const{
+    return std::get<Adjacency<fromType,toType>>(std::get<AdjacencyRow<fromType,unitTypes...>>(adjacencyTuple));
+}
+
+// Constructs the adjacency from fromType units to toType units from a list of (from,to) unit id
+// pairs, e.g., as read from a grid file.
+template <class patchType, class ...unitTypes>
+template <class fromType, class toType>
+void Grid<patchType,unitTypes...>::buildAdjacency(std::vector<std::pair<int,int>> const &idPairs){
+
+    std::vector<std::pair<unsigned int,unsigned int>> edges;
+    edges.reserve(idPairs.size());
+    for (auto &idPair : idPairs){
+        edges.emplace_back(get_id2pos<fromType>(idPair.first), get_id2pos<toType>(idPair.second));
+    }
+    getAdjacency<fromType,toType>().build(edges);
+}
+
+// Obtains the (unique) positions of the inactive neighbors of a front, i.e., a list of unit
+// positions such as the boundary of a patch, via the adjacency of unitType to itself. The cost
+// is proportional to the total degree of the front, not to the size of the patch.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::getInactiveNeighbors(std::vector<unsigned int> const &front,
+                                                         std::vector<unsigned int> &neighbors)const{
+
+    auto& adjacency = getAdjacency<unitType,unitType>();
+    neighbors.clear();
+    for (auto pos : front){
+        for (auto neighbor : adjacency.neighbors(pos)){
+            if (not unitIsActive<unitType>(neighbor, std::integral_constant<bool,isColumnar<unitType>::value>())){
+                neighbors.push_back(neighbor);
+            }
+        }
+    }
+    std::sort(neighbors.begin(), neighbors.end());
+    neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+}
+
+// Obtains the positions of the inactive neighbors of the boundary units of a patch. If the boundary
+// of the patch is tracked (see trackBoundary()), the cost is proportional to the size of the boundary.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::getInactiveNeighbors(patchType const &patch, std::vector<unsigned int> &neighbors){
+
+    std::vector<unsigned int> front;
+    collectBoundaryPositions<unitType>(patch, front, std::integral_constant<bool,isColumnar<unitType>::value>());
+    getInactiveNeighbors<unitType>(front, neighbors);
+}
+
+// Enables tracking the boundary units of a given type of a patch, i.e., the units of the patch that
+// are adjacent to units outside of the patch. The boundary is then updated incrementally as units
+// are inserted to or removed from the patch, the boundary flags of the units are maintained, and the
+// boundary units can be iterated via patch.getBoundary<unitType>(). The adjacency of the unit type
+// to itself must be constructed beforehand (see buildAdjacency()), and it must be symmetric, since
+// only the neighbors of an inserted or removed unit are updated. (See Adjacency::symmetrize())
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::trackBoundary(patchType &patch){
+
+    auto& adjacency = getAdjacency<unitType,unitType>();
+    if (adjacency.empty()){
+        Report::error("Grid::trackBoundary","The adjacency of the unit type is not constructed."
+                      " (See Grid::buildAdjacency())");
+    }
+    if (not adjacency.isSymmetric()){
+        Report::error("Grid::trackBoundary","The adjacency of the unit type is not symmetric."
+                      " (See Adjacency::symmetrize())");
+    }
+    patch.template setBoundaryTracking<unitType>(&adjacency, &std::get<UnitContainer<unitType>>(unitsTuple));
+}
+
+// Links the tracked boundaries of all of the patches to the adjacencies and units of the grid
+template <class patchType, class ...unitTypes>
+void Grid<patchType,unitTypes...>::linkTrackedBoundaries(){
+    for (auto &patch : patches){
+        using expand = int[];
+        (void)expand{0, (linkTrackedBoundary<unitTypes>(patch), 0)...};
+    }
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::linkTrackedBoundary(patchType &patch){
+    if (patch.template tracksBoundary<unitType>()){
+        patch.template setBoundaryTracking<unitType>(&getAdjacency<unitType,unitType>(),
+                                                     &std::get<UnitContainer<unitType>>(unitsTuple));
+    }
+}
+
+// Updates the adjacencies from and to a unit type once the unit at a given position is removed.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::removeAdjacencies(unsigned int pos){
+    using expand = int[];
+    (void)expand{0, (getAdjacency<unitType,unitTypes>().removeRow(pos),
+                     getAdjacency<unitTypes,unitType>().removeTarget(pos), 0)...};
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+bool Grid<patchType,unitTypes...>::unitIsActive(unsigned int pos, std::false_type)const{
+    return std::get<UnitContainer<unitType>>(unitsTuple)[pos].isActive();
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+bool Grid<patchType,unitTypes...>::unitIsActive(unsigned int pos, std::true_type)const{
+    return std::get<UnitColumns<unitType>>(unitsTuple).isActive(pos);
+}
+
+// Reorders the units of a given type such that the unit at the new position i is the unit at the
+// old position order[i], and returns the mapping from old positions to new positions. The positions
+// of the units, the bookkeeping, the adjacencies and the patches are updated consistently, and the
+// units of each patch are sorted by their new positions, so that sweeps over a patch follow the
+// storage order. Pointers to the units held outside of the patches are invalidated.
+// Note: Since the child grids map their units to the positions of the parent units, the returned
+// mapping must be passed to remapParentPositions() of each child grid that has already copied its
+// units from this grid.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+std::vector<unsigned int> Grid<patchType,unitTypes...>::reorderUnits(std::vector<unsigned int> const &order){
+
+    size_t n = std::get<UnitContainer<unitType>>(unitsTuple).size();
+    if (order.size()!=n){
+        Report::error("Grid::reorderUnits","The size of the ordering ("+std::to_string(order.size())+
+                      ") does not match the number of units ("+std::to_string(n)+").");
+    }
+    std::vector<unsigned int> old2new = Reordering::invert(order);
+
+    permuteUnits<unitType>(order, old2new, std::integral_constant<bool,isColumnar<unitType>::value>());
+    permuteIndex<unitType>(old2new);
+
+    using expand = int[];
+    (void)expand{0, (getAdjacency<unitType,unitTypes>().permuteRows(order),
+                     getAdjacency<unitTypes,unitType>().remapTargets(old2new), 0)...};
+
+    // Reconstruct the tracked boundaries of the patches:
+    for (auto &patch : patches){
+        patch.template rebuildBoundary<unitType>();
+    }
+
+    return old2new;
+}
+
+// Reorders the units of a given type by the reverse Cuthill-McKee ordering of their adjacency,
+// which must be constructed beforehand. (See buildAdjacency()) If the adjacency is not symmetric,
+// e.g., built from directed pairs, the ordering is computed from its symmetrized copy.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+std::vector<unsigned int> Grid<patchType,unitTypes...>::reorderUnitsRCM(){
+
+    auto& adjacency = getAdjacency<unitType,unitType>();
+    if (adjacency.empty()){
+        Report::error("Grid::reorderUnitsRCM","The adjacency of the unit type is not constructed."
+                      " (See Grid::buildAdjacency())");
+    }
+
+    size_t n = std::get<UnitContainer<unitType>>(unitsTuple).size();
+    unsigned int oldBandwidth = Reordering::bandwidth(adjacency);
+    std::vector<unsigned int> order;
+    if (adjacency.isSymmetric()){
+        order = Reordering::reverseCuthillMcKee(adjacency, n);
     }
     else{
-        return true;
+        auto symmetric = adjacency;
+        symmetric.symmetrize();
+        order = Reordering::reverseCuthillMcKee(symmetric, n);
+    }
+    auto old2new = reorderUnits<unitType>(order);
+    OPENHDM_LOG("Reordered "+std::to_string(n)+" units. Bandwidth: "+std::to_string(oldBandwidth)+
+                " -> "+std::to_string(Reordering::bandwidth(adjacency)),3);
+    return old2new;
+}
+
+// Reorders the units of a given type along a space-filling curve through the (x,y) coordinates of
+// the units, given in the order of the current unit positions.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+std::vector<unsigned int> Grid<patchType,unitTypes...>::reorderUnitsAlongCurve(std::vector<std::array<double,2>> const &coords,
+                                                                               Reordering::Curve curve){
+    return reorderUnits<unitType>(Reordering::alongCurve(coords, curve));
+}
+
+// Updates the mappings between the child and the parent unit positions after the units of the
+// parent grid are reordered. (See reorderUnits())
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::remapParentPositions(std::vector<unsigned int> const &parentOld2new){
+
+    if (not isChild()){
+        Report::error("Grid::remapParentPositions","The grid belongs to a parent domain");
+    }
+
+    auto& index = getUnitIndex<unitType>();
+
+    for (auto &parentPos : index.cp2pp){
+        if (parentPos != UINT_MAX){
+            parentPos = parentOld2new[parentPos];
+        }
+    }
+
+    std::vector<unsigned int> pp2cp(parentOld2new.size(), UINT_MAX);
+    for (size_t parentPos=0; parentPos<std::min(pp2cp.size(), index.pp2cp.size()); parentPos++){
+        pp2cp[parentOld2new[parentPos]] = index.pp2cp[parentPos];
+    }
+    index.pp2cp.swap(pp2cp);
+
+    for (auto &bcpair : index.bcpairs){
+        bcpair.second = parentOld2new[bcpair.second];
+    }
+
+    linkParentColumns<unitType>(std::integral_constant<bool,isColumnar<unitType>::value>());
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::permuteUnits(std::vector<unsigned int> const &order,
+                                                std::vector<unsigned int> const &old2new,
+                                                std::false_type){
+
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+
+    // Construct the reordered units vector:
+    UnitContainer<unitType> reordered;
+    reordered.reserve(units.size());
+    for (size_t i=0; i<order.size(); i++){
+        reordered.push_back(units[order[i]]);
+        reordered.back().pos = unsigned(i);
     }
+    const unitType * oldData = units.data();
+    units.swap(reordered);
 
+    // Redirect the unit pointers of the patches and sort them by the new positions:
+    for (auto &patch : patches){
+        auto& unitptrs = std::get<typename patchType::template UnitPtrs<unitType>>(patch.unitptrsTuple);
+        for (auto &unitptr : unitptrs){
+            size_t oldPos = unitptr-oldData;
+            if (oldPos >= old2new.size()){
+                Report::error("Grid::reorderUnits","Patch "+std::to_string(patch.getID())+
+                              " refers to a unit that is not stored in the grid.");
+            }
+            unitptr = &units[old2new[oldPos]];
+        }
+        std::sort(unitptrs.begin(), unitptrs.end());
+        for (size_t i=0; i<unitptrs.size(); i++){
+            unitptrs[i]->patchPos = unsigned(i);
+        }
+    }
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::permuteUnits(std::vector<unsigned int> const &order,
+                                                std::vector<unsigned int> const &old2new,
+                                                std::true_type){
+
+    auto& columns = std::get<UnitColumns<unitType>>(unitsTuple);
+    columns.permute(order);
+
+    // Remap the unit positions of the patches and sort them:
+    for (auto &patch : patches){
+        auto& unitpos = std::get<PositionList<unitType>>(patch.unitposTuple);
+        for (auto &pos : unitpos){
+            pos = old2new[pos];
+        }
+        std::sort(unitpos.begin(), unitpos.end());
+        for (size_t i=0; i<unitpos.size(); i++){
+            columns.patchPos[unitpos[i]] = unsigned(i);
+        }
+        unitpos.markModified();
+    }
+}
+
+// Updates the bookkeeping of a unit type after reordering. Since the units are stored
+// contiguously, there are no vacant positions after reordering.
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::permuteIndex(std::vector<unsigned int> const &old2new){
+
+    auto& index = getUnitIndex<unitType>();
+    size_t n = old2new.size();
+
+    for (auto &entry : index.id2pos){
+        entry.second = old2new[entry.second];
+    }
+
+    index.upos.clear();
+    for (size_t pos=0; pos<n; pos++){
+        index.upos.push_back(unsigned(pos));
+    }
+    index.vpos.clear();
+
+    if (not index.cp2pp.empty()){
+        std::vector<unsigned int> cp2pp(n, UINT_MAX);
+        for (size_t childPos=0; childPos<std::min(n, index.cp2pp.size()); childPos++){
+            cp2pp[old2new[childPos]] = index.cp2pp[childPos];
+        }
+        index.cp2pp.swap(cp2pp);
+    }
+
+    for (auto &childPos : index.pp2cp){
+        if (childPos != UINT_MAX){
+            childPos = old2new[childPos];
+        }
+    }
+
+    for (auto &bcpair : index.bcpairs){
+        bcpair.first = old2new[bcpair.first];
+    }
+    std::sort(index.bcpairs.begin(), index.bcpairs.end());
+
+    linkParentColumns<unitType>(std::integral_constant<bool,isColumnar<unitType>::value>());
+}
+
+// Writes a snapshot of the grid units and their bookkeeping (position lists, id and parent/child
+// position maps) to a binary file. The key should identify the inputs the grid is constructed
+// from, e.g., the content hash of the input files (see Serializer::hashFiles()), so that a later
+// run can restore the grid via loadSnapshot() instead of reading the inputs. Derived unit data is
+// written by Unit::writeBinary(). Patches are not included in the snapshot.
+template <class patchType, class ...unitTypes>
+void Grid<patchType,unitTypes...>::saveSnapshot(std::string filePath, uint64_t key)const{
+
+    Serializer s(filePath);
+    s.write(std::string("OHDMGRD1"));
+    s.write(key);
+    s.write(snapshotSignature());
+    s.write(isChild());
+
+    using expand = int[];
+    (void)expand{0, (saveUnits<unitTypes>(s, std::integral_constant<bool,isColumnar<unitTypes>::value>()),
+                     saveIndex<unitTypes>(s), 0)...};
+    s.writeChecksum();
+    s.close();
+
+    OPENHDM_LOG("Grid snapshot is saved to "+filePath,3);
+}
+
+// Restores the grid units from a snapshot written by saveSnapshot(). Returns false (and leaves the
+// grid unmodified) if the snapshot does not exist, is truncated or corrupt (i.e., its checksum
+// doesn't match), or if it was written for a different key or grid type. The grid must not have
+// any units. Restored units are inactive, i.e., patches must be initialized after the snapshot is
+// loaded. Unit types (derived from Unit) must provide a constructor taking the unit id, and
+// restore their data in Unit::readBinary().
+template <class patchType, class ...unitTypes>
+bool Grid<patchType,unitTypes...>::loadSnapshot(std::string filePath, uint64_t key){
+
+    bool empty = true;
+    using expand = int[];
+    (void)expand{0, (empty = empty and isEmpty<unitTypes>(), 0)...};
+    if (not empty){
+        Report::error("Grid::loadSnapshot","Snapshots can only be loaded into empty grids.");
+    }
+
+    if (not std::ifstream(filePath).good()){
+        OPENHDM_LOG("Grid snapshot "+filePath+" is not found.",3);
+        return false;
+    }
+
+    Deserializer d(filePath);
+    std::string magic, signature;
+    uint64_t snapshotKey = 0;
+    bool snapshotIsChild = false;
+    if (not d.verifyChecksum()){
+        Report::warning("Grid Snapshot!",filePath+" is truncated or corrupt. Ignoring the snapshot.");
+        return false;
+    }
+    d.read(magic);
+    if (magic!="OHDMGRD1"){
+        Report::warning("Grid Snapshot!",filePath+" is not a grid snapshot. Ignoring the snapshot.");
+        return false;
+    }
+    d.read(snapshotKey);
+    d.read(signature);
+    d.read(snapshotIsChild);
+    if (snapshotKey!=key or signature!=snapshotSignature() or snapshotIsChild!=isChild()){
+        OPENHDM_LOG("Grid snapshot "+filePath+" is out of date.",3);
+        return false;
+    }
+
+    (void)expand{0, (loadUnits<unitTypes>(d, std::integral_constant<bool,isColumnar<unitTypes>::value>()),
+                     loadIndex<unitTypes>(d), 0)...};
+    invalidatePatches();
+
+    OPENHDM_LOG("Grid snapshot is loaded from "+filePath,3);
+    return true;
+}
+
+// Returns a string identifying the unit types (and their sizes) of the grid.
+template <class patchType, class ...unitTypes>
+std::string Grid<patchType,unitTypes...>::snapshotSignature(){
+    std::string signature;
+    using expand = int[];
+    (void)expand{0, (signature += std::string(typeid(unitTypes).name())+":"
+                                  +std::to_string(sizeof(unitTypes))+";", 0)...};
+    return signature;
+}
+
+// Writes the complete state of the grid, i.e., the units (including their activation and patch
+// states), the bookkeeping of the units, the patches and the vacant patch ids, to a checkpoint.
+// (See Domain<>::writeCheckpoint()) Only the base Patch members of the patches are written.
+template <class patchType, class ...unitTypes>
+void Grid<patchType,unitTypes...>::writeCheckpoint(Serializer &s)const{
+
+    s.write(std::string("OHDMCHK1"));
+    s.write(snapshotSignature());
+
+    using expand = int[];
+    (void)expand{0, (saveUnits<unitTypes>(s, std::integral_constant<bool,isColumnar<unitTypes>::value>(), true),
+                     saveIndex<unitTypes>(s), 0)...};
+
+    s.write(uint64_t(patches.size()));
+    for (auto &patch : patches){
+        s.write(patch.getID());
+        (void)expand{0, (savePatchUnits<unitTypes>(s, patch,
+                                          std::integral_constant<bool,isColumnar<unitTypes>::value>()), 0)...};
+    }
+    s.write(vpids);
+}
+
+// Restores the complete state of the grid from a checkpoint written by writeCheckpoint(). The current
+// units of the grid are replaced, so any pointers to them are invalidated. The patches are restored
+// in place by their ids, so that references to them and their derived members remain valid. Patches
+// that are not included in the checkpoint are removed (which, as in removePatch(), invalidates the
+// references to the patches after them), and the missing ones are added. The tracked boundaries of
+// the patches are reconstructed.
+template <class patchType, class ...unitTypes>
+void Grid<patchType,unitTypes...>::readCheckpoint(Deserializer &d){
+
+    std::string magic, signature;
+    d.read(magic);
+    d.read(signature);
+    if (magic!="OHDMCHK1" or signature!=snapshotSignature()){
+        Report::error("Grid::readCheckpoint","The checkpoint does not belong to this grid type.");
+    }
+
+    using expand = int[];
+    (void)expand{0, (loadUnits<unitTypes>(d, std::integral_constant<bool,isColumnar<unitTypes>::value>(), true),
+                     loadIndex<unitTypes>(d), 0)...};
+
+    uint64_t nPatches = d.get<uint64_t>();
+    std::vector<unsigned> restoredIDs;
+    for (uint64_t p=0; p<nPatches; p++){
+        unsigned id = d.get<unsigned>();
+        restoredIDs.push_back(id);
+        auto it = std::find_if(patches.begin(), patches.end(),
+                               [id](patchType const &patch){return patch.getID()==id;});
+        if (it==patches.end()){
+            patches.emplace_back();
+            patches.back().setID(id);
+            it = patches.end()-1;
+        }
+        auto &patch = *it;
+        (void)expand{0, (loadPatchUnits<unitTypes>(d, patch,
+                                          std::integral_constant<bool,isColumnar<unitTypes>::value>()), 0)...};
+        (void)expand{0, (patch.template rebuildBoundary<unitTypes>(), 0)...};
+        patch.validate();
+    }
+    d.read(vpids);
+
+    // Remove the patches that are not included in the checkpoint:
+    patches.erase(std::remove_if(patches.begin(), patches.end(), [&](patchType const &patch){
+                      return std::find(restoredIDs.begin(), restoredIDs.end(), patch.getID())==restoredIDs.end();
+                  }), patches.end());
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::saveUnits(Serializer &s, std::false_type, bool withState)const{
+
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+    s.write(uint64_t(units.size()));
+    for (auto &u : units){
+        s.write(u.getID());
+        s.write(u.pos);
+        s.write(u.boundary);
+        if (withState){
+            s.write(u.active);
+            s.write(u.patchPos);
+            s.write(u.patchID);
+            s.write(u.activationTimestep);
+        }
+        u.writeBinary(s);
+    }
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::saveUnits(Serializer &s, std::true_type, bool withState)const{
+
+    std::get<UnitColumns<unitType>>(unitsTuple).writeBinary(s, withState);
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::loadUnits(Deserializer &d, std::false_type, bool withState){
+
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+    uint64_t n = d.get<uint64_t>();
+    units.clear();
+    units.reserve(n);
+    for (uint64_t i=0; i<n; i++){
+        unitType u(d.get<int>());
+        d.read(u.pos);
+        d.read(u.boundary);
+        if (withState){
+            d.read(u.active);
+            d.read(u.patchPos);
+            d.read(u.patchID);
+            d.read(u.activationTimestep);
+        }
+        u.readBinary(d);
+        units.push_back(u);
+    }
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::loadUnits(Deserializer &d, std::true_type, bool withState){
+
+    // (The shared fields of a child may be borrowed from the parent, see UnitColumns)
+    auto& columns = std::get<UnitColumns<unitType>>(unitsTuple);
+    if (isChild() and not columns.hasParent()){
+        columns.setParent(&parent->template getColumns<unitType>(), getUnitIndex<unitType>().cp2pp);
+    }
+    columns.readBinary(d, withState);
+}
+
+// Writes the units of a patch as indices of the units vector
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::savePatchUnits(Serializer &s, patchType const &patch, std::false_type)const{
+
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+    auto& unitptrs = std::get<typename patchType::template UnitPtrs<unitType>>(patch.unitptrsTuple);
+    std::vector<unsigned int> indices;
+    indices.reserve(unitptrs.size());
+    for (auto unitptr : unitptrs){
+        indices.push_back(unsigned(unitptr-units.data()));
+    }
+    s.write(indices);
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::savePatchUnits(Serializer &s, patchType const &patch, std::true_type)const{
+
+    s.write(static_cast<std::vector<unsigned> const &>(patch.template getUnitPositions<unitType>()));
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::loadPatchUnits(Deserializer &d, patchType &patch, std::false_type){
+
+    auto& units = std::get<UnitContainer<unitType>>(unitsTuple);
+    auto& unitptrs = std::get<typename patchType::template UnitPtrs<unitType>>(patch.unitptrsTuple);
+    std::vector<unsigned int> indices;
+    d.read(indices);
+    unitptrs.clear();
+    unitptrs.reserve(indices.size());
+    for (auto i : indices){
+        unitptrs.push_back(&units[i]);
+    }
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::loadPatchUnits(Deserializer &d, patchType &patch, std::true_type){
+
+    auto& unitpos = std::get<PositionList<unitType>>(patch.unitposTuple);
+    d.read(static_cast<std::vector<unsigned>&>(unitpos));
+    unitpos.markModified();
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::saveIndex(Serializer &s)const{
+
+    auto& index = getUnitIndex<unitType>();
+    s.write(index.upos);
+    s.write(index.vpos);
+    s.write(index.id2pos);
+    s.write(index.cp2pp);
+    s.write(index.pp2cp);
+    s.write(index.bcpairs);
+}
+
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::loadIndex(Deserializer &d){
+
+    auto& index = getUnitIndex<unitType>();
+    d.read(index.upos);
+    d.read(index.vpos);
+    d.read(index.id2pos);
+    d.read(index.cp2pp);
+    d.read(index.pp2cp);
+    d.read(index.bcpairs);
+
+    linkParentColumns<unitType>(std::integral_constant<bool,isColumnar<unitType>::value>());
+}
+
+// Inserts a columnar unit to unitsTuple and returns its position. Since columnar units are
+// referred to by their positions, patches remain valid.
+template <class patchType, class ...unitTypes>
+template <class unitType, class ...FieldTypes>
+unsigned Grid<patchType,unitTypes...>::insertColumnarUnit(int id, FieldTypes const &... values){
+
+    static_assert(isColumnar<unitType>::value, "insertColumnarUnit requires a columnar unit type");
+
+    auto& index = getUnitIndex<unitType>();
+    auto& columns = std::get<UnitColumns<unitType>>(unitsTuple);
+
+    // Append the unit to the columns:
+    unsigned pos = columns.append(id, values...);
+
+    // Update positions list:
+    index.upos.push_back(pos);
+
+    // Update id2pos
+    index.id2pos[id] = pos;
+
+    return pos;
+}
+
+// Returns a reference to the columns of a columnar unit type
+template <class patchType, class ...unitTypes>
+template <class unitType>
+UnitColumns<unitType>& Grid<patchType,unitTypes...>::getColumns(){
+    return std::get<UnitColumns<unitType>>(unitsTuple);
+}
+
+// Copies the columnar units at the given positions of the parent grid. The fields declared as
+// Shared are borrowed from the parent columns instead of being copied, so only the fields that
+// evolve in the child are stored by the child grid. (See unitcolumns.h)
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::copyFromParent(std::vector<unsigned int> const &parentPositions){
+
+    static_assert(isColumnar<unitType>::value, "copyFromParent requires a columnar unit type");
+
+    if (not isChild()){
+        Report::error("Grid","Cannot copy unit from parent grid."
+                      " The grid belongs to a parent domain");
+    }
+
+    auto& index = getUnitIndex<unitType>();
+    auto& columns = std::get<UnitColumns<unitType>>(unitsTuple);
+    if (not columns.hasParent()){
+        columns.setParent(&parent->template getColumns<unitType>(), index.cp2pp);
+    }
+
+    columns.reserve(columns.size()+parentPositions.size());
+    for (auto parentPos : parentPositions){
+        unsigned pos = columns.copyFromParent(parentPos);
+        index.upos.push_back(pos);
+        index.id2pos[columns.getID(pos)] = pos;
+        index.mapPositions(pos, parentPos);
+    }
+}
+
+// Links the columns of all of the columnar unit types to the child to parent position mappings
+template <class patchType, class ...unitTypes>
+void Grid<patchType,unitTypes...>::linkParentColumns(){
+    using expand = int[];
+    (void)expand{0, (linkParentColumns<unitTypes>(std::integral_constant<bool,isColumnar<unitTypes>::value>()), 0)...};
+}
+
+// Links the columns to the child to parent position mapping of the grid (e.g., after copying)
+template <class patchType, class ...unitTypes>
+template <class unitType>
+void Grid<patchType,unitTypes...>::linkParentColumns(std::true_type){
+
+    auto& columns = std::get<UnitColumns<unitType>>(unitsTuple);
+    if (columns.hasParent()){
+        columns.setParent(&parent->template getColumns<unitType>(), getUnitIndex<unitType>().cp2pp);
+    }
 }
 
 // Adds a new patch in "patches" vector
@@ -334,6 +1514,15 @@ patchType& Grid<patchType,unitTypes...>::getPatch(unsigned id){
 
 }
 
+// Informs all the patches of the grid that the pointers they store may be invalidated
+template <class patchType, class ...unitTypes>
+void Grid<patchType,unitTypes...>::invalidatePatches(){
+    for (auto &patch : patches){
+        if (patch.isUpToDate()){
+            patch.invalidate();
+        }
+    }
+}
 
 template <class patchType, class ...unitTypes>
 bool Grid<patchType,unitTypes...>::isChild() const{
@@ -19,6 +19,10 @@
 
 #include <sstream>
 #include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "report.h"
 #include "input.h"
 
@@ -30,16 +34,17 @@ using namespace OpenHDM;
 // the "Input" class defined in input.h
 // --------------------------------------------------------------------
 
-Input::Input(std::string fileFormat_, std::string filePath_):
+Input::Input(std::string fileFormat_, std::string filePath_, bool memoryMapped_):
     fileFormat(fileFormat_),
-    filePath(filePath_)
+    filePath(filePath_),
+    memoryMapped(memoryMapped_)
 {
 
 }
 
 Input::~Input()
 {
-    if (ifs.is_open()){
+    if (ifs.is_open() or mappedFile.isOpen()){
         closeInputFile();
     }
 }
@@ -49,6 +54,9 @@ void Input::openInputFile(){
     if (filePath == ""){
         Report::error("Input: "+fileTitle, "Input file path is empty.");
     }
+    else if (memoryMapped){
+        mappedFile = MappedFile(filePath);
+    }
     else{
         ifs.open(filePath,std::ifstream::in);
         if ( not (ifs.is_open()) ){
@@ -61,6 +69,89 @@ void Input::openInputFile(){
 
 void Input::closeInputFile(){
     ifs.close();
+    mappedFile.close();
+}
+
+
+// Returns a cursor at the beginning of the memory-mapped input file
+InputCursor Input::getCursor() const{
+
+    if (not mappedFile.isOpen()){
+        Report::error("Input File: "+fileTitle,
+                      "The input file at "+filePath+" is not memory-mapped.");
+    }
+    return InputCursor(mappedFile.data(), mappedFile.data()+mappedFile.size());
+}
+
+
+void Input::reportParseError(InputCursor const &cursor, size_t nParsed, size_t nParams){
+    Report::error("Input File!", "Couldn't read parameter "+to_string(nParsed+1)+" of "
+                  +to_string(nParams)+" at line "+to_string(cursor.lineNumber()));
+}
+
+
+// Maps a file into memory for reading. (Linux-specific)
+MappedFile::MappedFile(std::string filePath){
+
+    int fd = open(filePath.c_str(), O_RDONLY);
+    if (fd<0){
+        Report::error("Input File!","Cannot open input file at "+filePath);
+    }
+
+    struct stat s;
+    if (fstat(fd, &s)!=0){
+        ::close(fd);
+        Report::error("Input File!","Cannot determine the size of "+filePath);
+    }
+
+    length = s.st_size;
+    if (length>0){
+        mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping==MAP_FAILED){
+            ::close(fd);
+            Report::error("Input File!","Cannot map the input file at "+filePath);
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char*>(mapping);
+    }
+    else{
+        // An empty file is represented by a non-null, zero-length range:
+        begin = "";
+    }
+    ::close(fd);
+}
+
+MappedFile::MappedFile(MappedFile&& other):
+    begin(other.begin),
+    length(other.length),
+    mapping(other.mapping)
+{
+    other.begin = nullptr;
+    other.length = 0;
+    other.mapping = nullptr;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other){
+    if (this!=&other){
+        close();
+        std::swap(begin, other.begin);
+        std::swap(length, other.length);
+        std::swap(mapping, other.mapping);
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile(){
+    close();
+}
+
+void MappedFile::close(){
+    if (mapping){
+        munmap(mapping, length);
+    }
+    begin = nullptr;
+    length = 0;
+    mapping = nullptr;
 }
 
 
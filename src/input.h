@@ -25,9 +25,124 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <string_view>
+#include <charconv>
+#include <type_traits>
+#include "report.h"
 
 namespace OpenHDM {
 
+// --------------------------------------------------------------------
+// MappedFile: A read-only memory mapping of a file. (Linux-specific)
+// --------------------------------------------------------------------
+
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    explicit MappedFile(std::string filePath);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other);
+    MappedFile& operator=(MappedFile&& other);
+    ~MappedFile();
+
+    const char* data()  const {return begin;}
+    size_t      size()  const {return length;}
+    bool        isOpen()const {return begin!=nullptr;}
+    void        close();
+
+private:
+    const char* begin   = nullptr;
+    size_t      length  = 0;
+    void*       mapping = nullptr;
+};
+
+
+// --------------------------------------------------------------------
+// InputCursor: A zero-copy line/token cursor over a character range,
+//   e.g., a memory-mapped input file. Tokens are whitespace-separated
+//   and do not span lines. Numbers are parsed with std::from_chars,
+//   so reading does not allocate memory (except for std::string
+//   tokens).
+// --------------------------------------------------------------------
+
+class InputCursor
+{
+public:
+    InputCursor(const char* begin_, const char* end_):
+        pos(begin_), end(end_) {}
+
+    bool                eof()       const {return pos>=end;}
+    size_t              lineNumber()const {return nLine;}
+    std::string_view    nextLine();
+    std::string_view    nextToken();
+    void                skipLine();
+
+    // Parses the next token of the current line. Returns false if there are no tokens left
+    // in the line or if the token cannot be parsed as a value of type T.
+    template <typename T>
+    bool read(T &value);
+
+private:
+    template <typename T>
+    static bool parse(std::string_view token, T &value, std::true_type /*arithmetic*/);
+    template <typename T>
+    static bool parse(std::string_view token, T &value, std::false_type /*string*/);
+
+    const char* pos;
+    const char* end;
+    size_t nLine = 1;
+};
+
+// Returns the remainder of the current line and advances to the next line.
+inline std::string_view InputCursor::nextLine(){
+
+    const char* lineBegin = pos;
+    while (pos<end and *pos!='\n') pos++;
+    const char* lineEnd = pos;
+    if (lineEnd>lineBegin and lineEnd[-1]=='\r') lineEnd--;
+    if (pos<end){
+        pos++;
+        nLine++;
+    }
+    return std::string_view(lineBegin, lineEnd-lineBegin);
+}
+
+// Returns the next token of the current line, or an empty view if there are no tokens left.
+inline std::string_view InputCursor::nextToken(){
+
+    while (pos<end and (*pos==' ' or *pos=='\t' or *pos=='\r')) pos++;
+    const char* tokenBegin = pos;
+    while (pos<end and *pos!=' ' and *pos!='\t' and *pos!='\r' and *pos!='\n') pos++;
+    return std::string_view(tokenBegin, pos-tokenBegin);
+}
+
+// Skips the remainder of the current line
+inline void InputCursor::skipLine(){
+    nextLine();
+}
+
+template <typename T>
+bool InputCursor::read(T &value){
+    std::string_view token = nextToken();
+    if (token.empty()) return false;
+    return parse(token, value, std::is_arithmetic<T>());
+}
+
+template <typename T>
+bool InputCursor::parse(std::string_view token, T &value, std::true_type){
+    if (token.front()=='+') token.remove_prefix(1);
+    auto result = std::from_chars(token.data(), token.data()+token.size(), value);
+    return result.ec==std::errc() and result.ptr==token.data()+token.size();
+}
+
+template <typename T>
+bool InputCursor::parse(std::string_view token, T &value, std::false_type){
+    value = T(token);
+    return true;
+}
+
 // --------------------------------------------------------------------
 // Input: The concrete "Input" class is aimed to be used as a base
 //   class for derived classes encapsulating model input files.
@@ -37,7 +152,7 @@ class Input
 {
 public:
     // Constructors & Operators:
-    Input(std::string fileFormat_, std::string filePath_);
+    Input(std::string fileFormat_, std::string filePath_, bool memoryMapped_=false);
     Input(const Input&) = default;
     Input& operator=(const Input&) = default;
     Input(Input&&) = default;
@@ -55,6 +170,10 @@ public:
     template <typename ...ParamTypes>
     static void readParams(std::ifstream& ifs, ParamTypes&... params);
 
+    // Variadic function template to read parameters from a line of a memory-mapped input file
+    template <typename ...ParamTypes>
+    static void readParams(InputCursor& cursor, ParamTypes&... params);
+
     // auxiliary
     static std::vector<std::string> splitLine(std::string line);
     static void trimString(std::string &s);
@@ -64,6 +183,7 @@ public:
     std::string getFileFormat(){return fileFormat;}
     std::string getFilePath(){return filePath;}
     std::string getFileTitle(){return fileTitle;}
+    bool isMemoryMapped(){return memoryMapped;}
 
 protected:
 
@@ -74,6 +194,12 @@ protected:
     std::string filePath    = "";
     std::string fileTitle   = "";
 
+    // Memory-mapped input mode: If memoryMapped is true, openInputFile() maps the file instead
+    // of opening ifs, and the file is read via a cursor.
+    bool memoryMapped       = false;
+    MappedFile mappedFile;
+    InputCursor getCursor() const;
+
 private:
     // The following function templates are required by the variadic function template readLine()
     // (Function template implementations are at the end of this file)
@@ -82,6 +208,8 @@ private:
     template <typename FirstPType, typename ... Rest>
     static void readParams(std::stringstream &sline, FirstPType &param, Rest&... remainingParams);
 
+    static void reportParseError(InputCursor const &cursor, size_t nParsed, size_t nParams);
+
 };
 
 // Reads the values of arbitrary number of parameters from a line of an input file
@@ -99,6 +227,22 @@ void Input::readParams(std::ifstream& ifs, ParamTypes&... params){
         readParams(sline, params...);
 }
 
+// Reads the values of arbitrary number of parameters from the current line of a cursor, and
+// advances the cursor to the next line. Reports an error if a parameter cannot be parsed.
+template <typename ...ParamTypes>
+void Input::readParams(InputCursor& cursor, ParamTypes&... params){
+
+    size_t nParsed = 0;
+    bool success = true;
+    using expand = int[];
+    (void)expand{0, (success = success and cursor.read(params), nParsed += success, 0)...};
+
+    if (not success){
+        reportParseError(cursor, nParsed, sizeof...(ParamTypes));
+    }
+    cursor.skipLine();
+}
+
 template <typename FirstPType, typename ... Rest>
 void Input::readParams(std::stringstream &sline, FirstPType &param, Rest&... remainingParams){
     // Set the parameter:
@@ -19,6 +19,7 @@
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <algorithm>
 #include "report.h"
 #include "output.h"
 
@@ -38,8 +39,25 @@ Output::Output(bool isChild_):
 
 Output::~Output()
 {
+    // The derived object is already destroyed, so the I/O thread may only be joined if it is not
+    // (and will not be) writing a snapshot. (Derived classes must call closeOutputFile() or
+    // stopAsync() before their destruction.)
+    if (ioThread.joinable()){
+        bool writing;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            writing = (nWriting>0 or not queue.empty());
+        }
+        if (writing){
+            Report::error("Output File!","The I/O thread of "+fileTitle+" is still writing snapshots."
+                          " closeOutputFile() or stopAsync() must be called before the derived output"
+                          " is destructed.");
+        }
+        stopAsync();
+    }
+
     if (ofs.is_open()){
-        closeOutputFile();
+        ofs.close();
     }
 }
 
@@ -55,11 +73,11 @@ void Output::openOutputFile(){
 
     if ( stat(fileDir.c_str(), &s) != 0){
         // Directory is not found. Create the directory:
-        Report::log("Couldn't find '"+fileDir+"'. Creating the directory:",3);
+        OPENHDM_LOG("Couldn't find '"+fileDir+"'. Creating the directory:",3);
         if ( mkdir(fileDir.c_str(), 0744) != 0 and errno != EEXIST)
             Report::error("Output File!",fileDir+" directory could not be created");
         else
-            Report::log("The directory is successfully created.",4);
+            OPENHDM_LOG("The directory is successfully created.",4);
     }
     else if ( not (s.st_mode & S_IFDIR) ){
         Report::error("Output File!",fileDir+" is not a directory");
@@ -72,7 +90,7 @@ void Output::openOutputFile(){
 
     filePath = fileDir+"/"+fileName;
 
-    ofs.open(filePath,std::ofstream::out);
+    ofs.open(filePath,openMode);
     if (not ofs.is_open()){
         Report::error("Output File!",
                       fileTitle+" at "+filePath+" could not be opened.");
@@ -81,5 +99,111 @@ void Output::openOutputFile(){
 
 
 void Output::closeOutputFile(){
+
+    // Drain the queue of pending snapshots before closing the file:
+    stopAsync();
     ofs.close();
 }
+
+
+// Enables asynchronous output with a given maximum number of pending snapshots and
+// launches the I/O thread.
+void Output::enableAsync(unsigned maxQueueDepth){
+
+    if (async){
+        Report::error("Output File!","Asynchronous output of "+fileTitle+" is already enabled.");
+    }
+
+    async = true;
+    stopIO = false;
+    queueDepth = std::max(1u, maxQueueDepth);
+    ioThread = std::thread(&Output::ioLoop, this);
+}
+
+
+// Returns an empty buffer to fill with a snapshot. Buffers of previously written
+// snapshots are reused, so their capacities are retained.
+Output::Buffer Output::acquireBuffer(){
+
+    std::lock_guard<std::mutex> lock(mtx);
+    if (freeBuffers.empty()){
+        return Buffer();
+    }
+    Buffer buffer = std::move(freeBuffers.back());
+    freeBuffers.pop_back();
+    buffer.clear();
+    return buffer;
+}
+
+
+// Hands over a snapshot of timestep ts to the I/O thread. Blocks while the queue is full.
+// If asynchronous output is not enabled, the snapshot is written immediately.
+void Output::submit(unsigned int ts, Buffer &&buffer){
+
+    if (not async){
+        writeSnapshot(ts, buffer);
+        std::lock_guard<std::mutex> lock(mtx);
+        freeBuffers.push_back(std::move(buffer));
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx);
+    spaceCond.wait(lock, [&]{return queue.size()+nWriting < queueDepth;});
+    queue.emplace_back(ts, std::move(buffer));
+    lock.unlock();
+    queueCond.notify_one();
+}
+
+
+// Blocks until all of the submitted snapshots are written.
+void Output::flush(){
+
+    std::unique_lock<std::mutex> lock(mtx);
+    spaceCond.wait(lock, [&]{return queue.empty() and nWriting==0;});
+}
+
+
+// Writes a snapshot to the output file. Must be overridden by the derived classes that
+// submit snapshots. Called by the I/O thread if asynchronous output is enabled.
+void Output::writeSnapshot(unsigned int, Buffer const &){
+    Report::error("Output File!","writeSnapshot() is not implemented for "+fileTitle);
+}
+
+
+// The main loop of the I/O thread: writes the submitted snapshots in order of submission
+// until stopIO is set and the queue is drained.
+void Output::ioLoop(){
+
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true){
+        queueCond.wait(lock, [&]{return stopIO or not queue.empty();});
+        if (queue.empty()) break;   // stopIO is set and all snapshots are written
+
+        auto snapshot = std::move(queue.front());
+        queue.pop_front();
+        nWriting = 1;
+        lock.unlock();
+
+        writeSnapshot(snapshot.first, snapshot.second);
+
+        lock.lock();
+        nWriting = 0;
+        freeBuffers.push_back(std::move(snapshot.second));
+        spaceCond.notify_all();
+    }
+}
+
+
+// Drains the queue and joins the I/O thread.
+void Output::stopAsync(){
+
+    if (not ioThread.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopIO = true;
+    }
+    queueCond.notify_one();
+    ioThread.join();
+    async = false;
+}
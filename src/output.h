@@ -23,12 +23,28 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace OpenHDM {
 
 // --------------------------------------------------------------------
 // Output: The concrete "Output" class is aimed to be used as a base
 //   class for derived classes encapsulating model output files.
+//   Outputs may optionally be written asynchronously: once
+//   enableAsync() is called, the derived writeOutput() copies the
+//   fields it needs into a buffer obtained by acquireBuffer() and
+//   passes it to submit(). The buffer is then written by a background
+//   I/O thread via writeSnapshot(), so that timestepping is not
+//   stalled by file I/O. At most maxQueueDepth snapshots may be
+//   pending; submit() blocks when the queue is full. Buffers are
+//   recycled to avoid reallocations. Since the I/O thread calls the
+//   derived writeSnapshot(), derived classes enabling asynchronous
+//   output must stop it, i.e., call closeOutputFile() or stopAsync(),
+//   before their destruction. Outputs are not copyable or movable.
 // --------------------------------------------------------------------
 
 class Output
@@ -36,10 +52,10 @@ class Output
 public:
     // Constructors & Operators:
     Output(bool isChild_);
-    Output(const Output&) = default;
-    Output& operator=(const Output&) = default;
-    Output(Output&&) = default;
-    Output& operator=(Output&&) = default;
+    Output(const Output&) = delete;
+    Output& operator=(const Output&) = delete;
+    Output(Output&&) = delete;
+    Output& operator=(Output&&) = delete;
     virtual ~Output();
 
     // Functions to be overridden:
@@ -49,15 +65,42 @@ public:
     virtual void closeOutputFile();
 
 protected:
+
+    // Asynchronous output:
+    using Buffer = std::vector<double>;
+    void enableAsync(unsigned maxQueueDepth=2);
+    bool isAsync() const {return async;}
+    Buffer acquireBuffer();
+    void submit(unsigned int ts, Buffer &&buffer);
+    void flush();
+    void stopAsync();       // drains the queue and joins the I/O thread
+    virtual void writeSnapshot(unsigned int ts, Buffer const &buffer);
+
     int type                = 0;
     std::string fileDir     = ""; // the directory at which the output file will be created
     std::string fileName    = "";
     std::string filePath    = ""; // fileDir+fileName
     std::string fileTitle   = "";
     std::ofstream ofs;
+    std::ios_base::openmode openMode = std::ofstream::out;
 
     bool isChild;
 
+private:
+
+    void ioLoop();
+
+    bool async              = false;
+    bool stopIO             = false;
+    unsigned queueDepth     = 2;
+    unsigned nWriting       = 0;    // no. of snapshots being written by the I/O thread (0 or 1)
+    std::deque<std::pair<unsigned int, Buffer>> queue;
+    std::vector<Buffer> freeBuffers;
+    std::mutex mtx;
+    std::condition_variable queueCond;  // notified when a snapshot is submitted or stopIO is set
+    std::condition_variable spaceCond;  // notified when a snapshot has been written
+    std::thread ioThread;
+
 };
 
 } // end of namespace OpenHDM
@@ -28,31 +28,45 @@
 #include <climits>
 #include <vector>
 #include <algorithm>
+#include "report.h"
+#include "threading.h"
+#include "unitcolumns.h"
+#include "allocation.h"
+#include "connectivity.h"
 
 namespace OpenHDM {
 
 // --------------------------------------------------------------------
-// Patch: The variadic abstract class template "Patch" is aimed to be
+// BasicPatch: The variadic abstract class template "BasicPatch" is aimed to be
 //   used as a base class for specialized patch types which are used to
 //   designate the active regions of grids, i.e, the regions at which
 //   the numerical computations are to be carried out. Patch is
 //   designed to maintain pointers (as references) to the objects
 //   stored in Grid, and so similar to grids, patches can have an
-//   arbitrary number of unit types.
+//   arbitrary number of unit types. The containers of a patch are
+//   allocated by the allocation policy "allocPolicy", which is also
+//   adopted by the associated grid (see allocation.h). "Patch" is the
+//   patch with the default (standard) allocation policy.
 // --------------------------------------------------------------------
 
-template <class ...UnitTypes>
-class Patch{
+template <class allocPolicy, class ...UnitTypes>
+class BasicPatch{
     template <class pType, class ...uTypes> friend class Grid;
 
 public:
 
-    Patch();
-    Patch(const Patch&) = default;
-    Patch& operator=(const Patch&) = default;
-    Patch(Patch&&) = default;
-    Patch& operator=(Patch&&) = default;
-    virtual ~Patch();
+    using allocationPolicy = allocPolicy;
+
+    // The container of the unit pointers of a given type:
+    template <class UnitType>
+    using UnitPtrs = std::vector<UnitType*, typename allocPolicy::template allocator<UnitType*>>;
+
+    BasicPatch();
+    BasicPatch(const BasicPatch&) = default;
+    BasicPatch& operator=(const BasicPatch&) = default;
+    BasicPatch(BasicPatch&&) = default;
+    BasicPatch& operator=(BasicPatch&&) = default;
+    virtual ~BasicPatch();
 
 
     template <class UnitType>
@@ -61,6 +75,52 @@ public:
     template <class UnitType>
     void removeUnitPtr(UnitType * unitptr);
 
+    template <class UnitType>
+    void removeUnitPtrUnordered(UnitType * unitptr);
+
+    // Functions for bulk edits:
+    template <class UnitType>
+    void insertUnitPtrs(std::vector<UnitType*> const & newptrs, unsigned ts);
+
+    template <class UnitType>
+    void removeUnitPtrs(std::vector<UnitType*> const & oldptrs);
+
+    // Functions for columnar unit types (see unitcolumns.h):
+    template <class UnitType>
+    void insertUnitPos(UnitColumns<UnitType> &columns, unsigned pos, unsigned ts);
+
+    template <class UnitType>
+    void removeUnitPos(UnitColumns<UnitType> &columns, unsigned pos);
+
+    template <class UnitType>
+    const std::vector<unsigned>& getUnitPositions()const;
+
+    template <class UnitType>
+    const PositionList<UnitType>& getPositionList()const{return std::get<PositionList<UnitType>>(unitposTuple);}
+
+    // Functions for marking patch boundary units:
+    template <class UnitType>
+    void setBoundary(UnitType * unitptr, bool boundary=true);
+
+    template <class UnitType>
+    void setBoundary(UnitColumns<UnitType> &columns, unsigned pos, bool boundary=true);
+
+    // Functions for tracked patch boundaries (see Grid<>::trackBoundary()):
+    template <class UnitType>
+    bool tracksBoundary()const{return std::get<BoundaryTracker<UnitType>>(boundaryTuple).adjacency!=nullptr;}
+
+    // Returns the positions of the boundary units of a given type (in the units of the grid):
+    template <class UnitType>
+    const std::vector<unsigned>& getBoundary()const{return std::get<BoundaryTracker<UnitType>>(boundaryTuple).refs;}
+
+    // Functions for intra-domain parallelism:
+    template <class UnitType, class Function>
+    void parallelFor(Threading::Executor &executor, Function f, size_t chunkSize=1024);
+
+    template <class UnitType, class T, class MapFunction, class ReduceFunction>
+    T parallelReduce(Threading::Executor &executor, T init, MapFunction map, ReduceFunction reduce,
+                     size_t chunkSize=1024);
+
     void invalidate();
 
     // attribute accessors:
@@ -73,37 +133,100 @@ protected:
     void setID(int patchID){id=patchID;}
     void validate(){upToDate=true;}
 
-    std::tuple<std::vector<UnitTypes*>...> unitptrsTuple;
+    std::tuple<UnitPtrs<UnitTypes>...> unitptrsTuple;
     // ^ This vector of tuples contains pointers to units of the patch instance. (The pointed units
     // are normally stored in "unitsTuple" container of the associated grid instance.)
     // Important: Before dereferencing the elements of unitptrs, ensure that the pointers
     // stored are not invalidated! (See invalidate()).
 
+    std::tuple<PositionList<UnitTypes>...> unitposTuple;
+    // ^ This tuple contains the positions of columnar units of the patch instance. Unlike the
+    // pointers in unitptrsTuple, positions are not invalidated when new units are inserted.
+
+    // Boundary tracking (see Grid<>::trackBoundary()):
+    template <class UnitType>
+    void setBoundaryTracking(Adjacency<UnitType,UnitType> const *adjacency,
+                             typename UnitStorage<UnitType,allocPolicy>::type *units);
+    template <class UnitType>
+    void rebuildBoundary();
+
 private:
+
+    // --------------------------------------------------------------------
+    // BoundaryTracker: The boundary units of a given type, i.e., the units
+    //   of the patch with at least one neighbor (via the adjacency of the
+    //   unit type to itself) that is not included in the patch. The
+    //   boundary is updated incrementally whenever a unit is inserted to
+    //   or removed from the patch, at a cost proportional to the square of
+    //   the unit degree, and the boundary flags of the units are kept
+    //   consistent. The boundary units are referred to by their positions
+    //   (stored contiguously and unordered), so that the boundary remains
+    //   valid when the units of the grid are reallocated, e.g., as units
+    //   are inserted. The adjacency must be symmetric.
+    // --------------------------------------------------------------------
+
+    template <class UnitType>
+    struct BoundaryTracker{
+        const Adjacency<UnitType,UnitType> *adjacency = nullptr;
+        typename UnitStorage<UnitType,allocPolicy>::type *units = nullptr;
+        std::vector<unsigned> refs;     // the positions of the boundary units
+        std::vector<unsigned> slots;    // the indices of the units in refs (by unit position)
+    };
+
+    std::tuple<BoundaryTracker<UnitTypes>...> boundaryTuple;
+
+    template <class UnitType>
+    void updateBoundary(unsigned pos, bool inserted);
+    template <class UnitType>
+    void refreshBoundary(unsigned pos);
+    template <class UnitType>
+    void addToBoundary(unsigned pos);
+    template <class UnitType>
+    void dropFromBoundary(unsigned pos);
+
+    // Unit accessors for boundary tracking:
+    template <class UnitType>
+    bool contains(BoundaryTracker<UnitType> const &tracker, unsigned pos, std::false_type)const;
+    template <class UnitType>
+    bool contains(BoundaryTracker<UnitType> const &tracker, unsigned pos, std::true_type)const;
+    template <class UnitType>
+    void setBoundaryFlag(BoundaryTracker<UnitType> &tracker, unsigned pos, bool boundary, std::false_type);
+    template <class UnitType>
+    void setBoundaryFlag(BoundaryTracker<UnitType> &tracker, unsigned pos, bool boundary, std::true_type);
+    template <class UnitType>
+    static unsigned refPos(UnitType* unitptr){return unitptr->getPos();}
+    static unsigned refPos(unsigned pos){return pos;}
+
+    // Returns the unitptrs of a unit type, or the positions if the unit type is columnar:
+    template <class UnitType>
+    UnitPtrs<UnitType>& getUnitRefs(std::false_type){return std::get<UnitPtrs<UnitType>>(unitptrsTuple);}
+    template <class UnitType>
+    std::vector<unsigned>& getUnitRefs(std::true_type){return std::get<PositionList<UnitType>>(unitposTuple);}
+
     bool upToDate   = false;
     bool locked     = false;
     unsigned id     = UINT_MAX;
 
 };
 
-template <class ...UnitTypes>
-Patch<UnitTypes...>::Patch()
+template <class allocPolicy, class ...UnitTypes>
+BasicPatch<allocPolicy,UnitTypes...>::BasicPatch()
 {
 
 }
 
-template <class ...UnitTypes>
-Patch<UnitTypes...>::~Patch(){
+template <class allocPolicy, class ...UnitTypes>
+BasicPatch<allocPolicy,UnitTypes...>::~BasicPatch(){
 
 }
 
 // Inserts a unit ptr to the patch, assigns patchPos of the unit, and activates the unit.
-template <class ...UnitTypes>
+template <class allocPolicy, class ...UnitTypes>
 template <class UnitType>
-void Patch<UnitTypes...>::insertUnitPtr(UnitType * unitptr, unsigned ts){
+void BasicPatch<allocPolicy,UnitTypes...>::insertUnitPtr(UnitType * unitptr, unsigned ts){
 
     // Get a reference to the corresponding unitptrs vector in unitptrsTuple tuple:
-    auto& unitptrs = std::get<std::vector<UnitType*>>(unitptrsTuple);
+    auto& unitptrs = std::get<UnitPtrs<UnitType>>(unitptrsTuple);
 
     // Determine and assign the position of the unitptr in unitptrs vector:
     unitptr->patchPos = unsigned(unitptrs.size());
@@ -117,16 +240,18 @@ void Patch<UnitTypes...>::insertUnitPtr(UnitType * unitptr, unsigned ts){
     // Insert the unitptr to unitptrs vector
     unitptrs.push_back(unitptr);
 
+    // Update the tracked boundary:
+    updateBoundary<UnitType>(unitptr->getPos(), true);
 }
 
 // Removes a unit ptr from the patch, deactivates the unit and updates patchPos of units
 // placed after the unit removed from the patch.
-template <class ...UnitTypes>
+template <class allocPolicy, class ...UnitTypes>
 template <class UnitType>
-void Patch<UnitTypes...>::removeUnitPtr(UnitType * unitptr){
+void BasicPatch<allocPolicy,UnitTypes...>::removeUnitPtr(UnitType * unitptr){
 
     // Get a reference to the corresponding unitptrs vector in unitptrsTuple tuple:
-    auto& unitptrs = std::get<std::vector<UnitType*>>(unitptrsTuple);
+    auto& unitptrs = std::get<UnitPtrs<UnitType>>(unitptrsTuple);
 
     // Unit position inside unitptrs:
     unsigned int patchPos = unitptr->getPatchPos();
@@ -135,24 +260,362 @@ void Patch<UnitTypes...>::removeUnitPtr(UnitType * unitptr){
     unitptr->deactivate();
 
     // Erase the pointer from unitptrs:
-    unitptrs.erase(std::remove(unitptrs.begin(),unitptrs.end(),unitptr),unitptrs.end());
+    unitptrs.erase(unitptrs.begin()+patchPos);
 
     // Update the positions of units after the deleted unitptr:
     unsigned int newSize = (unsigned)(unitptrs.size());
     for (unsigned int i=patchPos; i<newSize; i++){
         (unitptrs[i]->patchPos)--;
     }
+
+    // Update the tracked boundary:
+    updateBoundary<UnitType>(unitptr->getPos(), false);
+}
+
+
+// Removes a unit ptr from the patch in constant time by moving the last unitptr to the place of
+// the removed one. Note that the order of unitptrs is not preserved.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::removeUnitPtrUnordered(UnitType * unitptr){
+
+    // Get a reference to the corresponding unitptrs vector in unitptrsTuple tuple:
+    auto& unitptrs = std::get<UnitPtrs<UnitType>>(unitptrsTuple);
+
+    // Unit position inside unitptrs:
+    unsigned int patchPos = unitptr->getPatchPos();
+
+    // Deactivate the unit:
+    unitptr->deactivate();
+
+    // Move the last unitptr to the position of the removed one:
+    UnitType * lastptr = unitptrs.back();
+    unitptrs[patchPos] = lastptr;
+    lastptr->patchPos = patchPos;
+    unitptrs.pop_back();
+
+    // Update the tracked boundary:
+    updateBoundary<UnitType>(unitptr->getPos(), false);
+}
+
+// Inserts a number of unit ptrs to the patch. Equivalent to calling insertUnitPtr() for each
+// unitptr, but reserves the required capacity in advance.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::insertUnitPtrs(std::vector<UnitType*> const & newptrs, unsigned ts){
+
+    // Get a reference to the corresponding unitptrs vector in unitptrsTuple tuple:
+    auto& unitptrs = std::get<UnitPtrs<UnitType>>(unitptrsTuple);
+
+    unitptrs.reserve(unitptrs.size()+newptrs.size());
+
+    for (auto unitptr : newptrs){
+        unitptr->patchPos = unsigned(unitptrs.size());
+        unitptr->activate(ts);
+        unitptr->patchID = getID();
+        unitptrs.push_back(unitptr);
+    }
+
+    // Update the tracked boundary once all of the units are inserted:
+    if (tracksBoundary<UnitType>()){
+        for (auto unitptr : newptrs){
+            updateBoundary<UnitType>(unitptr->getPos(), true);
+        }
+    }
+}
+
+// Removes a number of unit ptrs from the patch. The units are deactivated first, and the
+// remaining unitptrs are then compacted (and their patchPos updated) in a single pass, so the
+// cost is linear in the size of the patch regardless of the number of units removed.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::removeUnitPtrs(std::vector<UnitType*> const & oldptrs){
+
+    if (oldptrs.empty()) return;
+
+    // Get a reference to the corresponding unitptrs vector in unitptrsTuple tuple:
+    auto& unitptrs = std::get<UnitPtrs<UnitType>>(unitptrsTuple);
+
+    // Deactivate the units and determine the first position to be compacted:
+    unsigned int firstPos = unsigned(unitptrs.size());
+    for (auto unitptr : oldptrs){
+        if (unitptr->getPatchID() != getID()){
+            Report::error("Patch::removeUnitPtrs","Unit "+std::to_string(unitptr->getID())+
+                          " is not included in patch "+std::to_string(getID()));
+        }
+        firstPos = std::min(firstPos, unitptr->getPatchPos());
+        unitptr->deactivate();
+    }
+
+    // Compact the remaining (active) unitptrs and update their positions:
+    unsigned int newSize = firstPos;
+    for (size_t i=firstPos; i<unitptrs.size(); i++){
+        UnitType * unitptr = unitptrs[i];
+        if (unitptr->isActive()){
+            unitptr->patchPos = newSize;
+            unitptrs[newSize++] = unitptr;
+        }
+    }
+    unitptrs.resize(newSize);
+
+    // Update the tracked boundary once all of the units are removed:
+    if (tracksBoundary<UnitType>()){
+        for (auto unitptr : oldptrs){
+            updateBoundary<UnitType>(unitptr->getPos(), false);
+        }
+    }
+}
+
+// Inserts the position of a columnar unit to the patch, assigns patchPos of the unit, and
+// activates the unit.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::insertUnitPos(UnitColumns<UnitType> &columns, unsigned pos, unsigned ts){
+
+    // Get a reference to the corresponding position list in unitposTuple tuple:
+    auto& unitpos = std::get<PositionList<UnitType>>(unitposTuple);
+
+    // Determine and assign the position of the unit in the position list:
+    columns.patchPos[pos] = unsigned(unitpos.size());
+
+    // Activate the unit:
+    columns.activate(pos, ts);
+
+    // Let unit store the id of the patch it is included in
+    columns.patchID[pos] = getID();
+
+    // Insert the position to the position list
+    unitpos.push_back(pos);
+    unitpos.markModified(unitpos.size()-1, unitpos.size());
+
+    // Update the tracked boundary:
+    updateBoundary<UnitType>(pos, true);
+}
+
+// Removes the position of a columnar unit from the patch, deactivates the unit and updates
+// patchPos of units placed after the unit removed from the patch.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::removeUnitPos(UnitColumns<UnitType> &columns, unsigned pos){
+
+    // Get a reference to the corresponding position list in unitposTuple tuple:
+    auto& unitpos = std::get<PositionList<UnitType>>(unitposTuple);
+
+    // Unit position inside the position list:
+    unsigned int patchPos = columns.getPatchPos(pos);
+
+    // Deactivate the unit:
+    columns.deactivate(pos);
+
+    // Erase the position from the position list:
+    unitpos.erase(unitpos.begin()+patchPos);
+
+    // Update the positions of units after the deleted position:
+    unsigned int newSize = (unsigned)(unitpos.size());
+    for (unsigned int i=patchPos; i<newSize; i++){
+        (columns.patchPos[unitpos[i]])--;
+    }
+    unitpos.markModified(patchPos, newSize);
+
+    // Update the tracked boundary:
+    updateBoundary<UnitType>(pos, false);
+}
+
+// Returns the positions of columnar units of a given type included in the patch
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+const std::vector<unsigned>& BasicPatch<allocPolicy,UnitTypes...>::getUnitPositions()const{
+    return std::get<PositionList<UnitType>>(unitposTuple);
+}
+
+
+// Marks a unit of the patch as a boundary unit (or removes the mark)
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::setBoundary(UnitType * unitptr, bool boundary){
+    unitptr->boundary = boundary;
+}
+
+// Marks a columnar unit of the patch as a boundary unit (or removes the mark)
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::setBoundary(UnitColumns<UnitType> &columns, unsigned pos, bool boundary){
+    columns.boundary[pos] = boundary;
+}
+
+
+// Calls f(unitptr) for each unit of a given type in the patch using the threads of an executor.
+// (For columnar unit types, calls f(pos) for each unit position in the patch.)
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType, class Function>
+void BasicPatch<allocPolicy,UnitTypes...>::parallelFor(Threading::Executor &executor, Function f, size_t chunkSize){
+
+    auto& refs = getUnitRefs<UnitType>(std::integral_constant<bool,isColumnar<UnitType>::value>());
+    executor.parallel_for(0, refs.size(), chunkSize, [&](size_t i){
+        f(refs[i]);
+    });
+}
+
+// Reduces map(unitptr) for each unit of a given type in the patch using the threads of an
+// executor. The result is deterministic for a given chunkSize. (See Executor::parallel_reduce())
+// (For columnar unit types, reduces map(pos) for each unit position in the patch.)
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType, class T, class MapFunction, class ReduceFunction>
+T BasicPatch<allocPolicy,UnitTypes...>::parallelReduce(Threading::Executor &executor, T init, MapFunction map,
+                                      ReduceFunction reduce, size_t chunkSize){
+
+    auto& refs = getUnitRefs<UnitType>(std::integral_constant<bool,isColumnar<UnitType>::value>());
+    return executor.parallel_reduce(size_t(0), refs.size(), chunkSize, init,
+                                    [&](size_t i){return map(refs[i]);}, reduce);
+}
+
+
+// Enables tracking the boundary units of a given type via the adjacency of the unit type to itself.
+// The boundary is constructed from the current units of the patch. (See Grid<>::trackBoundary())
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::setBoundaryTracking(Adjacency<UnitType,UnitType> const *adjacency,
+                                                               typename UnitStorage<UnitType,allocPolicy>::type *units){
+    auto& tracker = std::get<BoundaryTracker<UnitType>>(boundaryTuple);
+    tracker.adjacency = adjacency;
+    tracker.units = units;
+    rebuildBoundary<UnitType>();
+}
+
+// Reconstructs the tracked boundary from scratch, e.g., after the units of the grid are reordered.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::rebuildBoundary(){
+
+    auto& tracker = std::get<BoundaryTracker<UnitType>>(boundaryTuple);
+    tracker.refs.clear();
+    tracker.slots.clear();
+    if (not tracker.adjacency) return;
+
+    for (auto ref : getUnitRefs<UnitType>(std::integral_constant<bool,isColumnar<UnitType>::value>())){
+        refreshBoundary<UnitType>(refPos(ref));
+    }
+}
+
+// Updates the boundary after the unit at a given position is inserted to or removed from the patch.
+// The inserted unit and its neighbors within the patch are the only units whose status may change.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::updateBoundary(unsigned pos, bool inserted){
+
+    auto& tracker = std::get<BoundaryTracker<UnitType>>(boundaryTuple);
+    if (not tracker.adjacency) return;
+
+    if (inserted){
+        refreshBoundary<UnitType>(pos);
+    }
+    else{
+        dropFromBoundary<UnitType>(pos);
+    }
+
+    std::integral_constant<bool,isColumnar<UnitType>::value> columnar;
+    for (auto neighbor : tracker.adjacency->neighbors(pos)){
+        if (contains(tracker, neighbor, columnar)){
+            refreshBoundary<UnitType>(neighbor);
+        }
+    }
+}
+
+// Determines whether the unit at a given position (included in the patch) is a boundary unit.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::refreshBoundary(unsigned pos){
+
+    auto& tracker = std::get<BoundaryTracker<UnitType>>(boundaryTuple);
+    std::integral_constant<bool,isColumnar<UnitType>::value> columnar;
+
+    for (auto neighbor : tracker.adjacency->neighbors(pos)){
+        if (not contains(tracker, neighbor, columnar)){
+            addToBoundary<UnitType>(pos);
+            return;
+        }
+    }
+    dropFromBoundary<UnitType>(pos);
+}
+
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::addToBoundary(unsigned pos){
+
+    auto& tracker = std::get<BoundaryTracker<UnitType>>(boundaryTuple);
+    std::integral_constant<bool,isColumnar<UnitType>::value> columnar;
+
+    if (pos >= tracker.slots.size()){
+        tracker.slots.resize(pos+1, UINT_MAX);
+    }
+    if (tracker.slots[pos] == UINT_MAX){
+        tracker.slots[pos] = unsigned(tracker.refs.size());
+        tracker.refs.push_back(pos);
+    }
+    setBoundaryFlag(tracker, pos, true, columnar);
+}
+
+// Removes a unit from the boundary in constant time by moving the last reference to its place.
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::dropFromBoundary(unsigned pos){
+
+    auto& tracker = std::get<BoundaryTracker<UnitType>>(boundaryTuple);
+    std::integral_constant<bool,isColumnar<UnitType>::value> columnar;
+
+    if (pos < tracker.slots.size() and tracker.slots[pos] != UINT_MAX){
+        unsigned slot = tracker.slots[pos];
+        auto last = tracker.refs.back();
+        tracker.refs[slot] = last;
+        tracker.slots[last] = slot;
+        tracker.refs.pop_back();
+        tracker.slots[pos] = UINT_MAX;
+    }
+    setBoundaryFlag(tracker, pos, false, columnar);
+}
+
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+bool BasicPatch<allocPolicy,UnitTypes...>::contains(BoundaryTracker<UnitType> const &tracker, unsigned pos,
+                                                    std::false_type)const{
+    auto& unit = (*tracker.units)[pos];
+    return unit.isActive() and unit.getPatchID()==getID();
+}
+
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+bool BasicPatch<allocPolicy,UnitTypes...>::contains(BoundaryTracker<UnitType> const &tracker, unsigned pos,
+                                                    std::true_type)const{
+    return tracker.units->isActive(pos) and tracker.units->getPatchID(pos)==getID();
+}
+
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::setBoundaryFlag(BoundaryTracker<UnitType> &tracker, unsigned pos,
+                                                           bool boundary, std::false_type){
+    setBoundary(&(*tracker.units)[pos], boundary);
+}
+
+template <class allocPolicy, class ...UnitTypes>
+template <class UnitType>
+void BasicPatch<allocPolicy,UnitTypes...>::setBoundaryFlag(BoundaryTracker<UnitType> &tracker, unsigned pos,
+                                                           bool boundary, std::true_type){
+    setBoundary(*tracker.units, pos, boundary);
 }
 
 
 // This function is called by the associated grid object whenever an operation that may invalidate
 // the pointers of the elements of tuple "unitsTuple" is performed.
-template <class ...UnitTypes>
-void Patch<UnitTypes...>::invalidate(){
+template <class allocPolicy, class ...UnitTypes>
+void BasicPatch<allocPolicy,UnitTypes...>::invalidate(){
     upToDate = false;
     locked = true;
 }
 
+// The patch with the default allocation policy:
+template <class ...UnitTypes>
+using Patch = BasicPatch<StandardAllocation, UnitTypes...>;
+
 } // end of namespace OpenHDM
 
 
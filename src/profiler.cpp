@@ -0,0 +1,250 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include "profiler.h"
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the profiling
+// classes "Histogram" and "DomainProfile", and the export routines
+// defined in profiler.h
+// --------------------------------------------------------------------
+
+// Returns the (approximate) p-th percentile (0<=p<=1), i.e., the upper bound of the bin
+// in which the percentile falls.
+uint64_t Profiling::Histogram::percentile(double p) const{
+
+    if (n==0) return 0;
+
+    uint64_t target = std::max(uint64_t(1), uint64_t(p*n+0.5));
+    uint64_t cumulative = 0;
+    for (unsigned i=0; i<nBins; i++){
+        cumulative += bins[i];
+        if (cumulative>=target){
+            uint64_t upper = (i<nBins-1) ? (uint64_t(2)<<i)-1 : UINT64_MAX;
+            return std::min(upper, maxVal);
+        }
+    }
+    return maxVal;
+}
+
+
+Profiling::DomainProfile::DomainProfile(std::string domainID_, unsigned nPhases,
+                                        clock::time_point epoch_, bool trace_):
+    domainID(domainID_),
+    epoch(epoch_),
+    trace(trace_),
+    compute(nPhases),
+    sync(nPhases),
+    pool(nPhases)
+{
+
+}
+
+
+namespace {
+
+// Opens a file to export profiling results.
+void openProfileFile(std::ofstream &ofs, std::string fileName){
+    ofs.open(fileName);
+    if (not ofs.is_open()){
+        Report::error("Profiling!","Couldn't open the file "+fileName);
+    }
+}
+
+// Escapes a string to be written as a JSON string value, e.g., a domain ID.
+std::string escapeJSON(std::string const &str){
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (char c : str){
+        switch (c){
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20){
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+                    escaped += buf;
+                }
+                else{
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+// Quotes a string to be written as a CSV field (RFC 4180) if it contains a comma, a double quote
+// or a line break, e.g., a domain ID.
+std::string escapeCSV(std::string const &str){
+    if (str.find_first_of(",\"\r\n")==std::string::npos) return str;
+    std::string escaped = "\"";
+    for (char c : str){
+        if (c=='"') escaped += '"';
+        escaped += c;
+    }
+    return escaped+"\"";
+}
+
+// Returns the bins of a histogram, up to the last non-empty bin, as a JSON array.
+std::string binsToJSON(Profiling::Histogram const &h){
+    unsigned last = 0;
+    for (unsigned i=0; i<Profiling::Histogram::nBins; i++){
+        if (h.bin(i)) last = i+1;
+    }
+    std::ostringstream ss;
+    ss << "[";
+    for (unsigned i=0; i<last; i++){
+        ss << (i ? "," : "") << h.bin(i);
+    }
+    ss << "]";
+    return ss.str();
+}
+
+// Returns the statistics of a histogram as a JSON object.
+std::string histogramToJSON(Profiling::Histogram const &h){
+    std::ostringstream ss;
+    ss << "{\"count\":" << h.count()
+       << ",\"sum_ns\":" << h.sum()
+       << ",\"min_ns\":" << h.min()
+       << ",\"max_ns\":" << h.max()
+       << ",\"mean_ns\":" << std::fixed << std::setprecision(1) << h.mean()
+       << ",\"p50_ns\":" << h.percentile(0.5)
+       << ",\"p99_ns\":" << h.percentile(0.99)
+       << ",\"log2_bins\":" << binsToJSON(h) << "}";
+    return ss.str();
+}
+
+} // end of anonymous namespace
+
+
+// Writes the per-domain, per-phase statistics in CSV format. Each row corresponds to a
+// (domain, phase, category) triplet, where category is one of compute, sync, and pool.
+void Profiling::writeCSV(std::string fileName, ProfileList const &profiles){
+
+    std::ofstream ofs;
+    openProfileFile(ofs, fileName);
+
+    // (The floating-point columns, i.e., the means, are written with one decimal in all rows)
+    ofs << std::fixed << std::setprecision(1);
+
+    ofs << "domain,phase,category,count,sum_ns,min_ns,max_ns,mean_ns,p50_ns,p99_ns\n";
+    for (auto &profile : profiles){
+        for (unsigned phase=0; phase<profile->get_nPhases(); phase++){
+            const Histogram* hists[3] = {&profile->getCompute(phase),
+                                         &profile->getSync(phase),
+                                         &profile->getPool(phase)};
+            const char* names[3] = {"compute","sync","pool"};
+            for (unsigned c=0; c<3; c++){
+                const Histogram &h = *hists[c];
+                ofs << escapeCSV(profile->getDomainID()) << "," << phase << "," << names[c] << ","
+                    << h.count() << "," << h.sum() << "," << h.min() << "," << h.max() << ","
+                    << h.mean() << ","
+                    << h.percentile(0.5) << "," << h.percentile(0.99) << "\n";
+            }
+        }
+    }
+}
+
+
+// Writes the per-domain, per-phase statistics, including the histogram bins, in JSON format.
+void Profiling::writeJSON(std::string fileName, ProfileList const &profiles){
+
+    std::ofstream ofs;
+    openProfileFile(ofs, fileName);
+
+    ofs << "{\"domains\":[";
+    for (size_t d=0; d<profiles.size(); d++){
+        auto &profile = profiles[d];
+        ofs << (d ? "," : "") << "\n {\"id\":\"" << escapeJSON(profile->getDomainID()) << "\",\"phases\":[";
+        for (unsigned phase=0; phase<profile->get_nPhases(); phase++){
+            ofs << (phase ? "," : "") << "\n  {\"phase\":" << phase
+                << ",\"compute\":" << histogramToJSON(profile->getCompute(phase))
+                << ",\"sync\":"    << histogramToJSON(profile->getSync(phase))
+                << ",\"pool\":"    << histogramToJSON(profile->getPool(phase)) << "}";
+        }
+        ofs << "]}";
+    }
+    ofs << "\n]}\n";
+}
+
+
+// Writes the recorded phase executions in Chrome trace event format, which can be viewed with
+// chrome://tracing or Perfetto. Each domain is displayed as a separate thread.
+void Profiling::writeTrace(std::string fileName, ProfileList const &profiles){
+
+    std::ofstream ofs;
+    openProfileFile(ofs, fileName);
+    ofs << std::fixed << std::setprecision(3);
+
+    bool first = true;
+    auto event = [&](std::string name, const char* cat, size_t tid, uint64_t start,
+                     uint64_t dur, TraceEvent const &e){
+        if (dur==0) return;
+        ofs << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"" << cat
+            << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << tid
+            << ",\"ts\":" << start*1e-3 << ",\"dur\":" << dur*1e-3
+            << ",\"args\":{\"timestep\":" << e.ts << ",\"phase\":" << e.phase << "}}";
+        first = false;
+    };
+
+    ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    for (size_t d=0; d<profiles.size(); d++){
+        auto &profile = profiles[d];
+        ofs << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+            << d << ",\"args\":{\"name\":\"" << escapeJSON(profile->getDomainID()) << "\"}}";
+        first = false;
+        for (auto &e : profile->getEvents()){
+            std::string phase = "phase "+std::to_string(e.phase);
+            event(phase+" sync", "sync", d, e.start, e.sync, e);
+            event(phase+" pool", "pool", d, e.start+e.sync, e.pool, e);
+            event(phase, "compute", d, e.start+e.sync+e.pool, e.compute, e);
+        }
+    }
+    ofs << "\n]}\n";
+}
+
+
+// Logs the total compute, sync and pool wait times of each domain.
+void Profiling::logSummary(ProfileList const &profiles){
+
+    if (not Report::logs(2)) return;
+    for (auto &profile : profiles){
+        uint64_t computeNs = 0, syncNs = 0, poolNs = 0;
+        for (unsigned phase=0; phase<profile->get_nPhases(); phase++){
+            computeNs   += profile->getCompute(phase).sum();
+            syncNs      += profile->getSync(phase).sum();
+            poolNs      += profile->getPool(phase).sum();
+        }
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3) << "Domain " << profile->getDomainID()
+           << ": compute " << computeNs*1e-9 << "s, sync " << syncNs*1e-9
+           << "s, pool " << poolNs*1e-9 << "s";
+        OPENHDM_LOG(ss.str(),2);
+    }
+}
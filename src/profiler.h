@@ -0,0 +1,157 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include "report.h"
+
+namespace OpenHDM {
+namespace Profiling {
+
+using clock = std::chrono::steady_clock;
+
+// --------------------------------------------------------------------
+// Histogram: A logarithmic (base 2) histogram of durations in
+//   nanoseconds. Bin i counts the durations in [2^i, 2^(i+1)), while
+//   bin 0 includes zero durations as well. Adding a sample is a few
+//   integer operations, so histograms can be updated at every phase.
+// --------------------------------------------------------------------
+
+class Histogram{
+public:
+
+    static constexpr unsigned nBins = 64;
+
+    void add(uint64_t ns);
+
+    uint64_t count()            const{return n;}
+    uint64_t sum()              const{return total;}
+    uint64_t min()              const{return n ? minVal : 0;}
+    uint64_t max()              const{return maxVal;}
+    double   mean()             const{return n ? double(total)/n : 0.;}
+    uint64_t bin(unsigned i)    const{return bins[i];}
+    uint64_t percentile(double p) const;
+
+private:
+    uint64_t bins[nBins] = {0};
+    uint64_t n          = 0;
+    uint64_t total      = 0;
+    uint64_t minVal     = UINT64_MAX;
+    uint64_t maxVal     = 0;
+};
+
+// Adds a duration to the histogram.
+inline void Histogram::add(uint64_t ns){
+    bins[ns ? 63-__builtin_clzll(ns) : 0]++;
+    n++;
+    total += ns;
+    if (ns<minVal) minVal = ns;
+    if (ns>maxVal) maxVal = ns;
+}
+
+
+// --------------------------------------------------------------------
+// TraceEvent: The durations of a single phase execution of a domain.
+//   All times are in nanoseconds, and the start time is relative to the
+//   epoch of the profile (the beginning of the run).
+// --------------------------------------------------------------------
+
+struct TraceEvent{
+    unsigned ts;
+    unsigned phase;
+    uint64_t start;
+    uint64_t sync;      // waiting for the parent or child domains in the phase check
+    uint64_t pool;      // waiting for a processor from the thread pool
+    uint64_t compute;   // executing the phase function
+};
+
+
+// --------------------------------------------------------------------
+// DomainProfile: Per-phase compute, synchronization and pool wait time
+//   histograms of a domain. A profile is only written to by the
+//   timestepping thread of its domain, so recording requires no
+//   synchronization. If tracing is enabled, each phase execution is
+//   additionally recorded as a TraceEvent.
+// --------------------------------------------------------------------
+
+class DomainProfile{
+public:
+
+    DomainProfile(std::string domainID_, unsigned nPhases, clock::time_point epoch_, bool trace_=false);
+
+    // Records a phase execution: t0: begin phase check, t1: synchronized,
+    // t2: processor acquired, t3: phase function returned.
+    void record(unsigned ts, unsigned phase,
+                clock::time_point t0, clock::time_point t1,
+                clock::time_point t2, clock::time_point t3);
+
+    std::string                     getDomainID()   const{return domainID;}
+    unsigned                        get_nPhases()   const{return compute.size();}
+    const Histogram&                getCompute(unsigned phase)  const{return compute[phase];}
+    const Histogram&                getSync(unsigned phase)     const{return sync[phase];}
+    const Histogram&                getPool(unsigned phase)     const{return pool[phase];}
+    const std::vector<TraceEvent>&  getEvents()     const{return events;}
+
+private:
+    static uint64_t ns(clock::duration d){
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+    }
+
+    std::string domainID;
+    clock::time_point epoch;
+    bool trace;
+    std::vector<Histogram> compute, sync, pool;
+    std::vector<TraceEvent> events;
+};
+
+inline void DomainProfile::record(unsigned ts, unsigned phase,
+                                  clock::time_point t0, clock::time_point t1,
+                                  clock::time_point t2, clock::time_point t3){
+    uint64_t syncNs     = ns(t1-t0);
+    uint64_t poolNs     = ns(t2-t1);
+    uint64_t computeNs  = ns(t3-t2);
+
+    sync[phase].add(syncNs);
+    pool[phase].add(poolNs);
+    compute[phase].add(computeNs);
+
+    if (trace){
+        events.push_back(TraceEvent{ts, phase, ns(t0-epoch), syncNs, poolNs, computeNs});
+    }
+}
+
+
+// Export routines (see profiler.cpp):
+using ProfileList = std::vector<std::shared_ptr<const DomainProfile>>;
+
+void writeCSV(std::string fileName, ProfileList const &profiles);
+void writeJSON(std::string fileName, ProfileList const &profiles);
+void writeTrace(std::string fileName, ProfileList const &profiles);
+void logSummary(ProfileList const &profiles);
+
+} // end of namespace Profiling
+} // end of namespace OpenHDM
+
+#endif // PROFILER_H
@@ -27,7 +27,15 @@
 #include <algorithm>
 #include <memory>
 #include <sstream>
+#include <thread>
+#include <future>
+#include <array>
+#include <chrono>
 #include "projectinput.h"
+#include "threading.h"
+#include "profiler.h"
+#include "checkpoint.h"
+#include "distributed.h"
 #include "report.h"
 
 namespace OpenHDM {
@@ -56,11 +64,23 @@ public:
     ~Project(){}
 
     void run(unsigned nProcTotal=0, unsigned nProcChild=0);
+    void setRebalancing(unsigned interval, double threshold=0.1);
+    void setProfiling(std::string filePrefix="", bool trace=false);
+    void setParallelInitialization(bool parallel=true);
+    void setCheckpointing(std::string dir, unsigned interval);
+    void setRestart(std::string dir, unsigned ts=0);
+    void setDistribution(std::shared_ptr<Distributed::Communicator> comm_,
+                         std::map<std::string,int> ranks={});
+    void setAffinity(Affinity::Policy policy,
+                     std::map<std::string,std::vector<unsigned>> cpus={});
 
 private:
 
     // Runtime:
     void initializeRun(unsigned nProcTotal, unsigned nProcChild);
+    void setupDomains();
+    void setupDomainsConcurrently();
+    void reportSetupTimes(std::vector<std::array<double,3>> const &setupTimes);
     void processTimesteppingParams();
     void initiateTimestepping();
     void finalizeRun();
@@ -75,8 +95,40 @@ private:
     // Inter-Domain Concurrency:
     void setDomainConcurrency(unsigned nProcTotal, unsigned nProcChild);
     void check_nProc(unsigned &nProcTotal, unsigned &nProcChild);
-    void check_multipleParents();
+    unsigned get_nParents();
+    std::shared_ptr<Threading::Pool> threadPool; // shared by the hierarchies if multiple parents
     std::vector<std::thread> threads;
+    unsigned rebalanceInterval = 0;
+    double rebalanceThreshold = 0.1;
+
+    // Parallel initialization of the domains:
+    bool parallelInitialization = false;
+
+    // Checkpoint/restart:
+    std::string checkpointDir = "";
+    unsigned checkpointInterval = 0;
+    std::shared_ptr<CheckpointWriter> checkpointWriter;
+    bool restart = false;
+    std::string restartDir = "";
+    unsigned restartTimestep = 0;
+    void configureCheckpoints();
+
+    // Distributed execution:
+    std::shared_ptr<Distributed::Communicator> comm;
+    std::map<std::string,int> rankTable;
+    std::vector<std::shared_ptr<domainClass>> remoteDomains;   // timestepped on other ranks
+    void distributeDomains();
+
+    // Pinning of the domain threads:
+    Affinity::Policy affinityPolicy = Affinity::Policy::None;
+    std::map<std::string,std::vector<unsigned>> affinityTable;
+    void placeDomains();
+
+    // Profiling:
+    bool profiling = false;
+    bool profilingTrace = false;
+    std::string profilingPrefix = "";
+    void exportProfiles();
 
     // get functions:
     size_t      nd() const;
@@ -102,11 +154,11 @@ Project<domainClass>::Project(ProjectInput &projectInput):
     projectID(projectInput.projectID)
 {
 
-    Report::log("Project "+projectID+" is initializing",0);
+    OPENHDM_LOG("Project "+projectID+" is initializing",0);
 
     // Construct the domains that are predefined in the project input file:
     if (projectInput.nd > 0){
-        Report::log("Constructing domains listed in "+projectInput.getFileTitle()+":",1);
+        OPENHDM_LOG("Constructing domains listed in "+projectInput.getFileTitle()+":",1);
         processDomainsList(projectInput);
     }
 
@@ -118,19 +170,94 @@ template <class domainClass>
 void Project<domainClass>::run(unsigned nProcTotal, unsigned nProcChild){
 
     // 1. Initialize:
-    Report::log("Run is initializing:",1);
+    OPENHDM_LOG("Run is initializing:",1);
     initializeRun(nProcTotal, nProcChild);
 
     // 2. Timestepping:
     initiateTimestepping();
 
     // 3. Finalize:
-    Report::log("\n Run is finalizing:",1);
+    OPENHDM_LOG("\n Run is finalizing:",1);
     finalizeRun();
 
 }
 
 
+// Enables adaptive rebalancing of processors between the parent domain and its children during
+// timestepping. (See Domain<>::setRebalancing()) Must be called before run().
+template <class domainClass>
+void Project<domainClass>::setRebalancing(unsigned interval, double threshold){
+    rebalanceInterval = interval;
+    rebalanceThreshold = threshold;
+}
+
+
+// Enables profiling of the phase executions of all domains. At the end of the run, the per-domain,
+// per-phase compute, sync and pool wait time statistics are written to <filePrefix>.csv and
+// <filePrefix>.json, and if trace is true, the individual phase executions are written to
+// <filePrefix>_trace.json in Chrome trace format. The default prefix is <projectID>_profile.
+// Must be called before run().
+template <class domainClass>
+void Project<domainClass>::setProfiling(std::string filePrefix, bool trace){
+    profiling = true;
+    profilingTrace = trace;
+    profilingPrefix = filePrefix;
+}
+
+
+// Enables concurrent initialization of the domains. (See setupDomainsConcurrently())
+// Must be called before run().
+template <class domainClass>
+void Project<domainClass>::setParallelInitialization(bool parallel){
+    parallelInitialization = parallel;
+}
+
+
+// Enables writing checkpoints of all domains to a given directory at every interval timesteps.
+// Must be called before run().
+template <class domainClass>
+void Project<domainClass>::setCheckpointing(std::string dir, unsigned interval){
+    checkpointDir = dir;
+    checkpointInterval = interval;
+}
+
+
+// Restarts the run from the checkpoints of timestep ts in a given directory. If ts is zero, the
+// latest timestep for which the checkpoints of all domains exist is used. Must be called before
+// run().
+template <class domainClass>
+void Project<domainClass>::setRestart(std::string dir, unsigned ts){
+    restart = true;
+    restartDir = dir;
+    restartTimestep = ts;
+}
+
+
+// Enables the distributed execution of the project, where the domains are timestepped on the
+// ranks of a given communicator, e.g., the children of a parent domain on multiple nodes. Each
+// rank constructs the same project, and the domains are assigned to the ranks as given in the
+// ranks table (domainID -> rank). The domains missing from the table are assigned by default.
+// (See distributeDomains()) Must be called before run().
+template <class domainClass>
+void Project<domainClass>::setDistribution(std::shared_ptr<Distributed::Communicator> comm_,
+                                           std::map<std::string,int> ranks){
+    comm = comm_;
+    rankTable = ranks;
+}
+
+
+// Pins the threads of the domains to core sets as determined by a placement policy (see
+// affinity.h and placeDomains()), or as given in the cpus table (domainID -> CPU list), which
+// overrides the policy. The data of the domains are first-touched on their core sets, since the
+// setup stages of each domain are executed on its core set as well. Must be called before run().
+template <class domainClass>
+void Project<domainClass>::setAffinity(Affinity::Policy policy, std::map<std::string,std::vector<unsigned>> cpus){
+    affinityPolicy = policy;
+    affinityTable = cpus;
+    Affinity::Topology::get();  // detect the topology before any of the threads are pinned
+}
+
+
 // Prepares the domains of the project for timestepping procedure. The initialization
 // includes configuring domain hierarchy and concurrency, instantiating grids, solvers,
 // outputs, reading inputs, etc. This function is called in Project<>::run()
@@ -140,44 +267,235 @@ void Project<domainClass>::initializeRun(unsigned nProcTotal, unsigned nProcChil
     // Construct the domain hierarchy:
     setDomainHierarchy();
 
+    // Assign the domains to the ranks (if distributed):
+    if (comm){
+        distributeDomains();
+    }
+
     // Configure multithreaded domain concurrency:
     setDomainConcurrency(nProcTotal,nProcChild);
 
+    // Pin the domain threads to core sets:
+    placeDomains();
+
+    // Instantiate members, read inputs and complete the initializations of the domains:
+    if (parallelInitialization){
+        setupDomainsConcurrently();
+    }
+    else{
+        setupDomains();
+    }
+
+    // For each domain, obtain and compare timestepping params; nts and nPhases.
+    processTimesteppingParams();
+
+    // Configure checkpointing and restore the domains from checkpoints (if restarting):
+    configureCheckpoints();
+
+    // Enable profiling:
+    if (profiling){
+        auto epoch = Profiling::clock::now();
+        for (auto &domain : domains){
+            if (domain->isLocal()){
+                domain->setProfiling(epoch, profilingTrace);
+            }
+        }
+    }
+
+}
+
+
+// Assigns the checkpoint writer to the domains, and restores the domain states if restarting.
+template <class domainClass>
+void Project<domainClass>::configureCheckpoints(){
+
+    if (checkpointInterval>0){
+        checkpointWriter = std::make_shared<CheckpointWriter>(checkpointDir);
+        for (auto &domain : domains){
+            if (domain->isLocal()){
+                domain->setCheckpointing(checkpointInterval, checkpointWriter);
+            }
+        }
+    }
+
+    if (restart){
+        unsigned ts = restartTimestep;
+        if (ts==0){
+            std::vector<std::string> domainIDs;
+            for (auto &domain : domains){
+                if (domain->isLocal()){
+                    domainIDs.push_back(domain->getID());
+                }
+            }
+            ts = CheckpointWriter::findLatest(restartDir, domainIDs);
+
+            // The latest timestep for which the checkpoints exist on all ranks:
+            if (comm){
+                ts = unsigned(comm->reduceMin(ts));
+            }
+            if (ts==0){
+                Report::error("Restart!","No complete set of checkpoints is found in "+restartDir);
+            }
+        }
+
+        OPENHDM_LOG("Restarting from the checkpoints of timestep "+std::to_string(ts),2);
+        for (auto &domain : domains){
+            if (domain->isLocal()){
+                domain->readCheckpoint(restartDir+"/"+CheckpointWriter::fileName(domain->getID(), ts));
+            }
+        }
+    }
+}
+
+
+// Sequentially sets up the domains, i.e., instantiates members, reads inputs and completes
+// the initializations of all domains, stage by stage.
+template <class domainClass>
+void Project<domainClass>::setupDomains(){
+
+    using clock = std::chrono::steady_clock;
+    std::vector<std::array<double,3>> setupTimes(domains.size());
+
     // Lazy initialization of members such as solvers, grids, outputs, etc.
-    Report::log("Setting up the simulation",2);
-    for (auto &domain : domains){
-        domain->instantiateMembers();
+    OPENHDM_LOG("Setting up the simulation",2);
+    for (size_t i=0; i<domains.size(); i++){
+        Affinity::ScopedPinning pinning(domains[i]->getAffinity().cpus);
+        auto t0 = clock::now();
+        domains[i]->instantiateMembers();
+        setupTimes[i][0] = std::chrono::duration<double>(clock::now()-t0).count();
     }
 
     // Read inputs
-    Report::log("Reading domain inputs",2);
-    for (auto &domain : domains){
-        domain->readInputs();
+    OPENHDM_LOG("Reading domain inputs",2);
+    for (size_t i=0; i<domains.size(); i++){
+        Affinity::ScopedPinning pinning(domains[i]->getAffinity().cpus);
+        auto t0 = clock::now();
+        domains[i]->readInputs();
+        setupTimes[i][1] = std::chrono::duration<double>(clock::now()-t0).count();
     }
 
     // Complete the domain initializations before timestepping begins;
-    Report::log("Completing domain initializations",2);
-    for (auto &domain : domains){
-        domain->initialize();
+    OPENHDM_LOG("Completing domain initializations",2);
+    for (size_t i=0; i<domains.size(); i++){
+        Affinity::ScopedPinning pinning(domains[i]->getAffinity().cpus);
+        auto t0 = clock::now();
+        domains[i]->initialize();
+        setupTimes[i][2] = std::chrono::duration<double>(clock::now()-t0).count();
     }
 
-    // For each domain, obtain and compare timestepping params; nts and nPhases.
-    processTimesteppingParams();
+    reportSetupTimes(setupTimes);
+}
+
 
+// Concurrently sets up the domains. A thread is instantiated for each domain to execute the
+// setup stages (instantiateMembers, readInputs, initialize) of the domain in order. A child domain
+// begins a stage only after its parent has completed that stage, so that the child may access
+// the parent members (e.g., via Grid<>::copyFromParent()). Conversely, a parent begins a stage
+// only after its children have completed the preceding stage, so that the parent doesn't modify
+// its units (e.g., in initialize()) while a child is still reading them. A child thus observes
+// the same parent state as in setupDomains(), while independent domains, e.g., the siblings,
+// are set up concurrently.
+template <class domainClass>
+void Project<domainClass>::setupDomainsConcurrently(){
+
+    using clock = std::chrono::steady_clock;
+    const unsigned nStages = 3;
+
+    OPENHDM_LOG("Setting up the domains concurrently",2);
+
+    std::vector<std::array<double,3>> setupTimes(domains.size());
+    std::vector<std::array<std::promise<void>,nStages>> stageCompleted(domains.size());
+    std::vector<std::array<std::shared_future<void>,nStages>> stageFutures(domains.size());
+    for (size_t i=0; i<domains.size(); i++){
+        for (unsigned stage=0; stage<nStages; stage++){
+            stageFutures[i][stage] = stageCompleted[i][stage].get_future().share();
+        }
+    }
+
+    // Positions of the parent (if any) and the children of each domain:
+    std::vector<size_t> parentPositions(domains.size(), domains.size());
+    std::vector<std::vector<size_t>> childPositions(domains.size());
+    for (size_t i=0; i<domains.size(); i++){
+        if (domains[i]->isChild()){
+            parentPositions[i] = getDomainPosition(domains[i]->getParent()->getID());
+            childPositions[parentPositions[i]].push_back(i);
+        }
+    }
+
+    std::vector<std::thread> setupThreads;
+    for (size_t i=0; i<domains.size(); i++){
+
+        setupThreads.emplace_back( [&, i](){
+            auto &domain = domains[i];
+            size_t parentPos = parentPositions[i];
+            Affinity::ScopedPinning pinning(domain->getAffinity().cpus);
+            for (unsigned stage=0; stage<nStages; stage++){
+
+                // Wait for the parent to complete the stage:
+                if (parentPos<domains.size()){
+                    stageFutures[parentPos][stage].wait();
+                }
+
+                // Wait for the children to complete the preceding stage:
+                if (stage>0){
+                    for (size_t childPos : childPositions[i]){
+                        stageFutures[childPos][stage-1].wait();
+                    }
+                }
+
+                auto t0 = clock::now();
+                switch (stage){
+                    case 0: domain->instantiateMembers();   break;
+                    case 1: domain->readInputs();           break;
+                    case 2: domain->initialize();           break;
+                }
+                setupTimes[i][stage] = std::chrono::duration<double>(clock::now()-t0).count();
+
+                stageCompleted[i][stage].set_value();
+            }
+        });
+    }
+
+    for (auto &thread: setupThreads){
+        thread.join();
+    }
+
+    reportSetupTimes(setupTimes);
+}
+
+
+// Reports the durations of the setup stages of each domain.
+template <class domainClass>
+void Project<domainClass>::reportSetupTimes(std::vector<std::array<double,3>> const &setupTimes){
+
+    if (not Report::logs(3)) return;
+    for (size_t i=0; i<domains.size(); i++){
+        std::ostringstream ss;
+        ss.precision(3);
+        ss << std::fixed << "Domain " << domains[i]->getID() << " setup times: members "
+           << setupTimes[i][0] << "s, inputs " << setupTimes[i][1] << "s, initialize "
+           << setupTimes[i][2] << "s";
+        OPENHDM_LOG(ss.str(),3);
+    }
 }
 
 
 // Instantiates a timestepping thread for each domain. The concurrent execution of these
 // threads depend on available processors and relative progression of parent/children.
-// (See phasing mechanism.)
+// (See phasing mechanism.) The messages of the domains are written asynchronously during
+// timestepping, so that the domain threads do not block on the output streams.
 template <class domainClass>
 void Project<domainClass>::initiateTimestepping(){
 
-    // Instantiate and execute timestepping thread for each domain:
+    bool async = Report::isAsync();
+    Report::setAsync(true);
+
+    // Instantiate and execute timestepping thread for each domain (except for the shadows):
     for (auto &domain: domains){
+        if (not domain->isLocal()) continue;
 
         threads.emplace_back( [&](){
-            domain->timestepping(nts);
+            domain->timestepping(domain->get_nts());
         });
     }
 
@@ -186,6 +504,10 @@ void Project<domainClass>::initiateTimestepping(){
             thread.join();
     }
 
+    if (not async){
+        Report::setAsync(false);
+    }
+
 }
 
 
@@ -193,14 +515,52 @@ void Project<domainClass>::initiateTimestepping(){
 template <class domainClass>
 void Project<domainClass>::finalizeRun(){
 
+    // Complete writing the checkpoints:
+    if (checkpointWriter){
+        checkpointWriter->flush();
+    }
+
     // Post-processing"
-    Report::log("Post-processing domains...",2);
+    OPENHDM_LOG("Post-processing domains...",2);
+
+    for (auto &domain : domains){
+        if (domain->isLocal()){
+            domain->postProcess();
+        }
+    }
+
+    // Export profiling results:
+    if (profiling){
+        exportProfiles();
+    }
+
+    OPENHDM_LOG("Run has finished.",2);
+}
+
+
+// Writes the profiles of the domains collected during timestepping.
+template <class domainClass>
+void Project<domainClass>::exportProfiles(){
+
+    std::string prefix = profilingPrefix.empty() ? projectID+"_profile" : profilingPrefix;
+    if (comm and comm->size()>1){
+        prefix += "_rank"+std::to_string(comm->rank());
+    }
 
+    Profiling::ProfileList profiles;
     for (auto &domain : domains){
-        domain->postProcess();
+        if (domain->isLocal()){
+            profiles.push_back(domain->getProfile());
+        }
     }
 
-    Report::log("Run has finished.",2);
+    OPENHDM_LOG("Exporting profiles to "+prefix+".csv and "+prefix+".json",2);
+    Profiling::logSummary(profiles);
+    Profiling::writeCSV(prefix+".csv", profiles);
+    Profiling::writeJSON(prefix+".json", profiles);
+    if (profilingTrace){
+        Profiling::writeTrace(prefix+"_trace.json", profiles);
+    }
 }
 
 
@@ -241,7 +601,7 @@ void Project<domainClass>::removeDomain(const std::string domainID){
 template <class domainClass>
 void Project<domainClass>::setDomainHierarchy(){
 
-    Report::log("Constructing domain hierarchy",2);
+    OPENHDM_LOG("Constructing domain hierarchy",2);
 
     for (auto &domain : domains){
         std::string domainID = domain->getID();
@@ -265,6 +625,182 @@ void Project<domainClass>::setDomainHierarchy(){
 }
 
 
+// Assigns the domains to the ranks of the communicator. By default, the parent domains are
+// assigned to rank 0, and the child domains are distributed among the other ranks in round-robin
+// order. The domains timestepped on other ranks are then removed from the domains list, except
+// for the parents of the local children, which are kept as shadows: a shadow is set up as the
+// parent itself, e.g., so that the children may copy their units from the parent grid, but it is
+// not timestepped, post-processed or checkpointed. Instead, the values of its boundary fields are
+// received from the parent. (See Domain::addBoundaryField()) Hence, the domains should not write
+// outputs during their setup.
+template <class domainClass>
+void Project<domainClass>::distributeDomains(){
+
+    int nRanks = comm->size();
+    int nextRank = 0;
+
+    for (auto &entry : rankTable){
+        if (not getDomain(entry.first)){
+            Report::warning("Distribution!","Domain "+entry.first+" in the ranks table is not found.");
+        }
+    }
+
+    for (size_t i=0; i<domains.size(); i++){
+        auto &domain = domains[i];
+
+        int rank = 0;
+        auto rankIt = rankTable.find(domain->getID());
+        if (rankIt!=rankTable.end()){
+            rank = rankIt->second;
+        }
+        else if (domain->isChild() and nRanks>1){
+            rank = 1 + (nextRank++)%(nRanks-1);
+        }
+
+        if (rank<0 or rank>=nRanks){
+            Report::error("Distribution!","Rank "+std::to_string(rank)+" of domain "+domain->getID()+
+                          " is invalid. Number of ranks: "+std::to_string(nRanks));
+        }
+
+        domain->setPlacement(comm, rank, int(i));
+        OPENHDM_LOG("Domain "+domain->getID()+" is assigned to rank "+std::to_string(rank),3);
+    }
+
+    // Keep the local domains and the shadows of their parents:
+    std::vector<std::shared_ptr<domainClass>> keptDomains;
+    unsigned nShadows = 0;
+    for (auto &domain : domains){
+        bool keep = domain->isLocal();
+        if (not keep and domain->isParent()){
+            for (auto &childWP: domain->childDomains){
+                auto child = childWP.lock();
+                keep = keep or (child and child->isLocal());
+            }
+            nShadows += keep;
+        }
+
+        if (keep){
+            keptDomains.push_back(domain);
+        }
+        else{
+            remoteDomains.push_back(domain);
+        }
+    }
+    domains.swap(keptDomains);
+
+    if (domains.empty()){
+        Report::warning("Distribution!","No domains are assigned to rank "+std::to_string(comm->rank()));
+    }
+
+    OPENHDM_LOG("Rank "+std::to_string(comm->rank())+" of "+std::to_string(nRanks)+": "
+                +std::to_string(domains.size()-nShadows)+" domain(s) and "
+                +std::to_string(nShadows)+" shadow parent(s)",2);
+}
+
+
+// Assigns the core sets of the domains. (See setAffinity()) Each local domain is placed on a NUMA
+// node, where a child is placed on the node of its parent as long as the node has enough unassigned
+// CPUs for the processors of the child, and the other domains are placed on the least loaded
+// nodes. With the Node policy, the threads of a domain are pinned to all of the CPUs of its node,
+// and with the Core policy, each thread is pinned to one of the CPUs assigned to the domain in the
+// node. A shadow parent is placed on the node of its first local child, so that its data, which is
+// accessed by the children, is first-touched there.
+template <class domainClass>
+void Project<domainClass>::placeDomains(){
+
+    if (affinityPolicy==Affinity::Policy::None and affinityTable.empty()) return;
+
+    auto const &nodes = Affinity::Topology::get().nodes;
+    std::vector<size_t> load(nodes.size(), 0);      // no. of CPUs assigned in each node
+    std::map<std::string,Affinity::Binding> bindings;
+
+    for (auto &entry : affinityTable){
+        if (not getDomain(entry.first)){
+            Report::warning("Affinity","Domain "+entry.first+" in the CPUs table is not found.");
+        }
+    }
+
+    // Returns the node containing all of the given CPUs, or -1:
+    auto nodeOf = [&](std::vector<unsigned> const &cpus){
+        for (size_t n=0; n<nodes.size(); n++){
+            if (std::includes(nodes[n].begin(), nodes[n].end(), cpus.begin(), cpus.end())) return int(n);
+        }
+        return -1;
+    };
+
+    auto place = [&](std::shared_ptr<domainClass> const &domain){
+        Affinity::Binding binding;
+        binding.perThread = (affinityPolicy==Affinity::Policy::Core);
+        size_t nCPUs = domain->get_nProc_intraDomain();
+
+        auto tableIt = affinityTable.find(domain->getID());
+        if (tableIt!=affinityTable.end()){
+            binding.cpus = tableIt->second;
+            std::sort(binding.cpus.begin(), binding.cpus.end());
+            binding.node = nodeOf(binding.cpus);
+        }
+        else if (affinityPolicy!=Affinity::Policy::None){
+
+            // The node of the parent, if it has enough unassigned CPUs, or the least loaded node:
+            int node = -1;
+            if (domain->isChild() and bindings.count(domain->getParent()->getID())){
+                int parentNode = bindings[domain->getParent()->getID()].node;
+                if (parentNode>=0 and load[parentNode]+nCPUs<=nodes[parentNode].size()){
+                    node = parentNode;
+                }
+            }
+            if (node<0){
+                node = 0;
+                for (size_t n=1; n<nodes.size(); n++){
+                    if (double(load[n])/nodes[n].size() < double(load[node])/nodes[node].size()){
+                        node = int(n);
+                    }
+                }
+            }
+
+            binding.node = node;
+            if (binding.perThread){
+                for (size_t c=0; c<nCPUs; c++){
+                    binding.cpus.push_back(nodes[node][(load[node]+c)%nodes[node].size()]);
+                }
+            }
+            else{
+                binding.cpus = nodes[node];
+            }
+        }
+        if (binding.node>=0){
+            load[binding.node] += nCPUs;
+        }
+
+        OPENHDM_LOG("Domain "+domain->getID()+" is pinned to the CPUs "+Affinity::toString(binding.cpus)
+                    +(binding.node>=0 ? " (node "+std::to_string(binding.node)+")" : ""),3);
+        bindings[domain->getID()] = binding;
+        domain->setAffinity(binding);
+    };
+
+    // Place the local parents, the local children, and then the shadow parents:
+    for (auto &domain : domains){
+        if (domain->isLocal() and domain->isParent()) place(domain);
+    }
+    for (auto &domain : domains){
+        if (domain->isLocal() and domain->isChild()) place(domain);
+    }
+    for (auto &domain : domains){
+        if (domain->isLocal()) continue;
+        for (auto &childWP: domain->childDomains){
+            auto child = childWP.lock();
+            if (child and child->isLocal() and not child->getAffinity().empty()){
+                Affinity::Binding binding;
+                binding.node = child->getAffinity().node;
+                binding.cpus = binding.node>=0 ? nodes[binding.node] : child->getAffinity().cpus;
+                domain->setAffinity(binding);
+                break;
+            }
+        }
+    }
+}
+
+
 // Reads predefined domains from a project input file, instantiates the domains,
 // and adds them to the project
 template <class domainClass>
@@ -313,22 +849,60 @@ void Project<domainClass>::setDomainConcurrency(unsigned nProcTotal, unsigned nP
     // Check nProc and update if necessary
     check_nProc(nProcTotal, nProcChild);
 
-    // Check if there are multiple parent domains
-    check_multipleParents();
+    // If there are multiple parent domains, i.e., multiple independent domain hierarchies, a
+    // single thread pool is shared by all of the domains, and the processors that are not
+    // dedicated to the pool are evenly distributed among the parent domains.
+    unsigned nParents = get_nParents();
+    unsigned nProcParent = 0;
+    if (nParents>1){
+
+        // Dedicate ~50% of procs to inter-domain concurrency (at least one per parent):
+        unsigned nProc_interDomain = std::max(nParents, unsigned(nProcTotal/2.));
+
+        // If a custom nProcChild is provided by the user, update nProc_interDomain:
+        if (nProcChild>0){
+            nProc_interDomain = nProcChild+nParents;
+        }
+
+        // Dedicate remaining procs to parent domains:
+        nProcParent = std::max(unsigned(1),
+                               (nProcTotal>nProc_interDomain ? nProcTotal-nProc_interDomain : 0)/nParents+1);
+
+        threadPool = std::make_shared<Threading::Pool>(nProc_interDomain);
+
+        OPENHDM_LOG("Number of parent domains: "+std::to_string(nParents), 2);
+        OPENHDM_LOG("Number of processors allocated for domain concurrency: "
+                    +std::to_string(nProc_interDomain), 2);
+    }
 
     // Determine number of processors to be dedicated to inter- and intra-domain
-    // parallelism. Initialize the thread pool and the mutex of the parent domain,
-    // and provide child domains with pointers to concurrency constructs.
+    // parallelism. Initialize the thread pool of the parent domain(s), and provide
+    // child domains with pointers to concurrency constructs.
+    bool firstParent = true;
     for (auto &domain : domains){
         if (domain->isParent()){
 
             // Configure parent domain concurrency settings:
-            domain->setConcurrency(nProcTotal, nProcChild);
+            domain->setRebalancing(rebalanceInterval, rebalanceThreshold);
+            if (nParents>1){
+                domain->setConcurrency(nProcParent, threadPool);
+            }
+            else{
+                domain->setConcurrency(nProcTotal, nProcChild);
+            }
+
+            // Display the progress of the first hierarchy only:
+            if (domain->isLocal()){
+                domain->showProgress = firstParent;
+                firstParent = false;
+            }
 
-            // Configure child domains' concurrency settings:
+            // Configure child domains' concurrency settings (except for those on other ranks):
             for (auto &childWP: domain->childDomains){
                 auto child = childWP.lock();
-                child->setConcurrency();
+                if (child->isLocal()){
+                    child->setConcurrency();
+                }
             }
         }
     }
@@ -342,6 +916,7 @@ template <class domainClass>
 void Project<domainClass>::processTimesteppingParams(){
 
     if (not (nd()>0) ){
+        if (comm) return;   // no domains assigned to this rank
         Report::error("Timestepping Parameters",
                       "The project has no domains instantiated.");
     }
@@ -350,15 +925,30 @@ void Project<domainClass>::processTimesteppingParams(){
     nts = domains[0]->get_nts();
     nPhases = domains[0]->get_nPhases();
 
-    // Ensure that nts and nPhases are same for all domains
+    // Ensure that nts and nPhases of child domains are same as those of their parents, or
+    // that nts of subcycled children are the timestep ratio times that of their parents.
+    // (Independent domain hierarchies may have different timestepping parameters.)
     for (auto &domain : domains){
-        if (domain->get_nts() != nts){
+        nts = std::max(nts, domain->get_nts());
+        unsigned ratio = domain->getTimestepRatio();
+        if (domain->isParent()){
+            if (ratio>1 or domain->getLagWindow()>0){
+                Report::error("Timestepping Parameters",
+                              "Parent domain "+domain->getID()+" cannot be subcycled or lagged.");
+            }
+            continue;
+        }
+
+        if (domain->get_nts() != ratio*domain->getParent()->get_nts()){
             Report::error("Timestepping Parameters",
-                          "nts of "+domain->getID()+"is not the same as the previous domain(s).");
+                          "nts of "+domain->getID()+" is not the same as its parent domain"
+                          +(ratio>1 ? " times the timestep ratio "+std::to_string(ratio)+"." : "."));
         }
-        if (domain->get_nPhases() != nPhases){
+        if (ratio==1 and domain->getLagWindow()==0 and
+            domain->get_nControlPoints() != domain->getParent()->get_nControlPoints()){
             Report::error("Timestepping Parameters",
-                          "nPhases of "+domain->getID()+"is not the same as the previous domain(s).");
+                          "The number of control points (non-local phases) of "+domain->getID()+
+                          " is not the same as its parent domain.");
         }
     }
 
@@ -383,16 +973,18 @@ unsigned Project<domainClass>::getDomainPosition(const std::string domainID){
 template <class domainClass>
 void Project<domainClass>::check_nProc(unsigned &nProcTotal, unsigned &nProcChild){
 
+    unsigned nProcAvailable = std::max(1u, std::thread::hardware_concurrency()-1);
+
     if (nProcTotal>std::thread::hardware_concurrency()){
         Report::warning("Concurrency!","Number of processors specified in CL ="
                         +std::to_string(nProcTotal)+" is greater than the number of available"
                         " threads ="+std::to_string(std::thread::hardware_concurrency())
                         +"\n\t Setting number of processors to "
-                        +std::to_string(std::thread::hardware_concurrency()-1),1);
-        nProcTotal = std::thread::hardware_concurrency()-1;
+                        +std::to_string(nProcAvailable),1);
+        nProcTotal = nProcAvailable;
     }
 
-    if (nProcChild>=nProcTotal){
+    if (nProcChild>0 and nProcChild>=nProcTotal){
         Report::warning("Concurrency!","Number of processors allocated for children must be "
                         "less than the number of total processors ="
                         +std::to_string(nProcTotal)
@@ -410,19 +1002,15 @@ void Project<domainClass>::check_nProc(unsigned &nProcTotal, unsigned &nProcChil
 }
 
 
-// Checks if there are multiple domains.
+// Returns the number of parent domains, i.e., the number of independent domain hierarchies.
 template <class domainClass>
-void Project<domainClass>::check_multipleParents(){
+unsigned Project<domainClass>::get_nParents(){
 
-    int nParents = 0;
+    unsigned nParents = 0;
     for (auto &domain : domains){
         nParents += domain->isParent();
     }
-
-    if (nParents>1){
-        Report::error("Concurrency!",
-                  "Only one parent domain can be executed during parallel runs");
-    }
+    return nParents;
 }
 
 
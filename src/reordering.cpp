@@ -0,0 +1,115 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <climits>
+#include <cstdint>
+#include <numeric>
+#include "reordering.h"
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the space-filling
+// curve orderings defined in reordering.h
+// --------------------------------------------------------------------
+
+namespace {
+
+// The resolution of the curves (in bits per coordinate):
+const unsigned int curveBits = 16;
+
+// Interleaves the bits of x and y (i.e., the Morton code)
+uint64_t mortonKey(uint32_t x, uint32_t y){
+    uint64_t key = 0;
+    for (unsigned int b=0; b<curveBits; b++){
+        key |= uint64_t((x>>b)&1u) << (2*b);
+        key |= uint64_t((y>>b)&1u) << (2*b+1);
+    }
+    return key;
+}
+
+// Returns the distance along the Hilbert curve of the cell (x,y)
+uint64_t hilbertKey(uint32_t x, uint32_t y){
+    uint64_t key = 0;
+    for (uint32_t s=1u<<(curveBits-1); s>0; s>>=1){
+        uint32_t rx = (x & s) ? 1 : 0;
+        uint32_t ry = (y & s) ? 1 : 0;
+        key += uint64_t(s)*s*((3*rx)^ry);
+        // Rotate the quadrant:
+        if (ry==0){
+            if (rx==1){
+                x = s-1-x;
+                y = s-1-y;
+            }
+            std::swap(x,y);
+        }
+    }
+    return key;
+}
+
+} // end of anonymous namespace
+
+// The coordinates are scaled to a 2^16 x 2^16 lattice over their bounding box, and units are
+// sorted by the curve distance of their lattice cells. Units within the same cell retain their
+// relative order.
+std::vector<unsigned int> Reordering::alongCurve(std::vector<std::array<double,2>> const &coords, Curve curve){
+
+    size_t n = coords.size();
+    std::vector<unsigned int> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    if (n==0) return order;
+
+    // Bounding box:
+    std::array<double,2> lo = coords[0], hi = coords[0];
+    for (auto &c : coords){
+        for (int d=0; d<2; d++){
+            lo[d] = std::min(lo[d], c[d]);
+            hi[d] = std::max(hi[d], c[d]);
+        }
+    }
+
+    // Curve keys:
+    const double cells = double((1u<<curveBits)-1);
+    std::vector<uint64_t> keys(n);
+    for (size_t i=0; i<n; i++){
+        uint32_t cell[2];
+        for (int d=0; d<2; d++){
+            double extent = hi[d]-lo[d];
+            cell[d] = extent>0. ? uint32_t((coords[i][d]-lo[d])/extent*cells) : 0;
+        }
+        keys[i] = (curve==Curve::Hilbert) ? hilbertKey(cell[0], cell[1]) : mortonKey(cell[0], cell[1]);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b){
+        return keys[a] < keys[b];
+    });
+    return order;
+}
+
+std::vector<unsigned int> Reordering::invert(std::vector<unsigned int> const &order){
+
+    std::vector<unsigned int> old2new(order.size(), UINT_MAX);
+    for (size_t i=0; i<order.size(); i++){
+        if (order[i]>=order.size() or old2new[order[i]]!=UINT_MAX){
+            Report::error("Reordering::invert","The ordering is not a permutation of the unit positions.");
+        }
+        old2new[order[i]] = unsigned(i);
+    }
+    return old2new;
+}
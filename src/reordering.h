@@ -0,0 +1,127 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef REORDERING_H
+#define REORDERING_H
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include "report.h"
+#include "connectivity.h"
+
+namespace OpenHDM {
+namespace Reordering {
+
+// --------------------------------------------------------------------
+// Reordering: Functions to compute locality-improving orderings of
+//   the units of a grid. An ordering is a list "order" of the unit
+//   positions, such that the unit at the new position i is the unit
+//   at the old position order[i]. (See Grid::reorderUnits())
+// --------------------------------------------------------------------
+
+// Space-filling curves for spatial orderings:
+enum class Curve {Hilbert, Morton};
+
+// Returns the reverse Cuthill-McKee ordering of n units based on their adjacency. The adjacency
+// must be symmetric (see Adjacency::isSymmetric()), since the traversal follows its pairs in one
+// direction only.
+template <class unitType>
+std::vector<unsigned int> reverseCuthillMcKee(Adjacency<unitType,unitType> const &adjacency, size_t n);
+
+// Returns the ordering of units along a space-filling curve through their (x,y) coordinates.
+std::vector<unsigned int> alongCurve(std::vector<std::array<double,2>> const &coords, Curve curve=Curve::Hilbert);
+
+// Returns the inverse of an ordering, i.e., a mapping from old positions to new positions.
+std::vector<unsigned int> invert(std::vector<unsigned int> const &order);
+
+// Returns the bandwidth of an adjacency, i.e., the maximum distance between the positions of
+// neighboring units.
+template <class unitType>
+unsigned int bandwidth(Adjacency<unitType,unitType> const &adjacency);
+
+
+// The units are visited in breadth-first order starting from a unit of minimum degree in each
+// connected component, where the neighbors of each unit are visited in increasing order of their
+// degrees. The visiting order is then reversed. Units with no neighbors are placed last.
+template <class unitType>
+std::vector<unsigned int> reverseCuthillMcKee(Adjacency<unitType,unitType> const &adjacency, size_t n){
+
+    std::vector<unsigned int> order;
+    order.reserve(n);
+    std::vector<bool> visited(n, false);
+
+    // Candidate start units sorted by degree:
+    std::vector<unsigned int> byDegree(n);
+    for (unsigned int i=0; i<n; i++) byDegree[i] = i;
+    std::stable_sort(byDegree.begin(), byDegree.end(), [&](unsigned int a, unsigned int b){
+        return adjacency.degree(a) < adjacency.degree(b);
+    });
+
+    std::vector<unsigned int> isolated;
+    std::vector<unsigned int> front;
+    for (auto start : byDegree){
+        if (visited[start]) continue;
+        if (adjacency.degree(start)==0){
+            visited[start] = true;
+            isolated.push_back(start);
+            continue;
+        }
+
+        // Breadth-first traversal of the component:
+        size_t head = order.size();
+        order.push_back(start);
+        visited[start] = true;
+        while (head < order.size()){
+            unsigned int pos = order[head++];
+            front.clear();
+            for (auto neighbor : adjacency.neighbors(pos)){
+                if (neighbor<n and not visited[neighbor]){
+                    visited[neighbor] = true;
+                    front.push_back(neighbor);
+                }
+            }
+            std::stable_sort(front.begin(), front.end(), [&](unsigned int a, unsigned int b){
+                return adjacency.degree(a) < adjacency.degree(b);
+            });
+            order.insert(order.end(), front.begin(), front.end());
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    order.insert(order.end(), isolated.begin(), isolated.end());
+    return order;
+}
+
+template <class unitType>
+unsigned int bandwidth(Adjacency<unitType,unitType> const &adjacency){
+
+    unsigned int b = 0;
+    for (unsigned int pos=0; pos<adjacency.nRows(); pos++){
+        for (auto neighbor : adjacency.neighbors(pos)){
+            b = std::max(b, neighbor>pos ? neighbor-pos : pos-neighbor);
+        }
+    }
+    return b;
+}
+
+} // end of namespace Reordering
+} // end of namespace OpenHDM
+
+#endif // REORDERING_H
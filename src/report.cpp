@@ -17,6 +17,14 @@
 // You should have received a copy of the GNU General Public License
 // along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "report.h"
 
 // --------------------------------------------------------------------
@@ -24,13 +32,166 @@
 // errors, warnings, and logs.
 // --------------------------------------------------------------------
 
+namespace {
+
+struct Message{
+    uint64_t seq = 0;                   // global order of the messages
+    std::ostream *stream = nullptr;
+    std::string text;
+};
+
+// A single-producer single-consumer ring buffer of the messages of a thread, which are consumed
+// by the sink thread
+struct Ring{
+    static const size_t capacity = 256;
+
+    bool push(Message &message){
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t-head.load(std::memory_order_acquire)==capacity) return false;
+        slots[t%capacity] = std::move(message);
+        tail.store(t+1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Message &message){
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h==tail.load(std::memory_order_acquire)) return false;
+        message = std::move(slots[h%capacity]);
+        head.store(h+1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty()const{return head.load(std::memory_order_acquire)==tail.load(std::memory_order_acquire);}
+
+    std::array<Message,capacity> slots;
+    std::atomic<size_t> head{0};        // next slot to be consumed
+    std::atomic<size_t> tail{0};        // next slot to be produced
+    std::atomic<bool> orphaned{false};  // the owner thread has exited
+};
+
+// The rings of the threads and the sink thread writing their messages in order
+struct Sink{
+
+    void start(){
+        std::lock_guard<std::mutex> lock(threadMtx);
+        if (thread.joinable()) return;
+        stopping = false;
+        nextSeq = seq.load();
+        async = true;
+        thread = std::thread([this]{
+            while (not stopping.load()){
+                if (not drain()){
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                }
+            }
+            drain(true);
+        });
+    }
+
+    void stop(){
+        std::lock_guard<std::mutex> lock(threadMtx);
+        if (not thread.joinable()) return;
+        async = false;
+        stopping = true;
+        thread.join();
+    }
+
+    // Writes the queued messages in the order of their sequence numbers. A message is held back
+    // until the messages of all of the preceding sequence numbers are written, since a thread may
+    // be preempted between obtaining a sequence number and queueing the message. The final drain
+    // writes the held back messages as well. Returns false if there are no messages.
+    bool drain(bool final=false){
+        size_t nHeld = held.size();
+        {
+            std::lock_guard<std::mutex> lock(ringsMtx);
+            Message message;
+            for (auto &ring : rings){
+                while (ring->pop(message)){
+                    held.push_back(std::move(message));
+                }
+            }
+            rings.erase(std::remove_if(rings.begin(), rings.end(), [](std::shared_ptr<Ring> const &ring){
+                return ring->orphaned.load() and ring->empty();
+            }), rings.end());
+        }
+        if (held.size()==nHeld and not final) return false;
+
+        std::sort(held.begin(), held.end(), [](Message const &a, Message const &b){
+            return a.seq<b.seq;
+        });
+        size_t nReady = 0;
+        while (nReady<held.size() and (final or held[nReady].seq<=nextSeq)){
+            nextSeq = std::max(nextSeq, held[nReady].seq+1);
+            write(*held[nReady].stream, held[nReady].text);
+            nReady++;
+        }
+        held.erase(held.begin(), held.begin()+nReady);
+        nWritten.fetch_add(nReady);
+        return true;
+    }
+
+    void write(std::ostream &stream, std::string const &text){
+        std::lock_guard<std::mutex> lock(streamMtx);
+        stream << text << std::flush;
+    }
+
+    std::mutex ringsMtx;
+    std::vector<std::shared_ptr<Ring>> rings;
+    std::vector<Message> held;          // messages waiting for the preceding ones (sink thread only)
+    uint64_t nextSeq = 0;               // the sequence number of the next message to be written
+    std::mutex streamMtx;
+    std::mutex threadMtx;
+    std::thread thread;
+    std::atomic<bool> async{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> nQueued{0};
+    std::atomic<uint64_t> nWritten{0};
+};
+
+// The sink is never destroyed, so that threads may still report while the process exits, e.g.,
+// once another thread has called Report::error(). Instead, the sink thread is stopped at exit, after
+// which the messages are written synchronously.
+Sink& sink(){
+    static Sink* s = []{
+        Sink* newSink = new Sink;
+        std::atexit([]{sink().stop();});
+        return newSink;
+    }();
+    return *s;
+}
+
+// Marks the ring of a thread as orphaned when the thread exits
+struct RingOwner{
+    ~RingOwner(){
+        if (ring) ring->orphaned = true;
+    }
+    std::shared_ptr<Ring> ring;
+};
+
+thread_local RingOwner ringOwner;
+
+// Returns the ring of the calling thread, which is registered to the sink at the first call
+Ring& localRing(){
+    if (not ringOwner.ring){
+        ringOwner.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(sink().ringsMtx);
+        sink().rings.push_back(ringOwner.ring);
+    }
+    return *ringOwner.ring;
+}
+
+} // end of anonymous namespace
+
+
 __attribute__((noreturn))
 void Report::error(std::string source, std::string dscrpt){
 
+    // Write the pending messages first:
+    flush();
+
     if ( source!="" or dscrpt!=""){
-        std::cerr << std::endl;
-        std::cerr << "\t" << "ERROR: " << source << std::endl;
-        std::cerr << "\t" << dscrpt << std::endl << std::endl;
+        emit(std::cerr, "\n\tERROR: "+source+"\n\t"+dscrpt+"\n\n");
     }
 
     //throw std::runtime_error ("dscrpt");
@@ -38,6 +199,7 @@ void Report::error(std::string source, std::string dscrpt){
 }
 
 void Report::warning(std::string source, std::string dscrpt, unsigned short severity){
+    if (not warns()) return;
     switch (severity) {
     case 9999:
         printMessage( ("Warning: "+source), dscrpt );
@@ -49,15 +211,61 @@ void Report::warning(std::string source, std::string dscrpt, unsigned short seve
 }
 
 void Report::log(std::string msg, unsigned short level){
+    if (not logs(level)) return;
+
     std::string indent = "  ";
     for (unsigned short l=0; l<level; l++)
         indent = indent+"  ";
 
-    std::clog << indent << msg << std::endl;
+    emit(std::clog, indent+msg+"\n");
 }
 
 void Report::printMessage(std::string source, std::string msg){
-    std::cout << std::endl;
-    std::cout << "\t " << source << std::endl;
-    std::cout << "\t " << msg << std::endl << std::endl;
+    emit(std::cout, "\n\t "+source+"\n\t "+msg+"\n\n");
+}
+
+// Enables (or disables) the asynchronous output, where the messages are written by a background
+// sink thread. Disabling the asynchronous output writes the pending messages first, and should be
+// done while no other threads are reporting, e.g., after the run.
+void Report::setAsync(bool async){
+    if (async){
+        sink().start();
+    }
+    else{
+        flush();
+        sink().stop();
+    }
+}
+
+bool Report::isAsync(){
+    return sink().async.load();
+}
+
+// Waits until all of the messages queued so far are written (asynchronous output only)
+void Report::flush(){
+    Sink &s = sink();
+    if (not s.async.load()) return;
+
+    uint64_t nQueued = s.nQueued.load();
+    while (s.nWritten.load()<nQueued){
+        std::this_thread::yield();
+    }
+}
+
+// Writes the whole text of a message to a stream, or queues it in the ring of the calling thread
+// if the output is asynchronous. If the ring is full, the thread waits for the sink.
+void Report::emit(std::ostream &stream, std::string text){
+
+    Sink &s = sink();
+    if (not s.async.load(std::memory_order_acquire)){
+        s.write(stream, text);
+        return;
+    }
+
+    Ring &ring = localRing();
+    Message message{s.seq.fetch_add(1), &stream, std::move(text)};
+    s.nQueued.fetch_add(1);
+    while (not ring.push(message)){
+        std::this_thread::yield();
+    }
 }
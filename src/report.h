@@ -23,12 +23,34 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <atomic>
+#include <climits>
+
+// The maximum level of the logs that are compiled in. The logs of greater levels are removed at
+// compile time by OPENHDM_LOG. (e.g., -DOPENHDM_LOG_LEVEL=2)
+#ifndef OPENHDM_LOG_LEVEL
+#define OPENHDM_LOG_LEVEL 9
+#endif
+
+// Logs a message unless its level is filtered out at compile time or at runtime, in which case
+// the message expression is not evaluated at all, e.g.,
+//   OPENHDM_LOG("Checkpoint "+filePath+" is written.", 4);
+#define OPENHDM_LOG(msg, level) \
+    do { if (OpenHDM::Report::logs(level)) OpenHDM::Report::log((msg), (level)); } while (0)
+
+// Reports a warning unless the warnings are disabled at runtime (see Report::setWarnings())
+#define OPENHDM_WARNING(source, msg) \
+    do { if (OpenHDM::Report::warns()) OpenHDM::Report::warning((source), (msg)); } while (0)
 
 namespace OpenHDM {
 
 // --------------------------------------------------------------------
 // Report: An auxiliary concrete class aimed to be used for reporting
-//   errors, warnings, and logs.
+//   errors, warnings, and logs. Each message is written as a whole,
+//   so the messages of concurrent threads do not interleave. In the
+//   asynchronous mode, the messages are queued in a ring buffer of the
+//   calling thread and written by a background sink thread, so that
+//   the threads do not block on the output streams.
 // --------------------------------------------------------------------
 
 class Report
@@ -39,6 +61,19 @@ public:
     static void warning(std::string source, std::string dscrpt, unsigned short severity=1);
     static void log(std::string msg, unsigned short level=1);
 
+    // Filtering of the logs and warnings (see OPENHDM_LOG and OPENHDM_WARNING):
+    static void setLogLevel(unsigned short level){logLevel.store(level, std::memory_order_relaxed);}
+    static void setWarnings(bool enabled){warningsEnabled.store(enabled, std::memory_order_relaxed);}
+    static bool logs(unsigned short level){
+        return level<=OPENHDM_LOG_LEVEL and level<=logLevel.load(std::memory_order_relaxed);
+    }
+    static bool warns(){return warningsEnabled.load(std::memory_order_relaxed);}
+
+    // Asynchronous output:
+    static void setAsync(bool async=true);
+    static bool isAsync();
+    static void flush();
+
     // Prints multiple number of variables (of any type) to the screen:
     // The implementation is provided at the end of this header file.
     // ( This variadic function template is mostly used for debugging purposes)
@@ -51,6 +86,10 @@ public:
 
 private:
     static void printMessage(std::string source, std::string msg);
+    static void emit(std::ostream &stream, std::string text);
+
+    static inline std::atomic<unsigned short> logLevel{USHRT_MAX};
+    static inline std::atomic<bool> warningsEnabled{true};
 };
 
 template <typename FirstVarType, typename ...Rest>
@@ -0,0 +1,151 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include "serialization.h"
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the "Serializer"
+// and "Deserializer" classes defined in serialization.h
+// --------------------------------------------------------------------
+
+Serializer::Serializer():
+    inMemory(true)
+{
+
+}
+
+Serializer::Serializer(std::string filePath_):
+    filePath(filePath_),
+    tmpPath(filePath_+".tmp")
+{
+    ofs.open(tmpPath, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc);
+    if (not ofs.is_open()){
+        Report::error("Serializer!","Couldn't open "+tmpPath);
+    }
+}
+
+Serializer::~Serializer(){
+    if (inMemory or closed) return;
+    if (ofs.is_open()){
+        ofs.close();
+    }
+    std::remove(tmpPath.c_str());
+}
+
+void Serializer::write(std::string const &s){
+    write(uint64_t(s.size()));
+    writeBytes(s.data(), s.size());
+}
+
+void Serializer::writeBytes(const void* data, size_t n){
+    if (inMemory){
+        const char* bytes = static_cast<const char*>(data);
+        buffer.insert(buffer.end(), bytes, bytes+n);
+        return;
+    }
+    ofs.write(static_cast<const char*>(data), n);
+    if (not ofs.good()){
+        Report::error("Serializer!","Couldn't write to "+tmpPath);
+    }
+    digest = hash(data, n, digest);
+}
+
+void Serializer::writeChecksum(){
+    uint64_t checksum = inMemory ? hash(buffer.data(), buffer.size()) : digest;
+    write(checksum);
+}
+
+void Serializer::close(){
+    if (inMemory or not ofs.is_open()) return;
+    ofs.close();
+    if (ofs.fail()){
+        Report::error("Serializer!","Couldn't write to "+tmpPath);
+    }
+    if (std::rename(tmpPath.c_str(), filePath.c_str()) != 0){
+        Report::error("Serializer!","Couldn't rename "+tmpPath+" to "+filePath);
+    }
+    closed = true;
+}
+
+uint64_t Serializer::hash(const void* data, size_t n, uint64_t seed){
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t h = seed;
+    for (size_t i=0; i<n; i++){
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+uint64_t Serializer::hashFiles(std::vector<std::string> const &filePaths){
+    uint64_t h = hash(nullptr, 0);
+    for (auto &filePath : filePaths){
+        MappedFile file(filePath);
+        uint64_t size = file.size();
+        h = hash(&size, sizeof(size), h);
+        h = hash(file.data(), file.size(), h);
+    }
+    return h;
+}
+
+
+Deserializer::Deserializer(std::string filePath_):
+    filePath(filePath_),
+    mappedFile(filePath_),
+    begin(mappedFile.data()),
+    length(mappedFile.size())
+{
+
+}
+
+Deserializer::Deserializer(std::vector<char> buffer_):
+    filePath("<buffer>"),
+    buffer(std::move(buffer_)),
+    begin(buffer.data()),
+    length(buffer.size())
+{
+
+}
+
+void Deserializer::read(std::string &s){
+    s.resize(get<uint64_t>());
+    readBytes(&s[0], s.size());
+}
+
+bool Deserializer::verifyChecksum(){
+    if (length-offset<sizeof(uint64_t)) return false;
+    uint64_t checksum;
+    std::memcpy(&checksum, begin+length-sizeof(uint64_t), sizeof(uint64_t));
+    if (checksum!=Serializer::hash(begin, length-sizeof(uint64_t))) return false;
+    length -= sizeof(uint64_t);
+    return true;
+}
+
+void Deserializer::readBytes(void* data, size_t n){
+    if (n>remaining()){
+        Report::error("Deserializer!","Unexpected end of file "+filePath);
+    }
+    if (n>0){
+        std::memcpy(data, begin+offset, n);
+    }
+    offset += n;
+}
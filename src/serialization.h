@@ -0,0 +1,244 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <fstream>
+#include <type_traits>
+#include "report.h"
+#include "input.h"
+
+namespace OpenHDM {
+
+// --------------------------------------------------------------------
+// Serializer: An auxiliary class to write binary data, e.g., grid
+//   snapshots, to a file. Values of trivially copyable types and
+//   containers thereof are written in the native byte order. A
+//   default-constructed serializer writes to an in-memory buffer
+//   instead, e.g., to write checkpoints asynchronously. A file is
+//   written to a temporary file first, which is renamed to the file
+//   path on close(), so the file is either complete or not replaced.
+//   (The temporary file is removed if the serializer is destroyed
+//   without being closed, e.g., on an early return.)
+// --------------------------------------------------------------------
+
+class Serializer
+{
+public:
+    Serializer();
+    Serializer(std::string filePath_);
+    ~Serializer();
+
+    template <typename T>
+    void write(T const &val);
+    template <typename A, typename B>
+    void write(std::pair<A,B> const &val);
+    template <typename T, typename A>
+    void write(std::vector<T,A> const &vals);
+    template <typename T, typename A>
+    void write(std::list<T,A> const &vals);
+    template <typename K, typename V, typename H, typename E, typename A>
+    void write(std::unordered_map<K,V,H,E,A> const &map);
+    void write(std::string const &s);
+    void writeBytes(const void* data, size_t n);
+
+    // Appends the hash of the bytes written so far. (See Deserializer::verifyChecksum())
+    void writeChecksum();
+
+    void close();
+    std::vector<char>& getBuffer(){return buffer;}
+
+    // Content hash (64-bit FNV-1a) of a list of files, e.g., the input files a grid is
+    // constructed from. Used as the key of cached snapshots.
+    static uint64_t hash(const void* data, size_t n, uint64_t seed=14695981039346656037ull);
+    static uint64_t hashFiles(std::vector<std::string> const &filePaths);
+
+private:
+    template <typename T, typename A>
+    void writeElements(std::vector<T,A> const &vals, std::true_type /*trivially copyable*/);
+    template <typename T, typename A>
+    void writeElements(std::vector<T,A> const &vals, std::false_type);
+
+    std::string filePath;
+    std::string tmpPath;
+    std::ofstream ofs;
+    bool inMemory = false;
+    bool closed = false;        // whether the temporary file is renamed to the file path
+    std::vector<char> buffer;   // (in-memory mode only)
+    uint64_t digest = hash(nullptr, 0);    // hash of the bytes written (file mode only)
+};
+
+template <typename T>
+void Serializer::write(T const &val){
+    static_assert(std::is_trivially_copyable<T>::value, "Serializer requires trivially copyable types");
+    writeBytes(&val, sizeof(T));
+}
+
+template <typename A, typename B>
+void Serializer::write(std::pair<A,B> const &val){
+    write(val.first);
+    write(val.second);
+}
+
+template <typename T, typename A>
+void Serializer::write(std::vector<T,A> const &vals){
+    write(uint64_t(vals.size()));
+    writeElements(vals, std::is_trivially_copyable<T>());
+}
+
+template <typename T, typename A>
+void Serializer::writeElements(std::vector<T,A> const &vals, std::true_type){
+    writeBytes(vals.data(), vals.size()*sizeof(T));
+}
+
+template <typename T, typename A>
+void Serializer::writeElements(std::vector<T,A> const &vals, std::false_type){
+    for (auto &val : vals){
+        write(val);
+    }
+}
+
+template <typename T, typename A>
+void Serializer::write(std::list<T,A> const &vals){
+    write(uint64_t(vals.size()));
+    for (auto &val : vals){
+        write(val);
+    }
+}
+
+template <typename K, typename V, typename H, typename E, typename A>
+void Serializer::write(std::unordered_map<K,V,H,E,A> const &map){
+    write(uint64_t(map.size()));
+    for (auto &entry : map){
+        write(entry.first);
+        write(entry.second);
+    }
+}
+
+
+// --------------------------------------------------------------------
+// Deserializer: An auxiliary class to read binary data written by
+//   Serializer. The file is memory-mapped, and arrays are copied from
+//   the mapping in bulk. A deserializer may also be constructed from an
+//   in-memory buffer, e.g., a message received from another rank.
+// --------------------------------------------------------------------
+
+class Deserializer
+{
+public:
+    Deserializer(std::string filePath_);
+    Deserializer(std::vector<char> buffer_);
+
+    template <typename T>
+    void read(T &val);
+    template <typename A, typename B>
+    void read(std::pair<A,B> &val);
+    template <typename T, typename A>
+    void read(std::vector<T,A> &vals);
+    template <typename T, typename A>
+    void read(std::list<T,A> &vals);
+    template <typename K, typename V, typename H, typename E, typename A>
+    void read(std::unordered_map<K,V,H,E,A> &map);
+    void read(std::string &s);
+    void readBytes(void* data, size_t n);
+
+    // Checks the checksum appended by Serializer::writeChecksum() and excludes it from the data.
+    // Returns false if the data is truncated or corrupt.
+    bool verifyChecksum();
+
+    template <typename T>
+    T get(){T val; read(val); return val;}
+
+    size_t remaining() const {return length-offset;}
+
+private:
+    template <typename T, typename A>
+    void readElements(std::vector<T,A> &vals, std::true_type /*trivially copyable*/);
+    template <typename T, typename A>
+    void readElements(std::vector<T,A> &vals, std::false_type);
+
+    std::string filePath;
+    MappedFile mappedFile;
+    std::vector<char> buffer;   // (in-memory mode only)
+    const char* begin = nullptr;
+    size_t length = 0;
+    size_t offset = 0;
+};
+
+template <typename T>
+void Deserializer::read(T &val){
+    static_assert(std::is_trivially_copyable<T>::value, "Deserializer requires trivially copyable types");
+    readBytes(&val, sizeof(T));
+}
+
+template <typename A, typename B>
+void Deserializer::read(std::pair<A,B> &val){
+    read(val.first);
+    read(val.second);
+}
+
+template <typename T, typename A>
+void Deserializer::read(std::vector<T,A> &vals){
+    vals.resize(get<uint64_t>());
+    readElements(vals, std::is_trivially_copyable<T>());
+}
+
+template <typename T, typename A>
+void Deserializer::readElements(std::vector<T,A> &vals, std::true_type){
+    readBytes(vals.data(), vals.size()*sizeof(T));
+}
+
+template <typename T, typename A>
+void Deserializer::readElements(std::vector<T,A> &vals, std::false_type){
+    for (auto &val : vals){
+        read(val);
+    }
+}
+
+template <typename T, typename A>
+void Deserializer::read(std::list<T,A> &vals){
+    uint64_t n = get<uint64_t>();
+    vals.clear();
+    for (uint64_t i=0; i<n; i++){
+        vals.push_back(get<T>());
+    }
+}
+
+template <typename K, typename V, typename H, typename E, typename A>
+void Deserializer::read(std::unordered_map<K,V,H,E,A> &map){
+    uint64_t n = get<uint64_t>();
+    map.clear();
+    map.reserve(n);
+    for (uint64_t i=0; i<n; i++){
+        K key = get<K>();
+        map[key] = get<V>();
+    }
+}
+
+} // end of namespace OpenHDM
+
+#endif // SERIALIZATION_H
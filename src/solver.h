@@ -25,6 +25,7 @@
 #include <unordered_map>
 #include <memory>
 #include "report.h"
+#include "serialization.h"
 
 namespace OpenHDM {
 
@@ -54,12 +55,20 @@ public:
     virtual void adjustPatches(unsigned int ts)=0;
     virtual void imposePatchBCs(unsigned int phase)=0;
 
+    // checkpoints:
+    virtual void writeCheckpoint(Serializer &s)const;
+    virtual void readCheckpoint(Deserializer &d);
+
     // attribute accessors:
     const std::shared_ptr<GridType> &getGrid();       // returns a void pointer to its grid
     bool       isChild() const;
 
 protected:
 
+    // Functions to be overridden by solvers with state to be included in checkpoints:
+    virtual void writeState(Serializer &)const{}
+    virtual void readState(Deserializer &){}
+
     std::shared_ptr<GridType> grid;
     std::shared_ptr<Solver<GridType>> parent;
 
@@ -79,6 +88,31 @@ Solver<GridType>::~Solver()
 
 }
 
+// Writes the state of the grid and the solver to a checkpoint
+template<class GridType>
+void Solver<GridType>::writeCheckpoint(Serializer &s)const{
+
+    s.write(bool(grid));
+    if (grid){
+        grid->writeCheckpoint(s);
+    }
+    writeState(s);
+}
+
+// Restores the state of the grid and the solver from a checkpoint
+template<class GridType>
+void Solver<GridType>::readCheckpoint(Deserializer &d){
+
+    bool hasGrid = d.get<bool>();
+    if (hasGrid != bool(grid)){
+        Report::error("Solver::readCheckpoint","The grid of the checkpoint is inconsistent with the solver.");
+    }
+    if (grid){
+        grid->readCheckpoint(d);
+    }
+    readState(d);
+}
+
 template<class GridType>
 const std::shared_ptr<GridType>& Solver<GridType>::getGrid(){
     return grid;
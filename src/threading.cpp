@@ -17,46 +17,71 @@
 // You should have received a copy of the GNU General Public License
 // along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 #include "threading.h"
+#include "report.h"
 
 using namespace OpenHDM;
 
 // --------------------------------------------------------------------
 // This source file includes implementations for multithreading in
-// OpenHDM. The classes "ControlPoint" and "Pool" are defined in
-// threading.h.
+// OpenHDM. The classes "Signal", "ControlPoint", "Pool" and "Executor"
+// are defined in threading.h.
 // --------------------------------------------------------------------
 
+// Note: Signal is Linux-specific (futex) !!!
+
+static_assert(sizeof(std::atomic<unsigned int>)==sizeof(int), "futex word must be 32 bits");
+
+const unsigned int Threading::Signal::nSpins = (std::thread::hardware_concurrency()>1) ? 4096:0;
+
+void Threading::Signal::notify(){
+    epoch.fetch_add(1);
+    if (nSleepers.load()>0){
+        syscall(SYS_futex, reinterpret_cast<int*>(&epoch), FUTEX_WAKE_PRIVATE, INT_MAX,
+                nullptr, nullptr, 0);
+    }
+}
+
+void Threading::Signal::sleep(unsigned int epoch_){
+    // Returns immediately if epoch has changed since epoch_ was read:
+    syscall(SYS_futex, reinterpret_cast<int*>(&epoch), FUTEX_WAIT_PRIVATE, epoch_,
+            nullptr, nullptr, 0);
+}
+
+
 Threading::ControlPoint::ControlPoint()
 {
 
 }
 
+// Enters the next control point. (state becomes even: not done)
 void Threading::ControlPoint::increment(){
-    std::unique_lock<std::shared_timed_mutex> uLock(mtx, std::defer_lock);
-    val = (val+1)%ncp;
-    done = false;
+    state.fetch_add(1, std::memory_order_acq_rel);
 }
 
+// Marks the current control point as done. (state becomes odd: done)
 void Threading::ControlPoint::markDone(){
-    std::unique_lock<std::shared_timed_mutex> uLock(mtx, std::defer_lock);
-    done = true;
+    state.fetch_add(1, std::memory_order_acq_rel);
 }
 
 unsigned int Threading::ControlPoint::getVal()const{
-    std::shared_lock<std::shared_timed_mutex> sLock(mtx, std::defer_lock);
-    return val;
+    uint64_t count = getCount();
+    if (count==0) return UINT_MAX;
+    return unsigned((count-1)%ncp);
 }
 
 bool Threading::ControlPoint::isDone()const{
-    std::shared_lock<std::shared_timed_mutex> sLock(mtx, std::defer_lock);
-    return done;
+    return isDone(getState());
 }
 
 
 Threading::Pool::Pool(unsigned int nProcs_):
     nProcs(nProcs_),
-    remainingThreads(nProcs)
+    remainingThreads(int(nProcs))
 {
 
 }
@@ -72,3 +97,293 @@ void Threading::Pool::release(){
     remainingThreads++;
     cond.notify_all();
 }
+
+// Changes the number of processors of the pool. If the pool is shrunk while processors are
+// acquired, the processors are withdrawn as they are released.
+void Threading::Pool::resize(unsigned int nProcs_){
+    std::unique_lock<std::mutex> uLock(mtx);
+    remainingThreads += int(nProcs_) - int(nProcs);
+    nProcs = nProcs_;
+    cond.notify_all();
+}
+
+unsigned int Threading::Pool::get_nProcs()const{
+    std::unique_lock<std::mutex> uLock(mtx);
+    return nProcs;
+}
+
+
+// The executor and the slot of the current thread, if it is a worker thread:
+static thread_local const Threading::Executor * currentExecutor = nullptr;
+static thread_local unsigned int currentSlotID = 0;
+
+Threading::Executor::Executor(unsigned int nThreads_):
+    nThreads(std::max(1u,nThreads_)),
+    nActive(nThreads)
+{
+    for (unsigned int i=0; i<nThreads; i++){
+        slots.emplace_back(new Slot);
+    }
+    for (unsigned int i=1; i<nThreads; i++){
+        workers.emplace_back([this,i](){ workerLoop(i); });
+    }
+}
+
+Threading::Executor::~Executor(){
+    stop = true;
+    workSignal.notify();
+    for (auto &worker : workers){
+        worker.join();
+    }
+}
+
+// Sets the number of threads participating in execution. The remaining worker threads sleep.
+void Threading::Executor::setActiveThreads(unsigned int n){
+    nActive = std::max(1u, std::min(n, nThreads));
+    workSignal.notify();
+}
+
+// Pins the worker threads to the CPUs of a binding, where the worker of slot i is the thread i of
+// the binding. (See Affinity::Binding) Returns false if any of the workers cannot be pinned.
+bool Threading::Executor::setAffinity(Affinity::Binding const &binding){
+
+    bool pinned = true;
+    for (unsigned int i=1; i<nThreads; i++){
+        pinned = Affinity::pinThread(workers[i-1], binding.cpusOf(i)) and pinned;
+    }
+    return pinned;
+}
+
+// Distributes the chunks of a job among the slots and participates in the execution until all
+// of the chunks are executed.
+void Threading::Executor::run(std::shared_ptr<Job> job, size_t nChunks){
+
+    job->remaining = nChunks;
+
+    // Divide the chunks into contiguous ranges, one for each slot of active threads:
+    unsigned int nActiveThreads = nActive.load();
+    size_t nParts = std::min(size_t(nActiveThreads), nChunks);
+    unsigned int mySlot = currentSlot();
+    for (size_t p=0; p<nParts; p++){
+        unsigned int slotID = unsigned((mySlot+p)%nActiveThreads);
+        push(slotID, Task{job, p*nChunks/nParts, (p+1)*nChunks/nParts});
+    }
+    workSignal.notify();
+
+    // Execute the tasks until the job is completed:
+    while (job->remaining.load() > 0){
+        if (not execute(mySlot)){
+            job->signal.wait([&]{return job->remaining.load()==0 or nQueued.load()>0;});
+        }
+    }
+}
+
+// Pops a task from the given slot (or steals one from another slot), splits off the remainder
+// of the task, and executes a single chunk. Returns false if no task is found.
+bool Threading::Executor::execute(unsigned int slotID){
+
+    Task task;
+    if (not (pop(slotID, task) or steal(slotID, task))){
+        return false;
+    }
+
+    // Split the task until a single chunk remains, leaving the rest to be stolen:
+    bool split = false;
+    while (task.hi - task.lo > 1){
+        size_t mid = task.lo + (task.hi-task.lo)/2;
+        push(slotID, Task{task.job, mid, task.hi});
+        task.hi = mid;
+        split = true;
+    }
+    if (split){
+        workSignal.notify();
+    }
+
+    // Execute the chunk:
+    task.job->body(task.lo);
+    if (task.job->remaining.fetch_sub(1) == 1){
+        task.job->signal.notify();
+    }
+    return true;
+}
+
+// Pops the most recently pushed task of a slot
+bool Threading::Executor::pop(unsigned int slotID, Task &task){
+    Slot &slot = *slots[slotID];
+    std::unique_lock<std::mutex> uLock(slot.mtx);
+    if (slot.tasks.empty()) return false;
+    task = std::move(slot.tasks.back());
+    slot.tasks.pop_back();
+    nQueued--;
+    return true;
+}
+
+// Steals the least recently pushed (and so the largest) task of another slot
+bool Threading::Executor::steal(unsigned int slotID, Task &task){
+    for (unsigned int i=1; i<nThreads; i++){
+        Slot &slot = *slots[(slotID+i)%nThreads];
+        std::unique_lock<std::mutex> uLock(slot.mtx);
+        if (not slot.tasks.empty()){
+            task = std::move(slot.tasks.front());
+            slot.tasks.pop_front();
+            nQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Threading::Executor::push(unsigned int slotID, Task task){
+    Slot &slot = *slots[slotID];
+    std::unique_lock<std::mutex> uLock(slot.mtx);
+    slot.tasks.push_back(std::move(task));
+    nQueued++;
+}
+
+void Threading::Executor::workerLoop(unsigned int slotID){
+
+    currentExecutor = this;
+    currentSlotID = slotID;
+
+    while (not stop.load()){
+        if (slotID >= nActive.load() or not execute(slotID)){
+            workSignal.wait([&]{return (nQueued.load()>0 and slotID<nActive.load()) or stop.load();});
+        }
+    }
+}
+
+unsigned int Threading::Executor::currentSlot()const{
+    return (currentExecutor==this) ? currentSlotID : 0;
+}
+
+
+// Dependencies:
+
+Threading::Dependencies& Threading::Dependencies::reads(std::string field){
+    readSet.push_back(field);
+    return *this;
+}
+
+Threading::Dependencies& Threading::Dependencies::writes(std::string field){
+    writeSet.push_back(field);
+    return *this;
+}
+
+Threading::Dependencies& Threading::Dependencies::after(unsigned int phase){
+    phaseSet.push_back(phase);
+    return *this;
+}
+
+Threading::Dependencies& Threading::Dependencies::afterParent(unsigned int parentControlPoint){
+    parentCP = int(parentControlPoint);
+    return *this;
+}
+
+Threading::Dependencies& Threading::Dependencies::local(){
+    isLocal = true;
+    return *this;
+}
+
+
+// PhaseGraph:
+
+void Threading::PhaseGraph::insert(){
+    Dependencies deps;
+    deps.declared = false;
+    insert(deps);
+}
+
+// Inserts a phase, and determines the preceding phases it depends on. A control point depends
+// on the preceding local phases of a child that follow the previous control point of the parent.
+void Threading::PhaseGraph::insert(Dependencies const &deps){
+
+    unsigned int phase = size();
+
+    for (auto pred : deps.phaseSet){
+        if (pred>=phase){
+            Report::error("Phasing!","Phase "+std::to_string(phase)+" cannot follow the phase "
+                          +std::to_string(pred)+", which is not inserted before it.");
+        }
+    }
+    if (deps.parentCP>=0 and (not deps.isLocal or int(nCP)>deps.parentCP+1)){
+        Report::error("Phasing!","Phase "+std::to_string(phase)+" following the control point "
+                      +std::to_string(deps.parentCP)+" of the parent must be a local phase inserted "
+                      "before the control point "+std::to_string(deps.parentCP+1)+".");
+    }
+
+    Node node;
+    node.deps = deps;
+    for (unsigned int p=0; p<phase; p++){
+        Dependencies const &other = nodes[p].deps;
+        bool explicitPred = std::find(deps.phaseSet.begin(), deps.phaseSet.end(), p)!=deps.phaseSet.end();
+        bool parentPred = (not deps.isLocal and other.isLocal and other.parentCP>=0 and
+                           other.parentCP+1==int(nCP));
+        if (explicitPred or parentPred or conflicts(deps, other)){
+            node.preds.push_back(p);
+        }
+    }
+    nodes.push_back(node);
+
+    if (deps.isLocal) nLocal++;
+    else nCP++;
+}
+
+bool Threading::PhaseGraph::conflicts(Dependencies const &a, Dependencies const &b){
+
+    if (not a.declared or not b.declared) return true;
+
+    auto intersects = [](std::vector<std::string> const &x, std::vector<std::string> const &y){
+        for (auto &field : x){
+            if (std::find(y.begin(), y.end(), field)!=y.end()) return true;
+        }
+        return false;
+    };
+    return intersects(a.writeSet, b.readSet) or intersects(a.writeSet, b.writeSet) or
+           intersects(a.readSet, b.writeSet);
+}
+
+void Threading::PhaseGraph::prepare(){
+    claimed.reset(new std::atomic<unsigned int>[nodes.size()]);
+    completed.reset(new std::atomic<unsigned int>[nodes.size()]);
+    for (unsigned int p=0; p<size(); p++){
+        claimed[p] = 0;
+        completed[p] = 0;
+    }
+}
+
+// Returns true if all of the phases a phase depends on are completed at timestep ts
+bool Threading::PhaseGraph::isReady(unsigned int phase, unsigned int ts)const{
+    for (auto pred : nodes[phase].preds){
+        if (completed[pred].load(std::memory_order_acquire)!=ts) return false;
+    }
+    return true;
+}
+
+// Claims a ready local phase of timestep ts for execution. The readiness of the parent control
+// points the phases follow are determined by the given function.
+bool Threading::PhaseGraph::claim(unsigned int ts, unsigned int &phase,
+                                  std::function<bool(int)> const &parentIsReady){
+    for (unsigned int p=0; p<size(); p++){
+        if (not nodes[p].deps.isLocal) continue;
+        unsigned int last = claimed[p].load();
+        if (last>=ts or not isReady(p, ts)) continue;
+        if (nodes[p].deps.parentCP>=0 and not parentIsReady(nodes[p].deps.parentCP)) continue;
+        if (claimed[p].compare_exchange_strong(last, ts)){
+            phase = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Threading::PhaseGraph::complete(unsigned int phase, unsigned int ts){
+    completed[phase].store(ts, std::memory_order_release);
+}
+
+// Returns true if all of the local phases are completed at timestep ts
+bool Threading::PhaseGraph::stepComplete(unsigned int ts)const{
+    for (unsigned int p=0; p<size(); p++){
+        if (nodes[p].deps.isLocal and completed[p].load(std::memory_order_acquire)!=ts) return false;
+    }
+    return true;
+}
@@ -22,23 +22,91 @@
 
 #include <thread>
 #include <mutex>
-#include <shared_mutex>
+#include <atomic>
+#include <cstdint>
 #include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <string>
+#include "affinity.h"
 
 namespace OpenHDM {
 
 // forward declare Domain template outside the scope of Threading namespace
 template <class SolverType> class Domain;
+namespace Distributed { class Link; }
 
 namespace Threading {
 
+// --------------------------------------------------------------------
+// Signal: A wake-up word for a single waiting thread. A waiting thread
+//   first spins on its predicate for a short while, and then sleeps on
+//   a futex until the signal is notified. Notifying a signal with no
+//   sleeping threads does not involve any system calls.
+// --------------------------------------------------------------------
+
+struct Signal{
+
+    void notify();
+
+    template <class Predicate>
+    void wait(Predicate pred);
+
+private:
+    void sleep(unsigned int epoch_);
+
+    std::atomic<unsigned int> epoch{0};
+    std::atomic<unsigned int> nSleepers{0};
+
+    // Number of spins before sleeping. (zero on single-processor machines)
+    static const unsigned int nSpins;
+};
+
+// Blocks the calling thread until the given predicate returns true. The predicate is
+// re-evaluated whenever the signal is notified.
+template <class Predicate>
+void Signal::wait(Predicate pred){
+
+    // Spin for a short while:
+    for (unsigned int i=0; i<nSpins; i++){
+        if (pred()) return;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    // Sleep until notified:
+    while (true){
+        nSleepers.fetch_add(1);
+        unsigned int e = epoch.load();
+        if (pred()){
+            nSleepers.fetch_sub(1);
+            return;
+        }
+        sleep(e);
+        nSleepers.fetch_sub(1);
+    }
+}
+
 // --------------------------------------------------------------------
 // ControlPoint: Used to mark the control point at which a domain is
-//   within a phase of a timestep.
+//   within a phase of a timestep. The number of phases entered and
+//   whether the current phase is done are stored in a single atomic
+//   state variable, which is incremented at each transition:
+//   state = 2*count + (done ? 1:0). Each control point owns the signal
+//   on which its domain waits. The ratio of a child domain is the
+//   number of its timesteps per timestep of its parent (subcycling),
+//   and the lag is the number of timesteps by which the parent may
+//   run ahead of the child. A child with either synchronizes with its
+//   parent at the timestep boundaries of the parent only. (stepwise)
 // --------------------------------------------------------------------
 
 struct ControlPoint{
     template <class SolverType> friend class OpenHDM::Domain;
+    friend class OpenHDM::Distributed::Link;
 
     ControlPoint();
 
@@ -47,12 +115,22 @@ struct ControlPoint{
     unsigned int getVal()const;
     bool isDone()const;
 
+    uint64_t getState()const{return state.load(std::memory_order_acquire);}
+    uint64_t getCount()const{return getState()/2;}
+
+    // Decomposition of a state value obtained by getState():
+    static uint64_t countOf(uint64_t state_){return state_/2;}
+    static bool     isDone(uint64_t state_){return state_%2;}
+
+    bool isStepwise()const{return ratio>1 or lag>0;}
+
 private:
     unsigned int ncp    = 0;    // Number of ctrl pts at which domains synchronize
-    unsigned int val    = -1;   // Current control point
-    bool done           = true; // ready to move to the next control point?
+    unsigned int ratio  = 1;    // Timestep ratio to the parent domain (child domains only)
+    unsigned int lag    = 0;    // Lag window in parent timesteps (child domains only)
+    std::atomic<uint64_t> state{1};  // No phases entered yet, and ready to move.
 
-    mutable std::shared_timed_mutex mtx;    // mutex for "val" and "done"
+    Signal signal;              // Signal on which the domain of the control point waits
 };
 
 // --------------------------------------------------------------------
@@ -65,15 +143,232 @@ struct Pool{
 
     void acquire();
     void release();
+    void resize(unsigned int nProcs_);
+    unsigned int get_nProcs()const;
 
 private:
     mutable std::mutex mtx;
     std::condition_variable cond;
-    const unsigned int nProcs;
-    unsigned int remainingThreads = 0;
+    unsigned int nProcs;
+    int remainingThreads = 0;   // may temporarily be negative after the pool is shrunk
 
 };
 
+// --------------------------------------------------------------------
+// PhaseTimes: Accumulated compute and wait times (in nanoseconds) of
+//   a domain during timestepping. The wait time includes the time
+//   spent in phase checks and in acquiring a processor from the pool.
+// --------------------------------------------------------------------
+
+struct PhaseTimes{
+    std::atomic<uint64_t> compute{0};
+    std::atomic<uint64_t> wait{0};
+};
+
+// --------------------------------------------------------------------
+// Dependencies: The declared dependencies of a phase, i.e., the named
+//   fields (or any other state) it reads and writes, and the phases it
+//   must follow, e.g.,
+//
+//     insertPhase(continuity, Dependencies().reads("U").writes("ETA"));
+//     insertPhase(output, Dependencies().reads("ETA").local());
+//
+//   A local phase is not a control point, i.e., it does not access the
+//   data shared with the parent or the children, and may be executed
+//   concurrently with the other phases of its domain. A local phase of
+//   a child may follow the k-th control point (non-local phase) of the
+//   parent (afterParent(k)), and has the same window of validity of the
+//   parent data as the k-th control point of the child, hence must be
+//   inserted before the (k+1)-th control point of the child.
+// --------------------------------------------------------------------
+
+class Dependencies{
+public:
+    Dependencies& reads(std::string field);
+    Dependencies& writes(std::string field);
+    Dependencies& after(unsigned int phase);
+    Dependencies& afterParent(unsigned int parentControlPoint);
+    Dependencies& local();
+
+private:
+    friend class PhaseGraph;
+
+    std::vector<std::string> readSet;
+    std::vector<std::string> writeSet;
+    std::vector<unsigned int> phaseSet;
+    int parentCP = -1;
+    bool isLocal = false;
+    bool declared = true;       // false: the phase conflicts with all of the others
+};
+
+// --------------------------------------------------------------------
+// PhaseGraph: The dependency graph of the phases of a domain within a
+//   timestep. A phase depends on each preceding phase it conflicts
+//   with, i.e., either writes a field the other reads or writes, and
+//   on the phases it is declared to follow. Undeclared phases conflict
+//   with all of the others, so the phases of a domain are executed in
+//   strict sequence by default. Each phase is executed once at every
+//   timestep; the steps at which the phases are claimed and completed
+//   are stored, so that the graph needs no resetting between steps.
+// --------------------------------------------------------------------
+
+class PhaseGraph{
+public:
+
+    void insert(Dependencies const &deps);
+    void insert();              // an undeclared phase
+
+    unsigned int size()const{return unsigned(nodes.size());}
+    bool hasLocalPhases()const{return nLocal>0;}
+    bool isLocal(unsigned int phase)const{return nodes[phase].deps.isLocal;}
+    int getParentCP(unsigned int phase)const{return nodes[phase].deps.parentCP;}
+    const std::vector<unsigned int>& getPredecessors(unsigned int phase)const{return nodes[phase].preds;}
+
+    // Execution state (see Domain<>::concurrentTimestepping()):
+    void prepare();             // allocates the state (before timestepping)
+    bool isReady(unsigned int phase, unsigned int ts)const;
+    bool claim(unsigned int ts, unsigned int &phase, std::function<bool(int)> const &parentIsReady);
+    void complete(unsigned int phase, unsigned int ts);
+    bool stepComplete(unsigned int ts)const;
+
+private:
+
+    struct Node{
+        Dependencies deps;
+        std::vector<unsigned int> preds;
+    };
+
+    static bool conflicts(Dependencies const &a, Dependencies const &b);
+
+    std::vector<Node> nodes;
+    unsigned int nLocal = 0;
+    unsigned int nCP = 0;
+    std::unique_ptr<std::atomic<unsigned int>[]> claimed;     // the last step each phase is claimed
+    std::unique_ptr<std::atomic<unsigned int>[]> completed;   // the last step each phase is completed
+};
+
+// --------------------------------------------------------------------
+// Executor: A persistent work-stealing executor for intra-domain
+//   parallelism. An executor of n threads owns n-1 worker threads; the
+//   thread calling parallel_for() or parallel_reduce() participates in
+//   the execution as well. The iteration range is divided into chunks,
+//   which are initially distributed among the slots of the threads.
+//   Each thread splits and executes the tasks of its own slot, and
+//   steals from the slots of other threads when its own slot is empty.
+// --------------------------------------------------------------------
+
+struct Executor{
+    Executor(unsigned int nThreads_);
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+    ~Executor();
+
+    unsigned int get_nThreads()const{return nThreads;}
+    unsigned int get_nActiveThreads()const{return nActive.load();}
+    void setActiveThreads(unsigned int n);
+    bool setAffinity(Affinity::Binding const &binding);
+
+    // Calls f(i) for each i in [begin,end):
+    template <class Function>
+    void parallel_for(size_t begin, size_t end, size_t chunkSize, Function f);
+
+    // Reduces map(i) for each i in [begin,end). The partial results of chunks are combined in
+    // the order of chunks, so the result depends only on chunkSize, not on the number of threads.
+    template <class T, class MapFunction, class ReduceFunction>
+    T parallel_reduce(size_t begin, size_t end, size_t chunkSize, T init,
+                      MapFunction map, ReduceFunction reduce);
+
+private:
+
+    struct Job{
+        std::function<void(size_t)> body;   // executes a single chunk
+        std::atomic<size_t> remaining{0};   // number of chunks not executed yet
+        Signal signal;                      // notified when all chunks are executed
+    };
+
+    struct Task{
+        std::shared_ptr<Job> job;
+        size_t lo;                          // range of chunk indices
+        size_t hi;
+    };
+
+    struct Slot{
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    void run(std::shared_ptr<Job> job, size_t nChunks);
+    bool execute(unsigned int slotID);
+    bool pop(unsigned int slotID, Task &task);
+    bool steal(unsigned int slotID, Task &task);
+    void push(unsigned int slotID, Task task);
+    void workerLoop(unsigned int slotID);
+    unsigned int currentSlot()const;
+
+    const unsigned int nThreads;
+    std::atomic<unsigned int> nActive;          // number of threads participating in execution
+    std::vector<std::unique_ptr<Slot>> slots;   // slot 0 is for the threads not owned by executor
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nQueued{0};             // number of tasks in all slots
+    std::atomic<bool> stop{false};
+    Signal workSignal;                          // notified when new tasks are queued
+};
+
+template <class Function>
+void Executor::parallel_for(size_t begin, size_t end, size_t chunkSize, Function f){
+
+    if (end <= begin) return;
+    chunkSize = std::max(size_t(1), chunkSize);
+
+    // Execute sequentially if there is a single thread or a single chunk:
+    if (nActive.load() == 1 or end-begin <= chunkSize){
+        for (size_t i=begin; i<end; i++){
+            f(i);
+        }
+        return;
+    }
+
+    size_t nChunks = (end-begin+chunkSize-1)/chunkSize;
+    auto job = std::make_shared<Job>();
+    job->body = [begin, end, chunkSize, &f](size_t chunk){
+        size_t lo = begin+chunk*chunkSize;
+        size_t hi = std::min(end, lo+chunkSize);
+        for (size_t i=lo; i<hi; i++){
+            f(i);
+        }
+    };
+    run(job, nChunks);
+}
+
+template <class T, class MapFunction, class ReduceFunction>
+T Executor::parallel_reduce(size_t begin, size_t end, size_t chunkSize, T init,
+                            MapFunction map, ReduceFunction reduce){
+
+    if (end <= begin) return init;
+    chunkSize = std::max(size_t(1), chunkSize);
+
+    // Partial results of chunks:
+    size_t nChunks = (end-begin+chunkSize-1)/chunkSize;
+    std::vector<T> partials(nChunks, init);
+
+    parallel_for(0, nChunks, 1, [&](size_t chunk){
+        size_t lo = begin+chunk*chunkSize;
+        size_t hi = std::min(end, lo+chunkSize);
+        T acc = map(lo);
+        for (size_t i=lo+1; i<hi; i++){
+            acc = reduce(acc, map(i));
+        }
+        partials[chunk] = acc;
+    });
+
+    // Combine the partial results in order:
+    T result = init;
+    for (auto &partial : partials){
+        result = reduce(result, partial);
+    }
+    return result;
+}
+
 } // end of namespace Threading
 } // end of namespace OpenHDM
 
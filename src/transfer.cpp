@@ -0,0 +1,171 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <climits>
+#include "transfer.h"
+
+using namespace OpenHDM;
+
+// --------------------------------------------------------------------
+// This source file includes the implementations of the transfer
+// kernels and the class "BoundaryTransfer" defined in transfer.h
+// --------------------------------------------------------------------
+
+namespace {
+
+inline const double& at(const double* field, int32_t offset){
+    return *reinterpret_cast<const double*>(reinterpret_cast<const char*>(field)+offset);
+}
+
+inline double& at(double* field, int32_t offset){
+    return *reinterpret_cast<double*>(reinterpret_cast<char*>(field)+offset);
+}
+
+} // end of anonymous namespace
+
+
+void Transfer::gatherScatter(const double* src, const int32_t* srcOffsets,
+                             double* dst, const int32_t* dstOffsets, size_t n){
+    for (size_t i=0; i<n; i++){
+        at(dst, dstOffsets[i]) = at(src, srcOffsets[i]);
+    }
+}
+
+void Transfer::gatherScatterLerp(const double* src0, const double* src1, double w, const int32_t* srcOffsets,
+                                 double* dst, const int32_t* dstOffsets, size_t n){
+    for (size_t i=0; i<n; i++){
+        double v0 = at(src0, srcOffsets[i]);
+        at(dst, dstOffsets[i]) = v0 + w*(at(src1, srcOffsets[i])-v0);
+    }
+}
+
+
+// Precomputes the byte offsets of the parent and child units. The offsets are 32-bit to halve the
+// size of the offset lists, so the fields may span up to 2 GB.
+BoundaryTransfer::BoundaryTransfer(std::vector<std::pair<unsigned int,unsigned int>> const &bcpairs,
+                                   size_t parentStride, size_t childStride){
+
+    parentOffsets.reserve(bcpairs.size());
+    childOffsets.reserve(bcpairs.size());
+    for (auto &bcpair : bcpairs){
+        size_t childOffset = bcpair.first*childStride;
+        size_t parentOffset = bcpair.second*parentStride;
+        if (childOffset > size_t(INT32_MAX) or parentOffset > size_t(INT32_MAX)){
+            Report::error("BoundaryTransfer","The unit fields exceed the 2 GB limit of the transfer offsets.");
+        }
+        childOffsets.push_back(int32_t(childOffset));
+        parentOffsets.push_back(int32_t(parentOffset));
+    }
+}
+
+// Copies the values of a parent field to the boundary units of the child field
+void BoundaryTransfer::apply(const double* parentField, double* childField)const{
+    Transfer::gatherScatter(parentField, parentOffsets.data(), childField, childOffsets.data(), size());
+}
+
+// Sets the values of the boundary units of the child field by interpolating linearly between two
+// states of a parent field, i.e., (1-w)*parentField0 + w*parentField1.
+void BoundaryTransfer::apply(const double* parentField0, const double* parentField1, double w,
+                             double* childField)const{
+    Transfer::gatherScatterLerp(parentField0, parentField1, w, parentOffsets.data(),
+                                childField, childOffsets.data(), size());
+}
+
+// Copies the values of the boundary units of the child field to the corresponding parent units
+void BoundaryTransfer::applyReverse(const double* childField, double* parentField)const{
+    Transfer::gatherScatter(childField, childOffsets.data(), parentField, parentOffsets.data(), size());
+}
+
+
+// BoundaryInterpolation constructor. The strides are those of the parent and child fields, as
+// in BoundaryTransfer, and the lag is the lag window of the child, if any.
+BoundaryInterpolation::BoundaryInterpolation(std::vector<std::pair<unsigned int,unsigned int>> const &bcpairs,
+                                             size_t parentStride, size_t childStride, unsigned int lag):
+    ring(lag>0 ? lag+1 : 0),
+    ringSteps(lag>0 ? lag+1 : 0, 0)
+{
+
+    std::vector<std::pair<unsigned int,unsigned int>> gatherPairs, scatterPairs;
+    gatherPairs.reserve(bcpairs.size());
+    scatterPairs.reserve(bcpairs.size());
+    for (unsigned int i=0; i<bcpairs.size(); i++){
+        gatherPairs.emplace_back(i, bcpairs[i].second);
+        scatterPairs.emplace_back(bcpairs[i].first, i);
+    }
+    gather = BoundaryTransfer(gatherPairs, parentStride, sizeof(double));
+    scatter = BoundaryTransfer(scatterPairs, sizeof(double), childStride);
+}
+
+// Stores the boundary values of the parent field at the beginning of a parent timestep
+void BoundaryInterpolation::update(const double* parentField){
+
+    previous.swap(current);
+    current.resize(gather.size());
+    gather.apply(parentField, current.data());
+
+    if (previous.size()!=current.size()){
+        previous = current;
+    }
+}
+
+// Stores the boundary values of the parent field at the end of a parent timestep in the ring buffer.
+// Called by the parent (see Domain::endParentStep()), and may overwrite the state of the timestep
+// ts-K-1 only, which the child has consumed before the parent enters the timestep ts.
+void BoundaryInterpolation::push(const double* parentField, unsigned int ts){
+
+    if (ring.empty()){
+        Report::error("BoundaryInterpolation","No ring buffer for a child without a lag window.");
+    }
+    auto &values = ring[ts%ring.size()];
+    values.resize(gather.size());
+    gather.apply(parentField, values.data());
+    ringSteps[ts%ring.size()] = ts;
+}
+
+// Consumes the boundary values of a parent timestep from the ring buffer (see push())
+void BoundaryInterpolation::update(unsigned int ts){
+
+    if (ring.empty() or ringSteps[ts%ring.size()]!=ts){
+        Report::error("BoundaryInterpolation","The boundary values of the parent timestep "
+                      +std::to_string(ts)+" are not in the ring buffer.");
+    }
+
+    previous.swap(current);
+    current = ring[ts%ring.size()];
+
+    if (previous.size()!=current.size()){
+        previous = current;
+    }
+}
+
+// Sets the boundary values of the child field to (1-w)*previous + w*current
+void BoundaryInterpolation::apply(double w, double* childField)const{
+    if (current.size()!=scatter.size()) return;   // no states stored yet
+    scatter.apply(previous.data(), current.data(), w, childField);
+}
+
+void BoundaryInterpolation::writeBinary(Serializer &s)const{
+    s.write(previous);
+    s.write(current);
+}
+
+void BoundaryInterpolation::readBinary(Deserializer &d){
+    d.read(previous);
+    d.read(current);
+}
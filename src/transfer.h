@@ -0,0 +1,155 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "serialization.h"
+#include "report.h"
+
+namespace OpenHDM {
+namespace Transfer {
+
+// --------------------------------------------------------------------
+// Transfer: Gather/scatter kernels to transfer values between fields
+//   of units, e.g., from the parent units to the boundary units of a
+//   child patch. The kernels operate on lists of byte offsets within
+//   the source and destination fields, so that both columnar fields
+//   (contiguous arrays) and the members of unit objects (strided
+//   arrays) can be transferred. The kernels are plain loops: the
+//   transfers are bound by the memory accesses of the (scattered)
+//   units, and gather/scatter instructions were measured to be no
+//   faster except for small, cache-resident columnar fields.
+// --------------------------------------------------------------------
+
+// dst[dstOffsets[i]] = src[srcOffsets[i]] for i in [0,n)
+void gatherScatter(const double* src, const int32_t* srcOffsets,
+                   double* dst, const int32_t* dstOffsets, size_t n);
+
+// dst[dstOffsets[i]] = (1-w)*src0[srcOffsets[i]] + w*src1[srcOffsets[i]] for i in [0,n)
+void gatherScatterLerp(const double* src0, const double* src1, double w, const int32_t* srcOffsets,
+                       double* dst, const int32_t* dstOffsets, size_t n);
+
+} // end of namespace Transfer
+
+
+// --------------------------------------------------------------------
+// BoundaryTransfer: A precomputed transfer from the fields of parent
+//   units to the fields of child units, constructed from the sorted
+//   (child,parent) position pairs of a child grid, i.e., the boundary
+//   units of its active patch (see Grid::getBoundaryTransfer()). It is
+//   intended to be called from the phase functions of child domains:
+//
+//     // columnar fields:
+//     bcTransfer.apply(parentColumns.column<ETA>().data(), childColumns.column<ETA>().data());
+//     // members of unit objects:
+//     bcTransfer.apply(&parentNodes[0].eta, &childNodes[0].eta);
+//
+//   where the strides of the fields are given at construction. The
+//   second overload of apply() interpolates linearly in time between
+//   two parent states, e.g., for child domains that subcycle, and
+//   applyReverse() copies the values in the opposite direction, e.g.,
+//   to unpack the parent values received in a packed buffer.
+// --------------------------------------------------------------------
+
+class BoundaryTransfer{
+public:
+
+    BoundaryTransfer() = default;
+    BoundaryTransfer(std::vector<std::pair<unsigned int,unsigned int>> const &bcpairs,
+                     size_t parentStride=sizeof(double), size_t childStride=sizeof(double));
+
+    void apply(const double* parentField, double* childField)const;
+    void apply(const double* parentField0, const double* parentField1, double w, double* childField)const;
+    void applyReverse(const double* childField, double* parentField)const;
+
+    size_t size()const{return childOffsets.size();}
+    bool empty()const{return childOffsets.empty();}
+
+private:
+    std::vector<int32_t> parentOffsets;     // byte offsets of the parent units
+    std::vector<int32_t> childOffsets;      // byte offsets of the child units
+};
+
+
+// --------------------------------------------------------------------
+// BoundaryInterpolation: Interpolates the parent values at the
+//   boundary units of a subcycled child domain, i.e., a child that
+//   executes r timesteps (substeps) per parent timestep. (See
+//   Domain::setTimestepRatio()) The boundary values of the parent
+//   field are stored at the beginning of each parent timestep, and
+//   the child field is set by interpolating linearly between the last
+//   two states at each substep k=1..r:
+//
+//     void beginParentStep(unsigned) override {bcEta.update(parentEta);}
+//     // in a phase function of the child at timestep ts:
+//     bcEta.apply(double((ts-1)%r+1)/r, childEta);
+//
+//   Until two states are stored, e.g., after construction or restart,
+//   both states are the same.
+//
+//   For a child with a lag window of K (see Domain::setLagWindow()),
+//   the parent fields may be ahead of the child, so the parent pushes
+//   the values at the end of each of its timesteps into a ring buffer
+//   of K+1 states, from which the child consumes them:
+//
+//     BoundaryInterpolation bcEta(bcpairs, stride, stride, K);
+//     void endParentStep(unsigned ts) override {bcEta.push(parentEta, ts);}
+//     void beginParentStep(unsigned ts) override {bcEta.update(ts);}
+// --------------------------------------------------------------------
+
+class BoundaryInterpolation{
+public:
+
+    BoundaryInterpolation() = default;
+    BoundaryInterpolation(std::vector<std::pair<unsigned int,unsigned int>> const &bcpairs,
+                          size_t parentStride=sizeof(double), size_t childStride=sizeof(double),
+                          unsigned int lag=0);
+
+    void update(const double* parentField);
+    void apply(double w, double* childField)const;
+
+    // ring buffer of parent states (lagged children):
+    void push(const double* parentField, unsigned int ts);
+    void update(unsigned int ts);
+
+    size_t size()const{return gather.size();}
+
+    // checkpoints (see Domain::writeDomainState()):
+    void writeBinary(Serializer &s)const;
+    void readBinary(Deserializer &d);
+
+private:
+    BoundaryTransfer gather;        // from the parent units to the stored values
+    BoundaryTransfer scatter;       // from the stored values to the child units
+    std::vector<double> previous;   // boundary values at the beginning of the previous parent step
+    std::vector<double> current;    // boundary values at the beginning of the current parent step
+
+    std::vector<std::vector<double>> ring;  // boundary values at the end of the last K+1 parent steps
+    std::vector<unsigned int> ringSteps;    // the parent timesteps of the states in the ring buffer
+};
+
+} // end of namespace OpenHDM
+
+#endif // TRANSFER_H
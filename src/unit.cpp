@@ -67,3 +67,13 @@ void Unit::setPos(unsigned pos_in){
     pos = pos_in;
 }
 
+// The data of derived unit types is written to and read from snapshots and checkpoints only if
+// the derived types override these functions:
+void Unit::writeBinary(Serializer &)const{
+    Report::error("Unit::writeBinary","not implemented for this unit type");
+}
+
+void Unit::readBinary(Deserializer &){
+    Report::error("Unit::readBinary","not implemented for this unit type");
+}
+
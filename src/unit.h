@@ -24,6 +24,9 @@
 
 namespace OpenHDM {
 
+class Serializer;   // forward declarations (see serialization.h)
+class Deserializer;
+
 // --------------------------------------------------------------------
 // Unit: The abstract class "Unit" is aimed to be used as a base class
 //   for data structures encapsulating the discrete mesh data. Example
@@ -32,7 +35,7 @@ namespace OpenHDM {
 
 class Unit{
     template <class patchType, class ...unitTypes> friend class Grid;
-    template <class ...UnitTypes> friend class Patch;
+    template <class allocPolicy, class ...UnitTypes> friend class BasicPatch;
 
 public:
     // Constructors & Operators:
@@ -52,6 +55,12 @@ public:
     bool     isBoundary()const{return boundary;}
     unsigned getPatchID()const{return patchID;}
 
+    // Functions to write and read the data of derived unit types in grid snapshots and
+    // checkpoints. (See Grid<>::saveSnapshot()) Unit types that are snapshotted or checkpointed
+    // must override them (with empty functions if they have no data of their own).
+    virtual void writeBinary(Serializer &)const;
+    virtual void readBinary(Deserializer &);
+
 protected:
 
     void deactivate();
@@ -0,0 +1,531 @@
+// OpenHDM: An Open-Source Sofware Framework for Hydrodynamic Models
+// Copyright (C) 2015-2017 
+// Alper Altuntas <alperaltuntas@gmail.com>
+
+// This file is part of OpenHDM.
+
+// OpenHDM is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+
+// OpenHDM is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with OpenHDM.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef UNITCOLUMNS_H
+#define UNITCOLUMNS_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "report.h"
+#include "serialization.h"
+#include "allocation.h"
+
+namespace OpenHDM {
+
+// --------------------------------------------------------------------
+// ColumnarUnit: The class template "ColumnarUnit" is aimed to be used
+//   as a base class for unit types whose data is stored in a
+//   structure-of-arrays layout. Instead of storing unit objects, the
+//   grid stores each of the declared fields, along with the unit
+//   bookkeeping of the "Unit" class, as a separate contiguous column.
+//   A columnar unit type only declares its fields, e.g.,
+//
+//     struct Node: ColumnarUnit<double,double,double>{
+//         enum Fields {ETA, U, V};
+//     };
+//
+//   The fields declared as Shared<T> are the static fields of a unit
+//   (e.g., coordinates, bathymetry, friction), which child grids share
+//   with their parents instead of copying. (See UnitColumns)
+// --------------------------------------------------------------------
+
+template <class ...FieldTypes>
+struct ColumnarUnit{
+    using fieldTypes = std::tuple<FieldTypes...>;
+    static constexpr size_t nFields = sizeof...(FieldTypes);
+};
+
+template <class T>
+struct Shared{};
+
+// The value type of a declared field, and whether it is shared:
+template <class T>
+struct FieldValue{
+    using type = T;
+    static constexpr bool shared = false;
+};
+
+template <class T>
+struct FieldValue<Shared<T>>{
+    using type = T;
+    static constexpr bool shared = true;
+};
+
+// Determines whether a unit type is derived from ColumnarUnit:
+template <class unitType>
+class isColumnar{
+    template <class ...FieldTypes>
+    static std::true_type check(ColumnarUnit<FieldTypes...> const *);
+    static std::false_type check(...);
+public:
+    static constexpr bool value = decltype(check(static_cast<unitType const *>(nullptr)))::value;
+};
+
+
+// --------------------------------------------------------------------
+// UnitColumns: The class template "UnitColumns" is the container of
+//   columnar units of a given type within a grid. Units are identified
+//   by their positions, i.e., the indices of the columns, which remain
+//   valid as the columns grow. Hence, patches referring to columnar
+//   units are not invalidated by the insertion of new units.
+//
+//   The units of a child grid copied from its parent (see Grid<>::
+//   copyFromParent()) borrow the shared fields of the parent, i.e.,
+//   the child has no columns of its own for these fields, and reads
+//   them from the parent columns through the child to parent position
+//   mapping, i.e., the UnitIndex::cp2pp of the child grid, which the
+//   columns refer to. (see Grid<>::linkParentColumns()) The shared
+//   fields are read-only through get() and view(), and are copied into
+//   the child columns upon the first write access, i.e., write() or
+//   column(). (copy-on-write) The parent must not modify the shared
+//   fields once they are borrowed by its children.
+// --------------------------------------------------------------------
+
+template <class unitType, class fieldTuple = typename unitType::fieldTypes>
+class UnitColumns;
+
+template <class unitType, class ...FieldTypes>
+class UnitColumns<unitType, std::tuple<FieldTypes...>>{
+    template <class patchType, class ...unitTypes> friend class Grid;
+    template <class allocPolicy, class ...UnitTypes> friend class BasicPatch;
+
+public:
+
+    template <size_t I>
+    using declaredType = typename std::tuple_element<I, std::tuple<FieldTypes...>>::type;
+    template <size_t I>
+    using fieldType = typename FieldValue<declaredType<I>>::type;
+    template <size_t I>
+    static constexpr bool isShared(){return FieldValue<declaredType<I>>::shared;}
+
+    // (read-only references to the shared fields)
+    template <size_t I>
+    using reference = typename std::conditional<isShared<I>(), const fieldType<I>&, fieldType<I>&>::type;
+
+    // A read-only view of a field column, which reads a borrowed field from the parent columns:
+    template <size_t I>
+    class View{
+    public:
+        explicit View(UnitColumns const &columns_): columns(columns_) {}
+        const fieldType<I>& operator[](unsigned pos)const{return columns.template get<I>(pos);}
+        size_t size()const{return columns.size();}
+    private:
+        UnitColumns const &columns;
+    };
+
+    // field columns:
+    template <size_t I>
+    std::vector<fieldType<I>>& column();
+    template <size_t I>
+    const std::vector<fieldType<I>>& column()const;     // (not for the borrowed fields, see view())
+    template <size_t I>
+    View<I> view()const{return View<I>(*this);}
+
+    template <size_t I>
+    reference<I> get(unsigned pos){
+        return const_cast<reference<I>>(static_cast<UnitColumns const &>(*this).template get<I>(pos));
+    }
+    template <size_t I>
+    const fieldType<I>& get(unsigned pos)const{
+        return (isShared<I>() and borrowed[I]) ? parentColumns->template get<I>((*parentPositions)[pos])
+                                               : std::get<I>(fields)[pos];
+    }
+    template <size_t I>
+    fieldType<I>& write(unsigned pos){return column<I>()[pos];}
+
+    // attribute accessors (equivalent to those of the "Unit" class):
+    size_t   size()const{return ids.size();}
+    size_t   capacity()const{return ids.capacity();}
+    int      getID(unsigned pos)const{return ids[pos];}
+    unsigned getPatchPos(unsigned pos)const{return patchPos[pos];}
+    unsigned getActivationTimestep(unsigned pos)const{return activationTimestep[pos];}
+    bool     isActive(unsigned pos)const{return active[pos];}
+    bool     isBoundary(unsigned pos)const{return boundary[pos];}
+    unsigned getPatchID(unsigned pos)const{return patchID[pos];}
+
+    void reserve(size_t n);
+
+    // The number of times the units are reordered or reloaded, i.e., the positions are remapped
+    // (e.g., to resynchronize the device mirrors, see device.h):
+    uint64_t getGeneration()const{return generation;}
+
+    // Sharing of the parent fields:
+    template <size_t I>
+    bool isBorrowed()const{return borrowed[I];}
+    bool hasParent()const{return parentColumns!=nullptr;}
+
+protected:
+
+    unsigned append(int id, typename FieldValue<FieldTypes>::type const &... values);
+    void setParent(UnitColumns const *parentColumns_, std::vector<unsigned> const &cp2pp);
+    unsigned copyFromParent(unsigned parentPos);
+    void activate(unsigned pos, unsigned ts=0);
+    void deactivate(unsigned pos);
+
+    // snapshots (see Grid<>::saveSnapshot()):
+    void writeBinary(Serializer &s, bool withState=false)const;
+    void readBinary(Deserializer &d, bool withState=false);
+
+    // reordering (see Grid<>::reorderUnits()):
+    void permute(std::vector<unsigned> const &order);
+
+private:
+
+    template <size_t ...I>
+    void appendFields(std::index_sequence<I...>, typename FieldValue<FieldTypes>::type const &... values);
+    template <size_t ...I>
+    void copyFields(std::index_sequence<I...>, unsigned parentPos);
+    template <size_t I>
+    void copyField(unsigned parentPos);
+    template <size_t ...I>
+    void determineBorrowed(std::index_sequence<I...>, bool attaching=false);
+    template <size_t I>
+    void own();
+    template <size_t ...I>
+    void reserveFields(std::index_sequence<I...>, size_t n);
+    template <size_t ...I>
+    void permuteFields(std::index_sequence<I...>, std::vector<unsigned> const &order);
+    template <class T>
+    static void permuteColumn(std::vector<T> &column, std::vector<unsigned> const &order);
+    template <size_t ...I>
+    void writeFields(std::index_sequence<I...>, Serializer &s)const;
+    template <size_t ...I>
+    void readFields(std::index_sequence<I...>, Deserializer &d);
+
+    // field columns:
+    std::tuple<std::vector<typename FieldValue<FieldTypes>::type>...> fields;
+
+    // sharing of the parent fields:
+    UnitColumns const * parentColumns = nullptr;
+    std::vector<unsigned> const * parentPositions = nullptr;   // the UnitIndex::cp2pp of the grid
+    bool borrowed[sizeof...(FieldTypes)+1] = {};    // whether the field columns are borrowed from the parent
+
+    // bookkeeping columns (see "Unit" class):
+    std::vector<int>            ids;
+    std::vector<unsigned char>  active;
+    std::vector<unsigned char>  boundary;
+    std::vector<unsigned>       patchPos;
+    std::vector<unsigned>       patchID;
+    std::vector<unsigned>       activationTimestep;
+
+    uint64_t generation = 0;
+};
+
+// Returns the column of a field. A borrowed field is copied from the parent beforehand.
+template <class unitType, class ...FieldTypes>
+template <size_t I>
+std::vector<typename UnitColumns<unitType, std::tuple<FieldTypes...>>::template fieldType<I>>&
+UnitColumns<unitType, std::tuple<FieldTypes...>>::column(){
+    if (borrowed[I]){
+        own<I>();
+    }
+    return std::get<I>(fields);
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t I>
+const std::vector<typename UnitColumns<unitType, std::tuple<FieldTypes...>>::template fieldType<I>>&
+UnitColumns<unitType, std::tuple<FieldTypes...>>::column()const{
+    if (borrowed[I]){
+        Report::error("UnitColumns","Field "+std::to_string(I)+" is borrowed from the parent grid."
+                      " Use get() or view() to read the field.");
+    }
+    return std::get<I>(fields);
+}
+
+// Copies a borrowed field from the parent columns into the child columns (copy-on-write)
+template <class unitType, class ...FieldTypes>
+template <size_t I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::own(){
+
+    auto& column = std::get<I>(fields);
+    column.clear();
+    column.reserve(ids.capacity());
+    for (size_t pos=0; pos<ids.size(); pos++){
+        unsigned parentPos = pos<parentPositions->size() ? (*parentPositions)[pos] : UINT_MAX;
+        column.push_back(parentPos!=UINT_MAX ? parentColumns->template get<I>(parentPos) : fieldType<I>());
+    }
+    borrowed[I] = false;
+}
+
+// Attaches the columns of a child grid to the columns of the parent grid, or refers to the child to
+// parent position mapping of another grid. (i.e., a copy of the grid) The shared fields of a child
+// with no units are borrowed from the parent.
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::setParent(UnitColumns const *parentColumns_,
+                                                                  std::vector<unsigned> const &cp2pp){
+    if (not parentColumns and ids.empty()){
+        determineBorrowed(std::index_sequence_for<FieldTypes...>(), true);
+    }
+    parentColumns = parentColumns_;
+    parentPositions = &cp2pp;
+}
+
+// Appends a copy of the parent unit at a given position and returns its position. Only the fields
+// not borrowed from the parent are copied. (The positions are mapped by the grid afterwards)
+template <class unitType, class ...FieldTypes>
+unsigned UnitColumns<unitType, std::tuple<FieldTypes...>>::copyFromParent(unsigned parentPos){
+
+    copyFields(std::index_sequence_for<FieldTypes...>(), parentPos);
+    ids.push_back(parentColumns->ids[parentPos]);
+    active.push_back(false);
+    boundary.push_back(false);
+    patchPos.push_back(UINT_MAX);
+    patchID.push_back(UINT_MAX);
+    activationTimestep.push_back(0);
+
+    return unsigned(ids.size()-1);
+}
+
+// Reserves capacity for n units in all of the columns
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::reserve(size_t n){
+
+    reserveFields(std::index_sequence_for<FieldTypes...>(), n);
+    ids.reserve(n);
+    active.reserve(n);
+    boundary.reserve(n);
+    patchPos.reserve(n);
+    patchID.reserve(n);
+    activationTimestep.reserve(n);
+}
+
+// Appends a new unit to the columns and returns its position
+template <class unitType, class ...FieldTypes>
+unsigned UnitColumns<unitType, std::tuple<FieldTypes...>>::append(int id,
+                                                                  typename FieldValue<FieldTypes>::type const &... values){
+
+    appendFields(std::index_sequence_for<FieldTypes...>(), values...);
+    ids.push_back(id);
+    active.push_back(false);
+    boundary.push_back(false);
+    patchPos.push_back(UINT_MAX);
+    patchID.push_back(UINT_MAX);
+    activationTimestep.push_back(0);
+
+    return unsigned(ids.size()-1);
+}
+
+// Activates the unit at a given position to include it in calculations
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::activate(unsigned pos, unsigned ts){
+
+    if (active[pos]){
+        Report::error("Unit activation","Unit "+std::to_string(ids[pos])+" is already active."
+                      " Activation timestep: "+std::to_string(activationTimestep[pos]));
+    }
+
+    active[pos] = true;
+    activationTimestep[pos] = ts;
+}
+
+// Deactivates the unit at a given position to remove it from calculations
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::deactivate(unsigned pos){
+
+    if (not active[pos]){
+        Report::error("Unit deactivation","Unit "+std::to_string(ids[pos])+" is already deactivated.");
+    }
+    active[pos] = false;
+    patchID[pos] = UINT_MAX;
+}
+
+// Writes the field columns, ids and boundary flags to a snapshot. If withState is true, the
+// activation and patch columns are written as well. (e.g., for checkpoints)
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::writeBinary(Serializer &s, bool withState)const{
+
+    writeFields(std::index_sequence_for<FieldTypes...>(), s);
+    s.write(ids);
+    s.write(boundary);
+    if (withState){
+        s.write(active);
+        s.write(patchPos);
+        s.write(patchID);
+        s.write(activationTimestep);
+    }
+}
+
+// Reads the columns from a snapshot. Unless withState is true, the units are inactive and not
+// included in any patches.
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::readBinary(Deserializer &d, bool withState){
+
+    readFields(std::index_sequence_for<FieldTypes...>(), d);
+    d.read(ids);
+    d.read(boundary);
+    generation++;
+
+    // (The borrowed fields are written as empty columns)
+    if (parentColumns){
+        determineBorrowed(std::index_sequence_for<FieldTypes...>());
+    }
+
+    if (withState){
+        d.read(active);
+        d.read(patchPos);
+        d.read(patchID);
+        d.read(activationTimestep);
+    }
+    else{
+        size_t n = ids.size();
+        active.assign(n, false);
+        patchPos.assign(n, UINT_MAX);
+        patchID.assign(n, UINT_MAX);
+        activationTimestep.assign(n, 0);
+    }
+}
+
+// Reorders all of the columns such that the new position i holds the unit at the old position
+// order[i].
+template <class unitType, class ...FieldTypes>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::permute(std::vector<unsigned> const &order){
+
+    permuteFields(std::index_sequence_for<FieldTypes...>(), order);
+    permuteColumn(ids, order);
+    permuteColumn(active, order);
+    permuteColumn(boundary, order);
+    permuteColumn(patchPos, order);
+    permuteColumn(patchID, order);
+    permuteColumn(activationTimestep, order);
+    generation++;
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::permuteFields(std::index_sequence<I...>,
+                                                                     std::vector<unsigned> const &order){
+    using expand = int[];
+    (void)expand{0, (borrowed[I] ? 0 : (permuteColumn(std::get<I>(fields), order), 0))...};
+}
+
+template <class unitType, class ...FieldTypes>
+template <class T>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::permuteColumn(std::vector<T> &column,
+                                                                     std::vector<unsigned> const &order){
+    std::vector<T> permuted;
+    permuted.reserve(column.size());
+    for (auto pos : order){
+        permuted.push_back(column[pos]);
+    }
+    column.swap(permuted);
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::writeFields(std::index_sequence<I...>,
+                                                                   Serializer &s)const{
+    using expand = int[];
+    (void)expand{0, (s.write(std::get<I>(fields)), 0)...};
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::readFields(std::index_sequence<I...>,
+                                                                  Deserializer &d){
+    using expand = int[];
+    (void)expand{0, (d.read(std::get<I>(fields)), 0)...};
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::appendFields(std::index_sequence<I...>,
+                                                                    typename FieldValue<FieldTypes>::type const &... values){
+    using expand = int[];
+    (void)expand{0, (column<I>().push_back(values), 0)...};
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::copyFields(std::index_sequence<I...>, unsigned parentPos){
+    using expand = int[];
+    (void)expand{0, (copyField<I>(parentPos), 0)...};
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::copyField(unsigned parentPos){
+    if (not borrowed[I]){
+        std::get<I>(fields).push_back(parentColumns->template get<I>(parentPos));
+    }
+}
+
+// A shared field is borrowed unless the child has a column of its own for the field. (All of the
+// shared fields are borrowed once the columns are attached to the parent)
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::determineBorrowed(std::index_sequence<I...>, bool attaching){
+    using expand = int[];
+    (void)expand{0, (borrowed[I] = (isShared<I>() and (attaching or std::get<I>(fields).size()!=ids.size())), 0)...};
+}
+
+template <class unitType, class ...FieldTypes>
+template <size_t ...I>
+void UnitColumns<unitType, std::tuple<FieldTypes...>>::reserveFields(std::index_sequence<I...>, size_t n){
+    using expand = int[];
+    (void)expand{0, (borrowed[I] ? 0 : (std::get<I>(fields).reserve(n), 0))...};
+}
+
+
+// --------------------------------------------------------------------
+// UnitStorage: Determines the container type of a unit type within
+//   the "unitsTuple" of a grid, i.e., a vector of unit objects for
+//   regular unit types (derived from Unit), and UnitColumns for
+//   columnar unit types (derived from ColumnarUnit). The vectors of
+//   unit objects are allocated by the allocation policy of the grid.
+// --------------------------------------------------------------------
+
+template <class unitType, class allocPolicy = StandardAllocation, bool columnar = isColumnar<unitType>::value>
+struct UnitStorage{
+    using type = std::vector<unitType, typename allocPolicy::template allocator<unitType>>;
+};
+
+template <class unitType, class allocPolicy>
+struct UnitStorage<unitType, allocPolicy, true>{
+    using type = UnitColumns<unitType>;
+};
+
+// --------------------------------------------------------------------
+// PositionList: A list of positions of columnar units of a given type.
+//   Used by patches to refer to columnar units. The range of the list
+//   modified since the last synchronization of its device mirror (see
+//   device.h: PositionsMirror) is recorded, so that only the modified
+//   range is transferred. Initially, the whole list is modified.
+// --------------------------------------------------------------------
+
+template <class unitType>
+struct PositionList: public std::vector<unsigned>{
+
+    void markModified(size_t begin=0, size_t end=SIZE_MAX)const{
+        modifiedBegin = std::min(modifiedBegin, begin);
+        modifiedEnd = std::max(modifiedEnd, end);
+    }
+
+    mutable size_t modifiedBegin = 0;
+    mutable size_t modifiedEnd = SIZE_MAX;
+};
+
+} // end of namespace OpenHDM
+
+#endif // UNITCOLUMNS_H